@@ -0,0 +1,193 @@
+#ifndef ARENA_ALLOCATOR_H
+#define ARENA_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Memory {
+
+    // Scene-scoped bump allocator. Objects are placed back to back in large
+    // blocks, so a scene's objects stay contiguous and freeing them is a walk
+    // over a handful of blocks rather than one heap free per object.
+    //
+    // Objects made with create() are destroyed in reverse creation order by
+    // reset() or the destructor; trivially destructible ones cost nothing to
+    // free. Individual objects cannot be freed. Moving an arena keeps every
+    // pointer into it valid.
+    class Arena {
+    public:
+        static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+    private:
+        struct Block {
+            Block* next;
+            size_t size;                // Usable bytes after the header
+            size_t used;
+
+            char* data() { return reinterpret_cast<char*>(this + 1); }
+        };
+
+        struct Finalizer {
+            void (*destroy)(void* object);
+            void* object;
+            Finalizer* next;
+        };
+
+        Block* head;                    // Block being filled; older ones follow
+        Finalizer* finalizers;          // Newest first
+        size_t blockSize;
+        size_t bytesUsed;
+
+        static Block* newBlock(size_t size, Block* next) {
+            Block* block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+            block->next = next;
+            block->size = size;
+            block->used = 0;
+            return block;
+        }
+
+        void runFinalizers() {
+            while (finalizers) {
+                Finalizer* finalizer = finalizers;
+                finalizers = finalizer->next;
+                finalizer->destroy(finalizer->object);
+            }
+        }
+
+        void freeBlocks(Block* block) {
+            while (block) {
+                Block* next = block->next;
+                ::operator delete(block);
+                block = next;
+            }
+        }
+
+        static void* alignedSpace(Block* block, size_t size, size_t alignment) {
+            uintptr_t start = reinterpret_cast<uintptr_t>(block->data() + block->used);
+            uintptr_t aligned = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            size_t end = block->used + (size_t)(aligned - start) + size;
+            if (end > block->size) return nullptr;
+            block->used = end;
+            return reinterpret_cast<void*>(aligned);
+        }
+
+    public:
+        explicit Arena(size_t blockSize = kDefaultBlockSize)
+            : head(nullptr), finalizers(nullptr), blockSize(blockSize), bytesUsed(0) {}
+
+        ~Arena() { release(); }
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        Arena(Arena&& other) noexcept
+            : head(other.head), finalizers(other.finalizers), blockSize(other.blockSize),
+              bytesUsed(other.bytesUsed) {
+            other.head = nullptr;
+            other.finalizers = nullptr;
+            other.bytesUsed = 0;
+        }
+
+        Arena& operator=(Arena&& other) noexcept {
+            if (this != &other) {
+                release();
+                std::swap(head, other.head);
+                std::swap(finalizers, other.finalizers);
+                std::swap(blockSize, other.blockSize);
+                std::swap(bytesUsed, other.bytesUsed);
+            }
+            return *this;
+        }
+
+        // Uninitialized storage; alignment must be a power of two
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+            if (head) {
+                if (void* memory = alignedSpace(head, size, alignment)) {
+                    bytesUsed += size;
+                    return memory;
+                }
+            }
+            // Oversized requests get a block of their own behind the current
+            // one so the rest of the current block is not wasted
+            size_t needed = size + alignment;
+            if (head && needed > blockSize / 4) {
+                Block* block = newBlock(needed, head->next);
+                head->next = block;
+                bytesUsed += size;
+                return alignedSpace(block, size, alignment);
+            }
+            head = newBlock(needed > blockSize ? needed : blockSize, head);
+            bytesUsed += size;
+            return alignedSpace(head, size, alignment);
+        }
+
+        template<typename T, typename... Args>
+        T* create(Args&&... args) {
+            T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if (!std::is_trivially_destructible<T>::value) {
+                Finalizer* finalizer = new (allocate(sizeof(Finalizer), alignof(Finalizer)))
+                    Finalizer{[](void* p) { static_cast<T*>(p)->~T(); }, object, finalizers};
+                finalizers = finalizer;
+            }
+            return object;
+        }
+
+        // Uninitialized array of a trivially destructible type
+        template<typename T>
+        T* allocateArray(size_t count) {
+            static_assert(std::is_trivially_destructible<T>::value, "arena arrays are never destroyed");
+            return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        // Destroys every object and keeps one block for reuse, so a scene
+        // that is cleared and refilled does not go back to the heap
+        void reset() {
+            runFinalizers();
+            Block* keep = nullptr;
+            Block* block = head;
+            while (block) {
+                Block* next = block->next;
+                if (!keep && block->size == blockSize) {
+                    keep = block;
+                } else {
+                    ::operator delete(block);
+                }
+                block = next;
+            }
+            if (keep) {
+                keep->next = nullptr;
+                keep->used = 0;
+            }
+            head = keep;
+            bytesUsed = 0;
+        }
+
+        // Destroys every object and returns all memory
+        void release() {
+            runFinalizers();
+            freeBlocks(head);
+            head = nullptr;
+            bytesUsed = 0;
+        }
+
+        size_t getBytesUsed() const { return bytesUsed; }
+
+        size_t getBytesReserved() const {
+            size_t total = 0;
+            for (Block* block = head; block; block = block->next) total += block->size;
+            return total;
+        }
+
+        size_t getBlockCount() const {
+            size_t count = 0;
+            for (Block* block = head; block; block = block->next) count++;
+            return count;
+        }
+    };
+
+} // namespace Memory
+
+#endif // ARENA_ALLOCATOR_H
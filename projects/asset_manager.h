@@ -0,0 +1,349 @@
+#ifndef ASSET_MANAGER_H
+#define ASSET_MANAGER_H
+
+#include "mapped_file.h"
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace GameEngine {
+
+    using NameId = uint32_t;
+
+    // Process-wide string interning, so hot paths compare and sort small
+    // integers instead of paths. Ids are dense from 0 in first-seen order
+    // and never change; names stay at stable addresses.
+    class NameTable {
+    private:
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, NameId> ids_;
+        std::deque<std::string> names_;
+
+        NameTable() = default;
+
+    public:
+        static NameTable& Shared() {
+            static NameTable table;
+            return table;
+        }
+
+        NameId Intern(const std::string& name) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = ids_.find(name);
+            if (it != ids_.end()) return it->second;
+            NameId id = (NameId)names_.size();
+            names_.push_back(name);
+            ids_.emplace(name, id);
+            return id;
+        }
+
+        const std::string& GetName(NameId id) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return names_[id];
+        }
+    };
+
+    enum class AssetState {
+        Unloaded,                           // Never requested, or evicted
+        Loading,                            // Queued or being read
+        Ready,
+        Failed                              // Retried by the next Request()
+    };
+
+    // Bytes of a loaded asset, or of the placeholder while it isn't
+    struct AssetData {
+        const uint8_t* data;
+        size_t size;
+        bool placeholder;
+    };
+
+    class AssetHandle;
+
+    // Streams assets from disk without stalling the frame. Requests go on
+    // a queue that dedicated I/O threads drain, memory-mapping each file
+    // and touching its pages so the frame never takes the page faults.
+    // Repeated requests for one path share one load. Finished loads become
+    // visible at the next Update(), which also evicts the least recently
+    // requested unreferenced assets while residency is over budget.
+    //
+    // Request(), Update() and eviction belong to the frame's thread;
+    // handles may be copied and read from any thread.
+    class AssetManager {
+    public:
+        struct Stats {
+            uint64_t requests = 0;
+            uint64_t hits = 0;              // Requests served by a resident or in-flight asset
+            uint64_t loads = 0;
+            uint64_t failures = 0;
+            uint64_t evictions = 0;
+        };
+
+    private:
+        friend class AssetHandle;
+
+        struct Asset {
+            NameId path;
+            std::atomic<AssetState> state;
+            std::atomic<int> references;
+            std::shared_ptr<IO::MappedFile> file;
+            std::list<NameId>::iterator lruPosition;
+            std::string error;
+
+            explicit Asset(NameId id) : path(id), state(AssetState::Unloaded), references(0) {}
+        };
+
+        struct Completion {
+            Asset* asset;
+            std::shared_ptr<IO::MappedFile> file;
+            std::string error;
+        };
+
+        std::deque<Asset> assets_;                  // Stable addresses for the I/O threads
+        std::vector<uint32_t> slotOf_;              // By NameId; kNoSlot if never seen
+        std::list<NameId> lru_;                     // Resident assets, most recently requested first
+        size_t budget_;
+        size_t resident_;
+        Stats stats_;
+        std::vector<uint8_t> placeholder_;
+
+        std::mutex queueMutex_;
+        std::condition_variable queueCondition_;
+        std::deque<Asset*> queue_;
+        std::vector<Completion> completed_;         // Guarded by queueMutex_
+        std::atomic<size_t> inFlight_;
+        bool stopping_;
+        std::vector<std::thread> threads_;
+
+        static constexpr uint32_t kNoSlot = 0xFFFFFFFFu;
+
+        Asset* Find(NameId path) {
+            return path < slotOf_.size() && slotOf_[path] != kNoSlot ? &assets_[slotOf_[path]] : nullptr;
+        }
+
+        const Asset* Find(NameId path) const {
+            return path < slotOf_.size() && slotOf_[path] != kNoSlot ? &assets_[slotOf_[path]] : nullptr;
+        }
+
+        void IoLoop(int index) {
+            PROFILE_THREAD_NAME("Asset I/O " + std::to_string(index));
+            (void)index;                    // Only used by profiling builds
+            for (;;) {
+                Asset* asset;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex_);
+                    queueCondition_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+                    if (stopping_) return;
+                    asset = queue_.front();
+                    queue_.pop_front();
+                }
+                Completion completion{asset, nullptr, std::string()};
+                {
+                    PROFILE_SCOPE_CATEGORY("AssetManager::Load", "io");
+                    completion.file = IO::MappedFile::open(NameTable::Shared().GetName(asset->path),
+                                                           &completion.error);
+                    if (completion.file) IO::touchPages(*completion.file);
+                }
+                std::lock_guard<std::mutex> lock(queueMutex_);
+                completed_.push_back(std::move(completion));
+            }
+        }
+
+        void Evict() {
+            for (auto it = lru_.end(); resident_ > budget_ && it != lru_.begin();) {
+                --it;
+                Asset& asset = *Find(*it);
+                if (asset.references.load(std::memory_order_acquire) > 0) continue;
+                resident_ -= asset.file->size();
+                asset.file.reset();
+                asset.state.store(AssetState::Unloaded, std::memory_order_release);
+                it = lru_.erase(it);
+                stats_.evictions++;
+            }
+        }
+
+        AssetData DataOf(const Asset& asset) const {
+            if (asset.state.load(std::memory_order_acquire) == AssetState::Ready) {
+                return AssetData{asset.file->data(), asset.file->size(), false};
+            }
+            return AssetData{placeholder_.data(), placeholder_.size(), true};
+        }
+
+    public:
+        // budgetBytes caps resident, unreferenced data; referenced assets
+        // stay resident even past it
+        explicit AssetManager(size_t budgetBytes = 256u << 20, int ioThreads = 2)
+            : budget_(budgetBytes), resident_(0), inFlight_(0), stopping_(false) {
+            for (int i = 0; i < std::max(1, ioThreads); i++) {
+                threads_.emplace_back(&AssetManager::IoLoop, this, i + 1);
+            }
+        }
+
+        // Abandons queued loads; loads already being read finish first
+        ~AssetManager() {
+            {
+                std::lock_guard<std::mutex> lock(queueMutex_);
+                stopping_ = true;
+            }
+            queueCondition_.notify_all();
+            for (auto& thread : threads_) thread.join();
+        }
+
+        AssetManager(const AssetManager&) = delete;
+        AssetManager& operator=(const AssetManager&) = delete;
+
+        // Returned by GetData() for anything not yet loaded; set it before
+        // handing out handles
+        void SetPlaceholder(std::vector<uint8_t> bytes) { placeholder_ = std::move(bytes); }
+
+        void SetBudget(size_t budgetBytes) { budget_ = budgetBytes; }
+        size_t GetBudget() const { return budget_; }
+        size_t GetResidentBytes() const { return resident_; }
+        size_t GetPendingCount() const { return inFlight_.load(std::memory_order_relaxed); }
+        const Stats& GetStats() const { return stats_; }
+
+        // Starts loading path unless it is resident or already on its way.
+        // A path whose last load failed is queued again, so a file that
+        // appears later or a transient I/O error doesn't stick.
+        AssetHandle Request(NameId path);
+        AssetHandle Request(const std::string& path);
+
+        // Publishes finished loads and evicts down to the budget; call once
+        // a frame
+        void Update() {
+            PROFILE_SCOPE("AssetManager::Update");
+            std::vector<Completion> completed;
+            {
+                std::lock_guard<std::mutex> lock(queueMutex_);
+                completed.swap(completed_);
+            }
+            for (Completion& completion : completed) {
+                Asset& asset = *completion.asset;
+                inFlight_.fetch_sub(1, std::memory_order_relaxed);
+                if (!completion.file) {
+                    asset.error = std::move(completion.error);
+                    asset.state.store(AssetState::Failed, std::memory_order_release);
+                    stats_.failures++;
+                    continue;
+                }
+                asset.file = std::move(completion.file);
+                resident_ += asset.file->size();
+                lru_.push_front(asset.path);
+                asset.lruPosition = lru_.begin();
+                asset.state.store(AssetState::Ready, std::memory_order_release);
+                stats_.loads++;
+            }
+            if (resident_ > budget_) Evict();
+        }
+
+        AssetState GetState(NameId path) const {
+            const Asset* asset = Find(path);
+            return asset ? asset->state.load(std::memory_order_acquire) : AssetState::Unloaded;
+        }
+
+        // Only valid until the next Update() unless a handle is held
+        AssetData GetData(NameId path) const {
+            const Asset* asset = Find(path);
+            return asset ? DataOf(*asset) : AssetData{placeholder_.data(), placeholder_.size(), true};
+        }
+
+        // Why the last load of path failed, if it did
+        std::string GetError(NameId path) const {
+            const Asset* asset = Find(path);
+            return asset ? asset->error : std::string();
+        }
+    };
+
+    // Reference-counted handle to one asset. Holding a handle keeps the
+    // asset from being evicted once loaded, so data it returns stays valid
+    // while it is held; handles must not outlive the manager that issued them.
+    class AssetHandle {
+    private:
+        friend class AssetManager;
+
+        AssetManager* manager_;
+        AssetManager::Asset* asset_;
+
+        AssetHandle(AssetManager* manager, AssetManager::Asset* asset) : manager_(manager), asset_(asset) {
+            asset_->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    public:
+        AssetHandle() : manager_(nullptr), asset_(nullptr) {}
+
+        AssetHandle(const AssetHandle& other) : manager_(other.manager_), asset_(other.asset_) {
+            if (asset_) asset_->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        AssetHandle(AssetHandle&& other) noexcept : manager_(other.manager_), asset_(other.asset_) {
+            other.manager_ = nullptr;
+            other.asset_ = nullptr;
+        }
+
+        AssetHandle& operator=(AssetHandle other) noexcept {
+            std::swap(manager_, other.manager_);
+            std::swap(asset_, other.asset_);
+            return *this;
+        }
+
+        ~AssetHandle() {
+            if (asset_) asset_->references.fetch_sub(1, std::memory_order_acq_rel);
+        }
+
+        bool IsValid() const { return asset_ != nullptr; }
+        NameId GetPath() const { return asset_ ? asset_->path : 0; }
+
+        AssetState GetState() const {
+            return asset_ ? asset_->state.load(std::memory_order_acquire) : AssetState::Unloaded;
+        }
+
+        bool IsReady() const { return GetState() == AssetState::Ready; }
+
+        // Never blocks: the placeholder until the load has been picked up
+        // by AssetManager::Update()
+        AssetData GetData() const {
+            if (!asset_) return AssetData{nullptr, 0, true};
+            return manager_->DataOf(*asset_);
+        }
+    };
+
+    inline AssetHandle AssetManager::Request(NameId path) {
+        stats_.requests++;
+        if (path >= slotOf_.size()) slotOf_.resize(path + 1, kNoSlot);
+        if (slotOf_[path] == kNoSlot) {
+            slotOf_[path] = (uint32_t)assets_.size();
+            assets_.emplace_back(path);
+        }
+        Asset& asset = assets_[slotOf_[path]];
+        AssetState state = asset.state.load(std::memory_order_acquire);
+        if (state == AssetState::Unloaded || state == AssetState::Failed) {
+            asset.state.store(AssetState::Loading, std::memory_order_release);
+            inFlight_.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(queueMutex_);
+                queue_.push_back(&asset);
+            }
+            queueCondition_.notify_one();
+        } else {
+            stats_.hits++;
+            if (state == AssetState::Ready) lru_.splice(lru_.begin(), lru_, asset.lruPosition);
+        }
+        return AssetHandle(this, &asset);
+    }
+
+    inline AssetHandle AssetManager::Request(const std::string& path) {
+        return Request(NameTable::Shared().Intern(path));
+    }
+
+} // namespace GameEngine
+
+#endif // ASSET_MANAGER_H
@@ -0,0 +1,532 @@
+#include "game_engine.h"
+#include "ray_tracing_engine.h"
+#include "perf_counters.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Engine benchmark suite: microbenchmarks of the hot calls of both engines
+// and whole-frame macro benchmarks, printed as one JSON document with one
+// result object per line. Each result has the median, min, max and
+// standard deviation of ns per operation over the repetitions, and, where
+// perf_event is available, hardware counters per operation and IPC.
+//
+// Usage: engine_bench [--filter SUBSTRING] [--min-time MS] [--repetitions N] [--entities N]
+//                     [--width N] [--height N] [--threads N] [--output file.json]
+//                     [--baseline file.json] [--tolerance FRACTION]
+//
+// With --baseline each result is compared with the same benchmark in an
+// earlier run's output; the run exits with status 2 if any got slower by
+// more than the tolerance (default 0.10).
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+    using Profiling::PerfCounters;
+
+    double elapsedMs(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // Peak resident set size of the process so far, in KiB
+    long peakRssKb() {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return (long)(counters.PeakWorkingSetSize / 1024);
+        }
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+#endif
+    }
+
+    // Keeps the compiler from discarding a result that is otherwise unused
+    template<typename T>
+    inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile char sink;
+        sink = *reinterpret_cast<const volatile char*>(&value);
+#endif
+    }
+
+    struct BenchConfig {
+        std::string filter;
+        double minTimeMs = 200.0;
+        int repetitions = 5;
+        int entities = 100000;
+        int width = 1920;
+        int height = 1080;
+        int threads = 1;
+        std::string output;
+        std::string baseline;
+        double tolerance = 0.10;
+    };
+
+    // run(n) performs n operations and is the only part timed; reset, if
+    // set, runs untimed before each timed call
+    struct Benchmark {
+        std::string name;
+        std::string kind;                   // "micro" or "macro"
+        std::function<void(uint64_t)> run;
+        std::function<void()> reset;
+    };
+
+    struct BenchResult {
+        std::string name;
+        std::string kind;
+        uint64_t iterations = 0;            // Per repetition
+        double medianNs = 0.0;
+        double minNs = 0.0;
+        double maxNs = 0.0;
+        double stddevNs = 0.0;
+        double counters[PerfCounters::kCounterCount] = {};     // Per operation
+        bool hasCounter[PerfCounters::kCounterCount] = {};
+    };
+
+    // Grows the iteration count until one timed call lasts --min-time,
+    // then times --repetitions calls of that many operations. Counters
+    // are summed over the repetitions.
+    BenchResult runBenchmark(const Benchmark& bench, const BenchConfig& config, PerfCounters& perf) {
+        auto timed = [&](uint64_t iterations) {
+            if (bench.reset) bench.reset();
+            auto start = Clock::now();
+            bench.run(iterations);
+            return elapsedMs(start, Clock::now());
+        };
+
+        uint64_t iterations = 1;
+        for (;;) {
+            double ms = timed(iterations);
+            if (ms >= config.minTimeMs || iterations >= (1ull << 30)) break;
+            double grow = ms > 0.0 ? config.minTimeMs * 1.2 / ms : 10.0;
+            iterations = std::max(iterations + 1, (uint64_t)(iterations * std::min(grow, 10.0)));
+        }
+
+        BenchResult result;
+        result.name = bench.name;
+        result.kind = bench.kind;
+        result.iterations = iterations;
+        std::vector<double> nsPerOp;
+        uint64_t totals[PerfCounters::kCounterCount] = {};
+        bool counted[PerfCounters::kCounterCount] = {};
+        for (int i = 0; i < PerfCounters::kCounterCount; i++) counted[i] = perf.isAvailable(i);
+
+        for (int rep = 0; rep < std::max(1, config.repetitions); rep++) {
+            if (bench.reset) bench.reset();
+            perf.start();
+            auto start = Clock::now();
+            bench.run(iterations);
+            double ms = elapsedMs(start, Clock::now());
+            PerfCounters::Sample sample = perf.stop();
+            nsPerOp.push_back(ms * 1e6 / iterations);
+            for (int i = 0; i < PerfCounters::kCounterCount; i++) {
+                counted[i] = counted[i] && sample.valid[i];
+                totals[i] += sample.values[i];
+            }
+        }
+
+        std::sort(nsPerOp.begin(), nsPerOp.end());
+        size_t n = nsPerOp.size();
+        result.medianNs = n % 2 ? nsPerOp[n / 2] : 0.5 * (nsPerOp[n / 2 - 1] + nsPerOp[n / 2]);
+        result.minNs = nsPerOp.front();
+        result.maxNs = nsPerOp.back();
+        double mean = 0.0;
+        for (double v : nsPerOp) mean += v;
+        mean /= n;
+        double variance = 0.0;
+        for (double v : nsPerOp) variance += (v - mean) * (v - mean);
+        result.stddevNs = n > 1 ? std::sqrt(variance / (n - 1)) : 0.0;
+
+        double operations = (double)iterations * n;
+        for (int i = 0; i < PerfCounters::kCounterCount; i++) {
+            result.hasCounter[i] = counted[i];
+            result.counters[i] = counted[i] ? totals[i] / operations : 0.0;
+        }
+        return result;
+    }
+
+    // ---- Game engine ----
+
+    // Entities spread over a 200-unit cube, each with a transform and a
+    // renderable, seeded so every run builds the same scene
+    void populateEntities(GameEngine::Scene& scene, int count) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        const char* meshes[] = {"models/rock.obj", "models/tree.obj", "models/crate.obj", "models/lamp.obj"};
+        const char* materials[] = {"materials/stone.mat", "materials/bark.mat", "materials/wood.mat"};
+        for (int i = 0; i < count; i++) {
+            GameEngine::Entity entity = scene.CreateEntity();
+            entity.EmplaceComponent<GameEngine::TransformComponent>(position(rng), position(rng), position(rng));
+            entity.EmplaceComponent<GameEngine::RenderComponent>(meshes[i % 4], materials[i % 3], 1.0f);
+        }
+    }
+
+    // --threads 1 keeps all of the scene's work on the calling thread, the
+    // only one the counters see
+    std::unique_ptr<Threading::JobSystem> makeJobSystem(const BenchConfig& config) {
+        if (config.threads <= 0) return nullptr;
+        return std::make_unique<Threading::JobSystem>(config.threads - 1);
+    }
+
+    void addEngineBenchmarks(const BenchConfig& config, std::vector<Benchmark>& benches) {
+        // Random-order lookups over every entity's transform
+        auto lookupScene = std::make_shared<GameEngine::Scene>();
+        populateEntities(*lookupScene, config.entities);
+        auto order = std::make_shared<std::vector<GameEngine::Entity>>();
+        for (GameEngine::EntityHandle entity :
+             lookupScene->GetRegistry().GetPool<GameEngine::TransformComponent>().GetEntities()) {
+            order->push_back(lookupScene->GetEntity(entity));
+        }
+        std::shuffle(order->begin(), order->end(), std::mt19937(7));
+        benches.push_back({"entity_get_component", "micro", [lookupScene, order](uint64_t n) {
+            size_t next = 0;
+            for (uint64_t i = 0; i < n; i++) {
+                GameEngine::TransformComponent* transform =
+                    (*order)[next].GetComponent<GameEngine::TransformComponent>();
+                doNotOptimize(transform->GetX());
+                if (++next == order->size()) next = 0;
+            }
+        }, nullptr});
+
+        // Bare entity creation. The scene is cleared every --entities
+        // creations, as a level reload would, so the handle space never
+        // runs out; that cost is amortized into the result.
+        auto createScene = std::make_shared<GameEngine::Scene>();
+        size_t roundSize = (size_t)config.entities;
+        benches.push_back({"scene_create_entity", "micro", [createScene, roundSize](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                if (createScene->GetEntityCount() == roundSize) createScene->Clear();
+                doNotOptimize(createScene->CreateEntity().GetHandle());
+            }
+        }, [createScene] { createScene->Clear(); }});
+
+        // One simulation tick: a drift system moves every entity, the
+        // spatial index catches up, and the frame's draw list is culled
+        struct Tick {
+            GameEngine::Scene scene;
+            std::unique_ptr<Threading::JobSystem> jobs;
+            GameEngine::Frustum frustum;
+            GameEngine::DrawList drawList;
+        };
+        auto tick = std::make_shared<Tick>();
+        tick->jobs = makeJobSystem(config);
+        tick->scene.GetSystems().SetJobSystem(tick->jobs.get());
+        populateEntities(tick->scene, config.entities);
+        tick->scene.GetSystems().AddSystem("drift", [](GameEngine::Registry& registry, float deltaTime) {
+            size_t moved = 0;
+            registry.Each<GameEngine::TransformComponent>(
+                [&](GameEngine::EntityHandle, GameEngine::TransformComponent& transform) {
+                    transform.Translate(0.0f, 0.0f, deltaTime);
+                    moved++;
+                });
+            return moved;
+        }).Writing<GameEngine::TransformComponent>();
+        tick->frustum = GameEngine::Frustum::Perspective(0.0f, 0.0f, 150.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+                                                         1.0f, 16.0f / 9.0f, 0.1f, 400.0f);
+        benches.push_back({"ecs_tick_" + std::to_string(config.entities), "macro", [tick](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                tick->scene.Update(1.0f / 60.0f);
+                tick->scene.BuildDrawList(tick->frustum, tick->drawList);
+                doNotOptimize(tick->drawList.GetItems().size());
+            }
+        }, nullptr});
+    }
+
+    // ---- Ray tracer ----
+
+    // The spheres and floor from ray_tracing_engine.cpp
+    void populateDemo(RayTracing::Scene& scene) {
+        using RayTracing::Material;
+        using RayTracing::Vector3;
+        uint32_t red = scene.addMaterial(Material(Vector3(0.8f, 0.2f, 0.2f), 0.3f, 0.0f));
+        uint32_t blue = scene.addMaterial(Material(Vector3(0.2f, 0.2f, 0.8f), 0.5f, 0.2f));
+        uint32_t green = scene.addMaterial(Material(Vector3(0.2f, 0.8f, 0.2f), 0.7f, 0.0f));
+        uint32_t gold = scene.addMaterial(Material(Vector3(0.8f, 0.7f, 0.2f), 0.1f, 0.9f));
+        scene.addSphere(Vector3(-2.0f, 0.0f, -5.0f), 1.0f, red);
+        scene.addSphere(Vector3(0.0f, 0.0f, -5.0f), 1.0f, blue);
+        scene.addSphere(Vector3(2.0f, 0.0f, -5.0f), 1.0f, green);
+        scene.addSphere(Vector3(0.0f, -2.0f, -3.0f), 0.8f, gold);
+
+        uint32_t floorMaterial = scene.addMaterial(Material(Vector3(0.6f, 0.6f, 0.6f), 0.9f, 0.0f));
+        RayTracing::TriangleMesh floor(floorMaterial);
+        uint32_t a = floor.addVertex(Vector3(-10.0f, -3.0f, 0.0f));
+        uint32_t b = floor.addVertex(Vector3(10.0f, -3.0f, 0.0f));
+        uint32_t c = floor.addVertex(Vector3(10.0f, -3.0f, -20.0f));
+        uint32_t d = floor.addVertex(Vector3(-10.0f, -3.0f, -20.0f));
+        floor.addTriangle(a, b, c);
+        floor.addTriangle(a, c, d);
+        scene.addMesh(floor);
+    }
+
+    RayTracing::Camera makeCamera(const BenchConfig& config) {
+        using RayTracing::Vector3;
+        return RayTracing::Camera(Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, -1.0f), Vector3(0.0f, 1.0f, 0.0f),
+                                  60.0f, config.width, config.height);
+    }
+
+    // Incoherent rays through random pixels, so traversal is not helped by
+    // neighbouring rays warming the cache
+    std::vector<RayTracing::Ray> makeRandomRays(const RayTracing::Camera& camera, int count) {
+        std::mt19937 rng(99);
+        std::uniform_int_distribution<int> px(0, camera.getWidth() - 1);
+        std::uniform_int_distribution<int> py(0, camera.getHeight() - 1);
+        std::vector<RayTracing::Ray> rays;
+        rays.reserve(count);
+        for (int i = 0; i < count; i++) {
+            rays.push_back(camera.generateRay(px(rng), py(rng)));
+        }
+        return rays;
+    }
+
+    void addRayTracerBenchmarks(const BenchConfig& config, std::vector<Benchmark>& benches) {
+        using RayTracing::Vector3;
+        RayTracing::Camera camera = makeCamera(config);
+
+        // One sphere in the middle of the view, missed by most random rays
+        // so both exits of the test are timed
+        auto sphere = std::make_shared<RayTracing::Sphere>(Vector3(0.0f, 0.0f, -5.0f), 2.0f, 0);
+        auto sphereRays = std::make_shared<std::vector<RayTracing::Ray>>(makeRandomRays(camera, 1024));
+        benches.push_back({"sphere_intersect", "micro", [sphere, sphereRays](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                float t = 0.0f;
+                bool hit = sphere->intersect((*sphereRays)[i & 1023], 1000.0f, t);
+                doNotOptimize(hit);
+                doNotOptimize(t);
+            }
+        }, nullptr});
+
+        // Primary rays in scanline order over the whole frame
+        benches.push_back({"camera_generate_ray", "micro", [camera](uint64_t n) {
+            int x = 0, y = 0;
+            for (uint64_t i = 0; i < n; i++) {
+                RayTracing::Ray ray = camera.generateRay(x, y);
+                doNotOptimize(ray);
+                if (++x == camera.getWidth()) {
+                    x = 0;
+                    if (++y == camera.getHeight()) y = 0;
+                }
+            }
+        }, nullptr});
+
+        // Closest hit against 10k scattered spheres, the random10k scene of rt_bench
+        auto traced = std::make_shared<RayTracing::Scene>();
+        {
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> lateral(-50.0f, 50.0f);
+            std::uniform_real_distribution<float> depth(-150.0f, -20.0f);
+            std::uniform_real_distribution<float> radius(0.2f, 1.5f);
+            uint32_t material = traced->addMaterial(RayTracing::Material(Vector3(0.7f, 0.7f, 0.7f)));
+            traced->reserveSpheres(10000);
+            for (int i = 0; i < 10000; i++) {
+                Vector3 center(lateral(rng), lateral(rng), depth(rng));
+                traced->addSphere(center, radius(rng), material);
+            }
+            traced->finalize();
+        }
+        auto traceRays = std::make_shared<std::vector<RayTracing::Ray>>(makeRandomRays(camera, 4096));
+        benches.push_back({"scene_trace_ray", "micro", [traced, traceRays](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                RayTracing::HitInfo hit = traced->traceRay((*traceRays)[i & 4095]);
+                doNotOptimize(hit);
+            }
+        }, nullptr});
+
+        // One shaded frame of the demo scene on the tiled renderer
+        struct Frame {
+            std::unique_ptr<Threading::JobSystem> jobs;
+            std::unique_ptr<RayTracing::RayTracingEngine> engine;
+            RayTracing::Framebuffer framebuffer;
+            RayTracing::RenderOptions options;
+
+            explicit Frame(const BenchConfig& config)
+                : jobs(makeJobSystem(config)),
+                  framebuffer(config.width, config.height, RayTracing::PixelFormat::RGBA8),
+                  options(std::max(0, config.threads), 32) {}
+        };
+        auto frame = std::make_shared<Frame>(config);
+        RayTracing::Scene demo(Vector3(0.1f, 0.1f, 0.15f));
+        populateDemo(demo);
+        demo.finalize();
+        frame->engine = std::make_unique<RayTracing::RayTracingEngine>(std::move(demo), camera);
+        if (frame->jobs) frame->engine->setJobSystem(frame->jobs.get());
+        std::string frameName = "render_" + std::to_string(config.width) + "x" + std::to_string(config.height);
+        benches.push_back({frameName, "macro", [frame](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                frame->engine->render(frame->framebuffer, frame->options);
+            }
+        }, nullptr});
+    }
+
+    // ns_per_op by benchmark name from an earlier run's output; relies on
+    // each result being written on a line of its own
+    std::map<std::string, double> loadBaseline(const std::string& path) {
+        std::map<std::string, double> baseline;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t name = line.find("\"name\": \"");
+            size_t ns = line.find("\"ns_per_op\": ");
+            if (name == std::string::npos || ns == std::string::npos) continue;
+            name += 9;
+            size_t end = line.find('"', name);
+            if (end == std::string::npos) continue;
+            baseline[line.substr(name, end - name)] = std::atof(line.c_str() + ns + 13);
+        }
+        return baseline;
+    }
+
+    bool parseArgs(int argc, char** argv, BenchConfig& config) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--filter" && hasValue) config.filter = argv[++i];
+            else if (arg == "--min-time" && hasValue) config.minTimeMs = std::atof(argv[++i]);
+            else if (arg == "--repetitions" && hasValue) config.repetitions = std::atoi(argv[++i]);
+            else if (arg == "--entities" && hasValue) config.entities = std::atoi(argv[++i]);
+            else if (arg == "--width" && hasValue) config.width = std::atoi(argv[++i]);
+            else if (arg == "--height" && hasValue) config.height = std::atoi(argv[++i]);
+            else if (arg == "--threads" && hasValue) config.threads = std::atoi(argv[++i]);
+            else if (arg == "--output" && hasValue) config.output = argv[++i];
+            else if (arg == "--baseline" && hasValue) config.baseline = argv[++i];
+            else if (arg == "--tolerance" && hasValue) config.tolerance = std::atof(argv[++i]);
+            else {
+                std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+                return false;
+            }
+        }
+        return config.width > 0 && config.height > 0 && config.entities > 0 && config.repetitions > 0;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        std::cerr << "Usage: engine_bench [--filter SUBSTRING] [--min-time MS] [--repetitions N] [--entities N]\n"
+                  << "                    [--width N] [--height N] [--threads N] [--output FILE]\n"
+                  << "                    [--baseline FILE] [--tolerance FRACTION]\n";
+        return 1;
+    }
+
+    std::map<std::string, double> baseline;
+    if (!config.baseline.empty()) {
+        baseline = loadBaseline(config.baseline);
+        if (baseline.empty()) {
+            std::cerr << "No results in baseline " << config.baseline << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<Benchmark> benches;
+    addEngineBenchmarks(config, benches);
+    addRayTracerBenchmarks(config, benches);
+
+    PerfCounters perf;
+    if (!perf.isAvailable()) {
+        std::cerr << "Hardware counters unavailable (" << perf.getError() << "); reporting times only\n";
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"benchmark\": \"engine_bench\",\n";
+    out << "  \"cpu_simd\": \"" << RayTracing::simdLevelName(RayTracing::detectSimdLevel()) << "\",\n";
+    out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"threads\": " << config.threads << ",\n";
+    out << "  \"repetitions\": " << config.repetitions << ",\n";
+    out << "  \"perf_counters\": " << (perf.isAvailable() ? "true" : "false") << ",\n";
+    out << "  \"results\": [\n";
+
+    int regressions = 0;
+    bool first = true;
+    for (const Benchmark& bench : benches) {
+        if (!config.filter.empty() && bench.name.find(config.filter) == std::string::npos) continue;
+        std::cerr << "Running " << bench.name << "...\n";
+        BenchResult result = runBenchmark(bench, config, perf);
+
+        out << (first ? "" : ",\n");
+        first = false;
+        out << "    {\"name\": \"" << result.name << "\", \"kind\": \"" << result.kind
+            << "\", \"iterations\": " << result.iterations
+            << ", \"ns_per_op\": " << result.medianNs
+            << ", \"min_ns\": " << result.minNs
+            << ", \"max_ns\": " << result.maxNs
+            << ", \"stddev_ns\": " << result.stddevNs;
+        for (int i = 0; i < PerfCounters::kCounterCount; i++) {
+            if (result.hasCounter[i]) {
+                out << ", \"" << PerfCounters::counterName(i) << "_per_op\": " << result.counters[i];
+            }
+        }
+        if (result.hasCounter[PerfCounters::Cycles] && result.hasCounter[PerfCounters::Instructions] &&
+            result.counters[PerfCounters::Cycles] > 0.0) {
+            out << ", \"ipc\": " << result.counters[PerfCounters::Instructions] / result.counters[PerfCounters::Cycles];
+        }
+        if (result.hasCounter[PerfCounters::CacheReferences] && result.hasCounter[PerfCounters::CacheMisses] &&
+            result.counters[PerfCounters::CacheReferences] > 0.0) {
+            out << ", \"cache_miss_rate\": "
+                << result.counters[PerfCounters::CacheMisses] / result.counters[PerfCounters::CacheReferences];
+        }
+        auto base = baseline.find(result.name);
+        if (base != baseline.end() && base->second > 0.0) {
+            double change = result.medianNs / base->second - 1.0;
+            bool regressed = change > config.tolerance;
+            regressions += regressed ? 1 : 0;
+            out << ", \"baseline_ns_per_op\": " << base->second
+                << ", \"change\": " << change
+                << ", \"regressed\": " << (regressed ? "true" : "false");
+        }
+        out << "}";
+    }
+
+    out << "\n  ],\n";
+    if (!baseline.empty()) {
+        out << "  \"tolerance\": " << config.tolerance << ",\n";
+        out << "  \"regressions\": " << regressions << ",\n";
+    }
+    out << "  \"peak_rss_kb\": " << peakRssKb() << "\n";
+    out << "}\n";
+
+    if (config.output.empty()) {
+        std::cout << out.str();
+    } else {
+        std::ofstream file(config.output);
+        file << out.str();
+        if (!file) {
+            std::cerr << "Could not write " << config.output << "\n";
+            return 1;
+        }
+    }
+
+    if (regressions > 0) {
+        std::cerr << regressions << " benchmark(s) slower than the baseline by more than "
+                  << config.tolerance * 100.0 << "%\n";
+        return 2;
+    }
+    return 0;
+}
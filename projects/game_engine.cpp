@@ -1,46 +1,103 @@
+// Profiling builds also count heap allocations per system
+#if ENGINE_PROFILING
+#define ENGINE_PROFILE_ALLOCATIONS
+#endif
 #include "game_engine.h"
+#include "scene_bridge.h"
+#include <atomic>
 #include <iostream>
+#include <thread>
 
 // Example usage of the game engine
 int main() {
     using namespace GameEngine;
 
     // Create engine instance
-    GameEngine engine;
+    ::GameEngine::GameEngine engine;
     engine.Initialize();
+    engine.SetTargetFrameRate(60.0f);
 
     // Create a scene
     Scene* scene = engine.GetScene();
 
     // Create entities
-    Entity* player = scene->CreateEntity("player");
-    Entity* enemy = scene->CreateEntity("enemy");
+    Entity player = scene->CreateEntity("player");
+    Entity enemy = scene->CreateEntity("enemy");
 
     // Add transform components
-    player->AddComponent<TransformComponent>(
+    player.AddComponent<TransformComponent>(
         std::make_unique<TransformComponent>(0.0f, 0.0f, 0.0f)
     );
-    enemy->AddComponent<TransformComponent>(
+    enemy.AddComponent<TransformComponent>(
         std::make_unique<TransformComponent>(10.0f, 0.0f, 5.0f)
     );
 
     // Add render components
-    player->AddComponent<RenderComponent>(
+    player.AddComponent<RenderComponent>(
         std::make_unique<RenderComponent>("models/player.obj")
     );
-    enemy->AddComponent<RenderComponent>(
+    enemy.AddComponent<RenderComponent>(
         std::make_unique<RenderComponent>("models/enemy.obj")
     );
 
+    // Drift every entity along z, one fixed step at a time
+    scene->GetSystems().AddSystem("drift", [](Registry& registry, float deltaTime) {
+        size_t moved = 0;
+        registry.Each<TransformComponent>([&](EntityHandle, TransformComponent& transform) {
+            transform.Translate(0.0f, 0.0f, deltaTime);
+            moved++;
+        });
+        return moved;
+    }).Writing<TransformComponent>();
+
+    // A particle burst stored as batch transforms, integrated in bulk
+    Registry& registry = scene->GetRegistry();
+    registry.GetPool<BatchTransform>().Reserve(1000);
+    for (int i = 0; i < 1000; ++i) {
+        BatchTransform particle;
+        particle.velocityX = std::cos(i * 0.1f);
+        particle.velocityY = 1.0f;
+        particle.velocityZ = std::sin(i * 0.1f);
+        registry.AddComponent<BatchTransform>(registry.CreateEntity(), particle);
+    }
+    scene->GetSystems().AddSystem<VelocityIntegrationSystem>();
+
+    // A render thread draws each frame from its snapshot while the next
+    // frame simulates
+    engine.SetSnapshotsEnabled(true);
+    std::atomic<bool> rendering{true};
+    std::atomic<uint64_t> framesDrawn{0};
+    std::thread renderThread([&] {
+        while (rendering.load()) {
+            bool isNew = false;
+            const RenderSnapshot& snapshot = engine.AcquireSnapshot(&isNew);
+            if (isNew && !snapshot.instances.empty()) {
+                framesDrawn++;
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    });
+
+    // The ray tracer's scene follows the ECS one; each sync pushes only
+    // what changed and refits
+    RayTracing::Scene tracedScene;
+    RayTracingBridge bridge(registry, tracedScene);
+
     // Game loop simulation
     std::cout << "Game Engine Demo\n";
     std::cout << "================\n\n";
 
     for (int frame = 0; frame < 5; ++frame) {
-        engine.Update();
+        // Despawn the enemy; it goes at the end of this frame's update
+        if (frame == 2) {
+            scene->DestroyEntity(enemy);
+        }
+
+        int steps = engine.Update();
 
         // Get and update player position
-        if (auto* transform = player->GetComponent<TransformComponent>()) {
+        if (auto* transform = player.GetComponent<TransformComponent>()) {
             transform->Translate(1.0f, 0.0f, 0.0f);
             std::cout << "Frame " << frame << ": Player position ("
                       << transform->GetX() << ", "
@@ -48,13 +105,51 @@ int main() {
                       << transform->GetZ() << ")\n";
         }
 
-        if (auto* render = player->GetComponent<RenderComponent>()) {
+        if (auto* render = player.GetComponent<RenderComponent>()) {
             std::cout << "Player mesh: " << render->GetMeshPath() << "\n";
             std::cout << "Visible: " << (render->IsVisible() ? "Yes" : "No") << "\n";
+            std::cout << "Mesh loaded: " << (render->IsMeshReady() ? "Yes" : "No, drawing placeholder") << "\n";
+        }
+
+        std::cout << "Entities in scene: " << scene->GetEntityCount() << "\n";
+
+        // Cull against a camera behind the origin looking down -z
+        DrawList drawList;
+        scene->BuildDrawList(Frustum::Perspective(0.0f, 2.0f, 20.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+                                                  1.0f, 16.0f / 9.0f, 0.1f, 100.0f), drawList);
+        std::cout << "Draw list: " << drawList.GetItems().size() << " of " << drawList.GetTestedCount()
+                  << " renderables in " << drawList.GetBatches().size() << " batch(es)\n";
+
+        RayTracingBridge::SyncStats synced = bridge.Sync();
+        std::cout << "Ray tracer scene: " << bridge.GetBoundCount() << " bound, " << synced.added << " added, "
+                  << synced.updated << " moved, " << synced.removed << " removed\n";
+
+        std::vector<EntityHandle> nearby;
+        scene->GetSpatialIndex().QueryRadius(0.0f, 0.0f, 0.0f, 8.0f, nearby);
+        std::cout << "Entities within 8 units of the origin: " << nearby.size() << "\n";
+        std::cout << "Frame time: " << engine.GetFrameTime() * 1000.0f << " ms, "
+                  << steps << " fixed step(s), alpha " << engine.GetInterpolationAlpha() << "\n\n";
+
+        engine.WaitForNextFrame();
+    }
+
+    rendering = false;
+    renderThread.join();
+    std::cout << "Render thread drew " << framesDrawn.load() << " snapshot(s)\n";
+
+    for (const auto& stage : scene->GetSystems().GetStages()) {
+        for (const System* system : stage) {
+            const System::Stats& stats = system->GetStats();
+            std::cout << "System " << system->GetName() << ": " << stats.runs << " runs, "
+                      << stats.totalMilliseconds << " ms total, " << stats.entities << " entities last run\n";
         }
+    }
 
-        std::cout << "Entities in scene: " << scene->GetEntityCount() << "\n\n";
+#if ENGINE_PROFILING
+    if (Profiling::Profiler::instance().saveChromeTrace("game_engine_trace.json")) {
+        std::cout << "Trace written to game_engine_trace.json\n";
     }
+#endif
 
     engine.Shutdown();
     std::cout << "Engine shutdown complete.\n";
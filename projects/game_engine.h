@@ -1,11 +1,50 @@
 #ifndef GAME_ENGINE_H
 #define GAME_ENGINE_H
 
+#include "asset_manager.h"
+#include "job_system.h"
+#include "profiler.h"
+#include "simd_math.h"
 #include <vector>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GE_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define GE_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Debug-only entity names (see Scene)
+#ifndef ENGINE_ENTITY_NAMES
+#ifdef NDEBUG
+#define ENGINE_ENTITY_NAMES 0
+#else
+#define ENGINE_ENTITY_NAMES 1
+#endif
+#endif
+
+// Lets GCC and Clang emit AVX2 kernels in a baseline-ISA translation unit;
+// they only run after a CPU check
+#if defined(GE_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define GE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define GE_TARGET_AVX2
+#endif
 
 namespace GameEngine {
 
@@ -16,27 +55,622 @@ namespace GameEngine {
         virtual void Update(float deltaTime) = 0;
     };
 
-    // Entity class - container for components
+    // Entities are 32-bit handles: a 22-bit index into the registry's
+    // sparse arrays and a 10-bit generation that changes each time the
+    // index is reused, so handles to destroyed entities stop matching
+    using EntityHandle = uint32_t;
+    constexpr EntityHandle kNullEntity = std::numeric_limits<uint32_t>::max();
+    constexpr uint32_t kEntityIndexBits = 22;
+    constexpr uint32_t kEntityIndexMask = (1u << kEntityIndexBits) - 1;
+    constexpr uint32_t kEntityGenerationMask = (1u << (32 - kEntityIndexBits)) - 1;
+
+    inline uint32_t EntityIndex(EntityHandle entity) { return entity & kEntityIndexMask; }
+    inline uint32_t EntityGeneration(EntityHandle entity) { return entity >> kEntityIndexBits; }
+
+    inline EntityHandle MakeEntity(uint32_t index, uint32_t generation) {
+        return (generation << kEntityIndexBits) | index;
+    }
+
+    using ComponentTypeId = uint32_t;
+
+    // Small dense ids, one per component type, fixed on first use so they
+    // can index the registry's pool table directly
+    class ComponentType {
+    private:
+        static ComponentTypeId Next() {
+            static std::atomic<ComponentTypeId> counter{0};
+            return counter++;
+        }
+
+    public:
+        template<typename T>
+        static ComponentTypeId Id() {
+            static const ComponentTypeId id = Next();
+            return id;
+        }
+    };
+
+    // Sparse set of entities: sparse_ maps an entity's index to its slot in
+    // the dense arrays, which hold the pool's members back to back. Dense
+    // entries keep the full handle, so a stale handle never matches.
+    class ComponentPoolBase {
+    protected:
+        static constexpr uint32_t kAbsent = std::numeric_limits<uint32_t>::max();
+
+        std::vector<uint32_t> sparse_;
+        std::vector<EntityHandle> dense_;
+
+        uint32_t Insert(EntityHandle entity) {
+            uint32_t index = EntityIndex(entity);
+            if (index >= sparse_.size()) {
+                sparse_.resize(index + 1, kAbsent);
+            }
+            sparse_[index] = (uint32_t)dense_.size();
+            dense_.push_back(entity);
+            return sparse_[index];
+        }
+
+        // Moves the last member into slot and returns the slot it vacated
+        uint32_t Erase(EntityHandle entity) {
+            uint32_t slot = sparse_[EntityIndex(entity)];
+            EntityHandle last = dense_.back();
+            dense_[slot] = last;
+            sparse_[EntityIndex(last)] = slot;
+            dense_.pop_back();
+            sparse_[EntityIndex(entity)] = kAbsent;
+            return slot;
+        }
+
+        // kAbsent unless entity is a member
+        uint32_t SlotOf(EntityHandle entity) const {
+            uint32_t index = EntityIndex(entity);
+            if (index >= sparse_.size()) return kAbsent;
+            uint32_t slot = sparse_[index];
+            return slot != kAbsent && dense_[slot] == entity ? slot : kAbsent;
+        }
+
+    public:
+        virtual ~ComponentPoolBase() = default;
+        virtual bool Remove(EntityHandle entity) = 0;
+        virtual void Clear() = 0;
+
+        bool Contains(EntityHandle entity) const { return SlotOf(entity) != kAbsent; }
+
+        size_t Size() const { return dense_.size(); }
+        const std::vector<EntityHandle>& GetEntities() const { return dense_; }
+    };
+
+    // Components of one type stored by value, densely, in insertion order
+    // (removal moves the last one into the gap).
+    // Adding or removing components of a type may move the others, so
+    // pointers from Get() last until the pool next changes.
+    template<typename T>
+    class ComponentPool : public ComponentPoolBase {
+    public:
+        using Hook = std::function<void(EntityHandle, T&)>;
+
+    private:
+        std::vector<T> components_;
+        Hook onAdd_;
+        Hook onRemove_;
+
+    public:
+        template<typename... Args>
+        T& Emplace(EntityHandle entity, Args&&... args) {
+            if (Contains(entity)) {
+                T& component = components_[SlotOf(entity)];
+                if (onRemove_) onRemove_(entity, component);
+                component = T(std::forward<Args>(args)...);
+                if (onAdd_) onAdd_(entity, component);
+                return component;
+            }
+            Insert(entity);
+            components_.emplace_back(std::forward<Args>(args)...);
+            if (onAdd_) onAdd_(entity, components_.back());
+            return components_.back();
+        }
+
+        // Called after a component is added and before one is removed, so
+        // owners of derived data (e.g. the spatial index) can follow along.
+        // Clear() skips them.
+        void SetOnAdd(Hook hook) { onAdd_ = std::move(hook); }
+        void SetOnRemove(Hook hook) { onRemove_ = std::move(hook); }
+
+        T* Get(EntityHandle entity) {
+            uint32_t slot = SlotOf(entity);
+            return slot != kAbsent ? &components_[slot] : nullptr;
+        }
+
+        const T* Get(EntityHandle entity) const {
+            uint32_t slot = SlotOf(entity);
+            return slot != kAbsent ? &components_[slot] : nullptr;
+        }
+
+        bool Remove(EntityHandle entity) override {
+            if (!Contains(entity)) return false;
+            if (onRemove_) onRemove_(entity, components_[SlotOf(entity)]);
+            uint32_t slot = Erase(entity);
+            if (slot != components_.size() - 1) {
+                components_[slot] = std::move(components_.back());
+            }
+            components_.pop_back();
+            return true;
+        }
+
+        void Clear() override {
+            sparse_.clear();
+            dense_.clear();
+            components_.clear();
+        }
+
+        // Dense component array, parallel to GetEntities()
+        T* Data() { return components_.data(); }
+        const T* Data() const { return components_.data(); }
+    };
+
+    // Pool that stores components of type T; specialised for components
+    // with a layout of their own (see TransformSoA)
+    template<typename T>
+    struct PoolFor {
+        using Type = ComponentPool<T>;
+    };
+
+    template<typename T>
+    using PoolType = typename PoolFor<T>::Type;
+
+    // Owns every component pool and hands out entity handles. Destroyed
+    // indices go on a free list and come back with the next generation; an
+    // index whose generation would wrap is retired instead.
+    class Registry {
+    private:
+        std::vector<std::unique_ptr<ComponentPoolBase>> pools_;
+        std::vector<EntityHandle> handles_;         // By index: the last handle issued
+        std::vector<uint8_t> live_;                 // By index
+        std::vector<uint32_t> free_;
+        uint32_t alive_;
+
+        void Recycle(uint32_t index) {
+            live_[index] = 0;
+            if (EntityGeneration(handles_[index]) < kEntityGenerationMask) free_.push_back(index);
+        }
+
+    public:
+        Registry() : alive_(0) {}
+
+        EntityHandle CreateEntity() {
+            alive_++;
+            if (!free_.empty()) {
+                uint32_t index = free_.back();
+                free_.pop_back();
+                handles_[index] = MakeEntity(index, EntityGeneration(handles_[index]) + 1);
+                live_[index] = 1;
+                return handles_[index];
+            }
+            uint32_t index = (uint32_t)handles_.size();
+            if (index >= kEntityIndexMask) throw std::length_error("Registry: out of entity indices");
+            handles_.push_back(MakeEntity(index, 0));
+            live_.push_back(1);
+            return handles_.back();
+        }
+
+        bool IsAlive(EntityHandle entity) const {
+            uint32_t index = EntityIndex(entity);
+            return index < handles_.size() && live_[index] && handles_[index] == entity;
+        }
+
+        // Removes every component the entity has (running pool hooks) and
+        // frees its index; false if the handle is stale
+        bool DestroyEntity(EntityHandle entity) {
+            if (!IsAlive(entity)) return false;
+            for (auto& pool : pools_) {
+                if (pool) pool->Remove(entity);
+            }
+            Recycle(EntityIndex(entity));
+            alive_--;
+            return true;
+        }
+
+        size_t GetEntityCount() const { return alive_; }
+
+        template<typename T>
+        PoolType<T>& GetPool() {
+            ComponentTypeId id = ComponentType::Id<T>();
+            if (id >= pools_.size()) {
+                pools_.resize(id + 1);
+            }
+            if (!pools_[id]) {
+                pools_[id] = std::make_unique<PoolType<T>>();
+            }
+            return static_cast<PoolType<T>&>(*pools_[id]);
+        }
+
+        // Null until a component of type T has been added
+        template<typename T>
+        const PoolType<T>* FindPool() const {
+            ComponentTypeId id = ComponentType::Id<T>();
+            return id < pools_.size() ? static_cast<const PoolType<T>*>(pools_[id].get()) : nullptr;
+        }
+
+        template<typename T>
+        PoolType<T>* FindPool() {
+            ComponentTypeId id = ComponentType::Id<T>();
+            return id < pools_.size() ? static_cast<PoolType<T>*>(pools_[id].get()) : nullptr;
+        }
+
+        // Replaces any component of the same type the entity already has
+        template<typename T, typename... Args>
+        decltype(auto) AddComponent(EntityHandle entity, Args&&... args) {
+            return GetPool<T>().Emplace(entity, std::forward<Args>(args)...);
+        }
+
+        template<typename T>
+        T* GetComponent(EntityHandle entity) {
+            ComponentPool<T>* pool = FindPool<T>();
+            return pool ? pool->Get(entity) : nullptr;
+        }
+
+        template<typename T>
+        bool HasComponent(EntityHandle entity) const {
+            const PoolType<T>* pool = FindPool<T>();
+            return pool && pool->Contains(entity);
+        }
+
+        template<typename T>
+        bool RemoveComponent(EntityHandle entity) {
+            PoolType<T>* pool = FindPool<T>();
+            return pool && pool->Remove(entity);
+        }
+
+        // Calls fn(entity, T&, Others&...) for every entity that has all the
+        // listed components, walking T's dense array
+        template<typename T, typename... Others, typename Fn>
+        void Each(Fn&& fn) {
+            ComponentPool<T>* pool = FindPool<T>();
+            if (!pool) return;
+            const std::vector<EntityHandle>& entities = pool->GetEntities();
+            T* components = pool->Data();
+            for (size_t i = 0; i < entities.size(); i++) {
+                EntityHandle entity = entities[i];
+                if ((HasComponent<Others>(entity) && ...)) {
+                    fn(entity, components[i], *GetComponent<Others>(entity)...);
+                }
+            }
+        }
+
+        // Destroys every entity without running pool hooks. Indices are
+        // recycled rather than reset, so handles from before stay stale.
+        void Clear() {
+            for (auto& pool : pools_) {
+                if (pool) pool->Clear();
+            }
+            for (uint32_t index = (uint32_t)handles_.size(); index-- > 0;) {
+                if (live_[index]) Recycle(index);
+            }
+            alive_ = 0;
+        }
+    };
+
+    // Value view of an entity: component calls forward to the registry.
+    // Cheap to copy; check IsAlive() before using one kept across frames.
     class Entity {
     private:
-        std::unordered_map<std::string, std::unique_ptr<Component>> components_;
-        std::string id_;
+        Registry* registry_;
+        EntityHandle handle_;
 
     public:
-        Entity(const std::string& id) : id_(id) {}
+        Entity() : registry_(nullptr), handle_(kNullEntity) {}
+        Entity(Registry& registry, EntityHandle handle) : registry_(&registry), handle_(handle) {}
+
+        bool IsAlive() const { return registry_ && registry_->IsAlive(handle_); }
 
+        // The component is moved into T's pool and stored by value as a T
         template<typename T>
         void AddComponent(std::unique_ptr<T> component) {
-            components_[typeid(T).name()] = std::move(component);
+            registry_->AddComponent<T>(handle_, std::move(*component));
+        }
+
+        template<typename T, typename... Args>
+        T& EmplaceComponent(Args&&... args) {
+            return registry_->AddComponent<T>(handle_, std::forward<Args>(args)...);
         }
 
         template<typename T>
         T* GetComponent() {
-            auto it = components_.find(typeid(T).name());
-            return it != components_.end() ? static_cast<T*>(it->second.get()) : nullptr;
+            return registry_->GetComponent<T>(handle_);
         }
 
-        const std::string& GetId() const { return id_; }
+        template<typename T>
+        bool HasComponent() const {
+            return registry_->HasComponent<T>(handle_);
+        }
+
+        template<typename T>
+        bool RemoveComponent() {
+            return registry_->RemoveComponent<T>(handle_);
+        }
+
+        EntityHandle GetHandle() const { return handle_; }
+    };
+
+    // Uniform hash grid over entity positions for neighbour queries and
+    // collision broadphase. Entities live in the cell holding their
+    // position; only occupied cells take memory.
+    //
+    // Moves are queued, not applied: MarkMoved() is lock-free and safe from
+    // parallel systems, and Flush() re-buckets just the queued entities.
+    // Queries see positions as of the last Flush().
+    class SpatialGrid {
+    public:
+        struct Entry {
+            EntityHandle entity;
+            float x, y, z;
+        };
+
+        using Pair = std::pair<EntityHandle, EntityHandle>;
+
+    private:
+        static constexpr uint64_t kNoCell = std::numeric_limits<uint64_t>::max();
+
+        struct Location {
+            uint64_t cell;
+            uint32_t index;                 // Within the cell's entry list
+            EntityHandle entity;
+        };
+
+        float cellSize_;
+        float inverseCellSize_;
+        std::unordered_map<uint64_t, std::vector<Entry>> cells_;
+        std::vector<Location> locations_;           // By entity index
+        size_t count_;
+        std::vector<EntityHandle> moved_;           // Queued moves, sized up front
+        std::atomic<uint32_t> movedCount_;
+
+        int32_t CellCoord(float v) const { return (int32_t)std::floor(v * inverseCellSize_); }
+
+        // 21 bits per axis; far-apart cells may share a key, which only
+        // costs extra distance tests
+        static uint64_t CellKey(int32_t cx, int32_t cy, int32_t cz) {
+            return ((uint64_t)(cx & 0x1FFFFF) << 42) | ((uint64_t)(cy & 0x1FFFFF) << 21) | (uint64_t)(cz & 0x1FFFFF);
+        }
+
+        uint64_t KeyOf(float x, float y, float z) const {
+            return CellKey(CellCoord(x), CellCoord(y), CellCoord(z));
+        }
+
+        void Unlink(EntityHandle entity) {
+            Location& location = locations_[EntityIndex(entity)];
+            auto it = cells_.find(location.cell);
+            std::vector<Entry>& entries = it->second;
+            Entry& last = entries.back();
+            if (last.entity != entity) {
+                entries[location.index] = last;
+                locations_[EntityIndex(last.entity)].index = location.index;
+            }
+            entries.pop_back();
+            if (entries.empty()) cells_.erase(it);
+            location.cell = kNoCell;
+        }
+
+        void Link(EntityHandle entity, float x, float y, float z, uint64_t key) {
+            std::vector<Entry>& entries = cells_[key];
+            locations_[EntityIndex(entity)] = Location{key, (uint32_t)entries.size(), entity};
+            entries.push_back(Entry{entity, x, y, z});
+        }
+
+        // Calls visit(entries) for every occupied cell overlapping the box
+        template<typename Visit>
+        void ForCells(float minX, float minY, float minZ, float maxX, float maxY, float maxZ, Visit&& visit) const {
+            int32_t x0 = CellCoord(minX), y0 = CellCoord(minY), z0 = CellCoord(minZ);
+            int32_t x1 = CellCoord(maxX), y1 = CellCoord(maxY), z1 = CellCoord(maxZ);
+            double span = ((double)x1 - x0 + 1) * ((double)y1 - y0 + 1) * ((double)z1 - z0 + 1);
+            if (span > (double)cells_.size()) {
+                // Cheaper to filter every occupied cell than probe empty ones
+                for (const auto& cell : cells_) visit(cell.second);
+                return;
+            }
+            for (int32_t cx = x0; cx <= x1; cx++) {
+                for (int32_t cy = y0; cy <= y1; cy++) {
+                    for (int32_t cz = z0; cz <= z1; cz++) {
+                        auto it = cells_.find(CellKey(cx, cy, cz));
+                        if (it != cells_.end()) visit(it->second);
+                    }
+                }
+            }
+        }
+
+    public:
+        explicit SpatialGrid(float cellSize = 4.0f)
+            : cellSize_(cellSize), inverseCellSize_(1.0f / cellSize), count_(0), movedCount_(0) {}
+
+        SpatialGrid(const SpatialGrid&) = delete;
+        SpatialGrid& operator=(const SpatialGrid&) = delete;
+
+        float GetCellSize() const { return cellSize_; }
+        size_t Size() const { return count_; }
+        size_t GetCellCount() const { return cells_.size(); }
+
+        bool Contains(EntityHandle entity) const {
+            uint32_t index = EntityIndex(entity);
+            return index < locations_.size() && locations_[index].cell != kNoCell &&
+                   locations_[index].entity == entity;
+        }
+
+        void Insert(EntityHandle entity, float x, float y, float z) {
+            if (EntityIndex(entity) >= locations_.size()) {
+                locations_.resize(EntityIndex(entity) + 1, Location{kNoCell, 0, kNullEntity});
+            }
+            if (Contains(entity)) {
+                Move(entity, x, y, z);
+                return;
+            }
+            Link(entity, x, y, z, KeyOf(x, y, z));
+            count_++;
+            // Each tracked entity queues at most once between flushes, on
+            // top of whatever is already queued
+            size_t capacity = count_ + movedCount_.load(std::memory_order_relaxed);
+            if (moved_.size() < capacity) moved_.resize(capacity);
+        }
+
+        void Remove(EntityHandle entity) {
+            if (!Contains(entity)) return;
+            Unlink(entity);
+            count_--;
+        }
+
+        // Re-buckets only when the entity crosses into another cell
+        void Move(EntityHandle entity, float x, float y, float z) {
+            Location& location = locations_[EntityIndex(entity)];
+            uint64_t key = KeyOf(x, y, z);
+            if (key == location.cell) {
+                Entry& entry = cells_.find(key)->second[location.index];
+                entry.x = x;
+                entry.y = y;
+                entry.z = z;
+                return;
+            }
+            Unlink(entity);
+            Link(entity, x, y, z, key);
+        }
+
+        // Queues an entity for the next Flush(). Callers queue each entity
+        // at most once per flush; TransformComponent tracks that itself.
+        void MarkMoved(EntityHandle entity) {
+            uint32_t slot = movedCount_.fetch_add(1, std::memory_order_relaxed);
+            if (slot < moved_.size()) moved_[slot] = entity;
+        }
+
+        // Applies queued moves; position(entity, x, y, z) reports an
+        // entity's current position and returns false if it is gone
+        template<typename PositionFn>
+        void Flush(PositionFn&& position) {
+            uint32_t count = std::min<uint32_t>(movedCount_.load(std::memory_order_acquire), (uint32_t)moved_.size());
+            for (uint32_t i = 0; i < count; i++) {
+                EntityHandle entity = moved_[i];
+                float x, y, z;
+                if (Contains(entity) && position(entity, x, y, z)) {
+                    Move(entity, x, y, z);
+                }
+            }
+            movedCount_.store(0, std::memory_order_relaxed);
+        }
+
+        void Clear() {
+            cells_.clear();
+            locations_.clear();
+            moved_.clear();
+            movedCount_.store(0, std::memory_order_relaxed);
+            count_ = 0;
+        }
+
+        // Entities within radius of (x, y, z), appended to out
+        void QueryRadius(float x, float y, float z, float radius, std::vector<EntityHandle>& out) const {
+            float radius2 = radius * radius;
+            ForCells(x - radius, y - radius, z - radius, x + radius, y + radius, z + radius,
+                     [&](const std::vector<Entry>& entries) {
+                for (const Entry& e : entries) {
+                    float dx = e.x - x, dy = e.y - y, dz = e.z - z;
+                    if (dx * dx + dy * dy + dz * dz <= radius2) out.push_back(e.entity);
+                }
+            });
+        }
+
+        // Entities inside the box, appended to out
+        void QueryBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ,
+                      std::vector<EntityHandle>& out) const {
+            ForCells(minX, minY, minZ, maxX, maxY, maxZ, [&](const std::vector<Entry>& entries) {
+                for (const Entry& e : entries) {
+                    if (e.x >= minX && e.x <= maxX && e.y >= minY && e.y <= maxY && e.z >= minZ && e.z <= maxZ) {
+                        out.push_back(e.entity);
+                    }
+                }
+            });
+        }
+
+        // Up to k entities nearest to (x, y, z), nearest first, replacing
+        // out's contents. Searches shells of cells outwards and stops once
+        // the k-th best is closer than anything an outer shell could hold.
+        void QueryNearest(float x, float y, float z, size_t k, std::vector<EntityHandle>& out) const {
+            out.clear();
+            if (k == 0 || count_ == 0) return;
+
+            using Candidate = std::pair<float, EntityHandle>;
+            std::vector<Candidate> best;            // Max-heap on distance
+            auto consider = [&](const Entry& e) {
+                float dx = e.x - x, dy = e.y - y, dz = e.z - z;
+                Candidate candidate(dx * dx + dy * dy + dz * dz, e.entity);
+                if (best.size() < k) {
+                    best.push_back(candidate);
+                    std::push_heap(best.begin(), best.end());
+                } else if (candidate < best.front()) {
+                    std::pop_heap(best.begin(), best.end());
+                    best.back() = candidate;
+                    std::push_heap(best.begin(), best.end());
+                }
+            };
+
+            int32_t cx = CellCoord(x), cy = CellCoord(y), cz = CellCoord(z);
+            for (int32_t ring = 0;; ring++) {
+                double side = 2.0 * ring + 1.0;
+                if (side * side * side > (double)cells_.size() * 2.0) {
+                    // The shells now cover more cells than are occupied
+                    best.clear();
+                    for (const auto& cell : cells_) {
+                        for (const Entry& e : cell.second) consider(e);
+                    }
+                    break;
+                }
+                for (int32_t dx = -ring; dx <= ring; dx++) {
+                    for (int32_t dy = -ring; dy <= ring; dy++) {
+                        bool edge = dx == -ring || dx == ring || dy == -ring || dy == ring;
+                        for (int32_t dz = -ring; dz <= ring; dz += (edge || ring == 0) ? 1 : 2 * ring) {
+                            auto it = cells_.find(CellKey(cx + dx, cy + dy, cz + dz));
+                            if (it == cells_.end()) continue;
+                            for (const Entry& e : it->second) consider(e);
+                        }
+                    }
+                }
+                // Anything outside this shell is at least ring cells away
+                float reach = ring * cellSize_;
+                if (best.size() == k && best.front().first <= reach * reach) break;
+            }
+
+            std::sort_heap(best.begin(), best.end());
+            for (const Candidate& candidate : best) out.push_back(candidate.second);
+        }
+
+        // Every pair of entities at most distance apart, each pair once,
+        // replacing out's contents
+        void QueryPairs(float distance, std::vector<Pair>& out) const {
+            out.clear();
+            float distance2 = distance * distance;
+            int32_t reach = std::max(1, (int32_t)std::ceil(distance * inverseCellSize_));
+            auto test = [&](const Entry& a, const Entry& b) {
+                float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+                if (dx * dx + dy * dy + dz * dz <= distance2) out.emplace_back(a.entity, b.entity);
+            };
+            for (const auto& cell : cells_) {
+                const std::vector<Entry>& entries = cell.second;
+                for (size_t i = 0; i < entries.size(); i++) {
+                    for (size_t j = i + 1; j < entries.size(); j++) test(entries[i], entries[j]);
+                }
+                const Entry& sample = entries.front();
+                int32_t cx = CellCoord(sample.x), cy = CellCoord(sample.y), cz = CellCoord(sample.z);
+                for (int32_t dx = -reach; dx <= reach; dx++) {
+                    for (int32_t dy = -reach; dy <= reach; dy++) {
+                        for (int32_t dz = -reach; dz <= reach; dz++) {
+                            uint64_t key = CellKey(cx + dx, cy + dy, cz + dz);
+                            // Each neighbouring pair of cells is handled from the lower key
+                            if (key <= cell.first) continue;
+                            auto it = cells_.find(key);
+                            if (it == cells_.end()) continue;
+                            for (const Entry& a : entries) {
+                                for (const Entry& b : it->second) test(a, b);
+                            }
+                        }
+                    }
+                }
+            }
+        }
     };
 
     // Transform component for position, rotation, scale
@@ -46,106 +680,1108 @@ namespace GameEngine {
         float rotationX_, rotationY_, rotationZ_;
         float scaleX_, scaleY_, scaleZ_;
 
+        // Set while the entity is in a spatial index
+        SpatialGrid* grid_;
+        EntityHandle entity_;
+        bool queued_;                       // Move already queued for the next flush
+
+        void NotifyMoved() {
+            if (grid_ && !queued_) {
+                queued_ = true;
+                grid_->MarkMoved(entity_);
+            }
+        }
+
     public:
         TransformComponent(float x = 0, float y = 0, float z = 0)
             : x_(x), y_(y), z_(z), rotationX_(0), rotationY_(0), rotationZ_(0),
-              scaleX_(1), scaleY_(1), scaleZ_(1) {}
+              scaleX_(1), scaleY_(1), scaleZ_(1), grid_(nullptr), entity_(kNullEntity), queued_(false) {}
 
-        void Update(float deltaTime) override {}
+        void Update(float /*deltaTime*/) override {}
 
         void SetPosition(float x, float y, float z) {
             x_ = x; y_ = y; z_ = z;
+            NotifyMoved();
         }
 
         void Translate(float dx, float dy, float dz) {
             x_ += dx; y_ += dy; z_ += dz;
+            NotifyMoved();
+        }
+
+        // Position as a SIMD vector with w = 1, and a translation by one
+        // (w is ignored); both suit math written against Math::float4
+        Math::float4 GetPosition() const { return Math::float4(x_, y_, z_, 1.0f); }
+
+        void Translate(const Math::float4& delta) {
+            Math::float4 moved = Math::float4(x_, y_, z_) + delta;
+            x_ = moved.x(); y_ = moved.y(); z_ = moved.z();
+            NotifyMoved();
+        }
+
+        // Links the transform to the index that tracks it, or unlinks it
+        void AttachSpatialIndex(SpatialGrid* grid, EntityHandle entity) {
+            grid_ = grid;
+            entity_ = entity;
+            queued_ = false;
         }
 
+        void ClearMoveQueued() { queued_ = false; }
+
         float GetX() const { return x_; }
         float GetY() const { return y_; }
         float GetZ() const { return z_; }
+
+        // Rotation and scale don't move the entity in the spatial index
+        void SetRotation(float x, float y, float z) {
+            rotationX_ = x; rotationY_ = y; rotationZ_ = z;
+        }
+
+        void SetScale(float x, float y, float z) {
+            scaleX_ = x; scaleY_ = y; scaleZ_ = z;
+        }
+
+        float GetRotationX() const { return rotationX_; }
+        float GetRotationY() const { return rotationY_; }
+        float GetRotationZ() const { return rotationZ_; }
+        float GetScaleX() const { return scaleX_; }
+        float GetScaleY() const { return scaleY_; }
+        float GetScaleZ() const { return scaleZ_; }
     };
 
-    // Render component for rendering entities
+    // Render component for rendering entities. Mesh and material are held
+    // as interned ids; the bounding sphere is centred on the entity's
+    // transform and sized in world units. In a scene with an asset manager
+    // the component also holds its mesh's handle, and draws with the
+    // placeholder until the mesh has streamed in.
     class RenderComponent : public Component {
     private:
-        std::string meshPath_;
+        NameId meshId_;
+        NameId materialId_;
+        float boundingRadius_;
         bool visible_;
+        AssetHandle meshAsset_;
 
     public:
-        RenderComponent(const std::string& meshPath)
-            : meshPath_(meshPath), visible_(true) {}
+        RenderComponent(const std::string& meshPath, const std::string& materialPath = "",
+                        float boundingRadius = 1.0f)
+            : meshId_(NameTable::Shared().Intern(meshPath)),
+              materialId_(NameTable::Shared().Intern(materialPath)),
+              boundingRadius_(boundingRadius), visible_(true) {}
 
-        void Update(float deltaTime) override {}
+        void Update(float /*deltaTime*/) override {}
 
         void SetVisible(bool visible) { visible_ = visible; }
         bool IsVisible() const { return visible_; }
-        const std::string& GetMeshPath() const { return meshPath_; }
+        const std::string& GetMeshPath() const { return NameTable::Shared().GetName(meshId_); }
+        const std::string& GetMaterialPath() const { return NameTable::Shared().GetName(materialId_); }
+        NameId GetMeshId() const { return meshId_; }
+        NameId GetMaterialId() const { return materialId_; }
+
+        void SetMeshAsset(AssetHandle handle) { meshAsset_ = std::move(handle); }
+        const AssetHandle& GetMeshAsset() const { return meshAsset_; }
+        bool IsMeshReady() const { return meshAsset_.IsReady(); }
+
+        void SetBoundingRadius(float radius) { boundingRadius_ = radius; }
+        float GetBoundingRadius() const { return boundingRadius_; }
+    };
+
+    // Six inward-facing planes; a point p is inside plane i when
+    // dot(n, p) + d >= 0
+    class Frustum {
+    public:
+        struct Plane {
+            float nx, ny, nz, d;
+        };
+
+    private:
+        Plane planes_[6];
+
+        static Plane Normalized(float a, float b, float c, float d) {
+            float length = std::sqrt(a * a + b * b + c * c);
+            float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+            return Plane{a * inverse, b * inverse, c * inverse, d * inverse};
+        }
+
+    public:
+        Frustum() : planes_{} {}
+
+        // Planes of a column-major view-projection matrix (OpenGL clip
+        // space, -w <= z <= w), by the Gribb-Hartmann method
+        static Frustum FromMatrix(const float* m) {
+            auto row = [m](int r, int c) { return m[c * 4 + r]; };
+            Frustum frustum;
+            for (int axis = 0; axis < 3; axis++) {
+                for (int side = 0; side < 2; side++) {
+                    float sign = side == 0 ? 1.0f : -1.0f;
+                    frustum.planes_[axis * 2 + side] = Normalized(
+                        row(3, 0) + sign * row(axis, 0), row(3, 1) + sign * row(axis, 1),
+                        row(3, 2) + sign * row(axis, 2), row(3, 3) + sign * row(axis, 3));
+                }
+            }
+            return frustum;
+        }
+
+        // Symmetric perspective frustum from a camera position and basis;
+        // forward and up need not be unit length but must not be parallel
+        static Frustum Perspective(float eyeX, float eyeY, float eyeZ,
+                                   float forwardX, float forwardY, float forwardZ,
+                                   float upX, float upY, float upZ,
+                                   float fovYRadians, float aspect, float nearZ, float farZ) {
+            auto normalize = [](float& x, float& y, float& z) {
+                float inverse = 1.0f / std::sqrt(x * x + y * y + z * z);
+                x *= inverse; y *= inverse; z *= inverse;
+            };
+            float fx = forwardX, fy = forwardY, fz = forwardZ;
+            normalize(fx, fy, fz);
+            float rx = fy * upZ - fz * upY, ry = fz * upX - fx * upZ, rz = fx * upY - fy * upX;
+            normalize(rx, ry, rz);
+            float ux = ry * fz - rz * fy, uy = rz * fx - rx * fz, uz = rx * fy - ry * fx;
+
+            float tanY = std::tan(fovYRadians * 0.5f);
+            float tanX = tanY * aspect;
+            auto plane = [&](float nx, float ny, float nz) {
+                return Normalized(nx, ny, nz, -(nx * eyeX + ny * eyeY + nz * eyeZ));
+            };
+
+            Frustum frustum;
+            Plane nearPlane = plane(fx, fy, fz);
+            nearPlane.d -= nearZ;
+            Plane farPlane = plane(-fx, -fy, -fz);
+            farPlane.d += farZ;
+            frustum.planes_[0] = nearPlane;
+            frustum.planes_[1] = farPlane;
+            // Side planes contain the eye; their normals lean back along forward
+            frustum.planes_[2] = plane(rx + fx * tanX, ry + fy * tanX, rz + fz * tanX);
+            frustum.planes_[3] = plane(-rx + fx * tanX, -ry + fy * tanX, -rz + fz * tanX);
+            frustum.planes_[4] = plane(ux + fx * tanY, uy + fy * tanY, uz + fz * tanY);
+            frustum.planes_[5] = plane(-ux + fx * tanY, -uy + fy * tanY, -uz + fz * tanY);
+            return frustum;
+        }
+
+        const Plane& GetPlane(int i) const { return planes_[i]; }
+
+        // Conservative: spheres near a corner may pass while outside
+        bool IntersectsSphere(float x, float y, float z, float radius) const {
+            for (const Plane& p : planes_) {
+                if (p.nx * x + p.ny * y + p.nz * z + p.d < -radius) return false;
+            }
+            return true;
+        }
+    };
+
+    // Visible renderables sorted by (mesh, material), with runs of equal
+    // keys grouped into batches a backend can draw as one instanced call
+    class DrawList {
+    public:
+        struct Item {
+            uint64_t key;                   // Mesh id in the high half, material in the low
+            EntityHandle entity;
+            float x, y, z;                  // World position, for instance data
+        };
+
+        struct Batch {
+            NameId mesh;
+            NameId material;
+            uint32_t first;                 // Into GetItems()
+            uint32_t count;
+        };
+
+    private:
+        std::vector<Item> items_;
+        std::vector<Batch> batches_;
+        std::vector<std::vector<Item>> chunks_;     // Per-chunk survivors, reused
+        size_t tested_;
+
+    public:
+        DrawList() : tested_(0) {}
+
+        // Culls every visible RenderComponent whose entity has a transform
+        // against frustum, chunks of grain entities at a time in parallel,
+        // then sorts and batches the survivors. Reuses its storage, so
+        // rebuilding each frame allocates little once warm.
+        void Build(Registry& registry, const Frustum& frustum, Threading::JobSystem& jobs,
+                   uint32_t grain = 4096) {
+            PROFILE_SCOPE("DrawList::Build");
+            items_.clear();
+            batches_.clear();
+            tested_ = 0;
+            ComponentPool<RenderComponent>* renders = registry.FindPool<RenderComponent>();
+            ComponentPool<TransformComponent>* transforms = registry.FindPool<TransformComponent>();
+            if (!renders || !transforms) return;
+
+            const std::vector<EntityHandle>& entities = renders->GetEntities();
+            const RenderComponent* components = renders->Data();
+            uint32_t count = (uint32_t)entities.size();
+            grain = std::max(1u, grain);
+            size_t chunkCount = (count + grain - 1) / grain;
+            if (chunks_.size() < chunkCount) chunks_.resize(chunkCount);
+            tested_ = count;
+
+            jobs.parallelFor(count, grain, [&](uint32_t begin, uint32_t end) {
+                std::vector<Item>& survivors = chunks_[begin / grain];
+                survivors.clear();
+                for (uint32_t i = begin; i < end; i++) {
+                    const RenderComponent& render = components[i];
+                    if (!render.IsVisible()) continue;
+                    const TransformComponent* transform = transforms->Get(entities[i]);
+                    if (!transform) continue;
+                    float x = transform->GetX(), y = transform->GetY(), z = transform->GetZ();
+                    if (!frustum.IntersectsSphere(x, y, z, render.GetBoundingRadius())) continue;
+                    uint64_t key = ((uint64_t)render.GetMeshId() << 32) | render.GetMaterialId();
+                    survivors.push_back(Item{key, entities[i], x, y, z});
+                }
+            });
+
+            size_t total = 0;
+            for (size_t c = 0; c < chunkCount; c++) total += chunks_[c].size();
+            items_.reserve(total);
+            for (size_t c = 0; c < chunkCount; c++) {
+                items_.insert(items_.end(), chunks_[c].begin(), chunks_[c].end());
+            }
+
+            // Entity order within a key keeps the list identical run to run
+            std::sort(items_.begin(), items_.end(), [](const Item& a, const Item& b) {
+                return a.key != b.key ? a.key < b.key : a.entity < b.entity;
+            });
+            for (uint32_t i = 0; i < (uint32_t)items_.size(); i++) {
+                if (batches_.empty() || items_[i].key != items_[batches_.back().first].key) {
+                    batches_.push_back(Batch{(NameId)(items_[i].key >> 32), (NameId)items_[i].key, i, 0});
+                }
+                batches_.back().count++;
+            }
+        }
+
+        const std::vector<Item>& GetItems() const { return items_; }
+        const std::vector<Batch>& GetBatches() const { return batches_; }
+
+        // Renderables considered by the last Build(), visible or not
+        size_t GetTestedCount() const { return tested_; }
+    };
+
+    // Lock-free triple buffer for one producer thread and one consumer
+    // thread. The producer fills GetWriteBuffer() and publishes it; the
+    // consumer picks up the newest published buffer. Neither ever waits,
+    // and neither touches the buffer the other holds.
+    template<typename T>
+    class TripleBuffer {
+    private:
+        static constexpr uint32_t kIndexMask = 3;
+        static constexpr uint32_t kFresh = 4;           // Ready slot not yet consumed
+
+        T buffers_[3];
+        std::atomic<uint32_t> ready_;                   // Slot index | kFresh
+        uint32_t writing_;                              // Producer's slot
+        uint32_t reading_;                              // Consumer's slot
+
+    public:
+        TripleBuffer() : ready_(2), writing_(0), reading_(1) {}
+
+        TripleBuffer(const TripleBuffer&) = delete;
+        TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+        // Producer side. The write buffer holds whatever was published
+        // two rounds ago, so containers in it keep their capacity.
+        T& GetWriteBuffer() { return buffers_[writing_]; }
+
+        void Publish() {
+            writing_ = ready_.exchange(writing_ | kFresh, std::memory_order_acq_rel) & kIndexMask;
+        }
+
+        // Consumer side: swaps in the newest published buffer if there is
+        // one and returns whichever buffer the consumer now holds. It stays
+        // untouched by the producer until the next Acquire().
+        const T& Acquire(bool* isNew = nullptr) {
+            bool fresh = (ready_.load(std::memory_order_relaxed) & kFresh) != 0;
+            if (fresh) {
+                reading_ = ready_.exchange(reading_, std::memory_order_acq_rel) & kIndexMask;
+            }
+            if (isNew) *isNew = fresh;
+            return buffers_[reading_];
+        }
+    };
+
+    // Render-relevant state of a scene, copied out at the end of a frame so
+    // another thread can draw or ray-trace it while the next frame simulates
+    struct RenderSnapshot {
+        struct Instance {
+            EntityHandle entity;
+            NameId mesh;
+            NameId material;
+            bool meshReady;                 // False draws the placeholder
+            float boundingRadius;
+            float x, y, z;
+            float rotationX, rotationY, rotationZ;
+            float scaleX, scaleY, scaleZ;
+        };
+
+        uint64_t frame = 0;                 // 0 until something is published
+        double time = 0.0;                  // Seconds since Initialize()
+        float interpolationAlpha = 0.0f;
+        std::vector<Instance> instances;    // Visible renderables with a transform
+    };
+
+    // Per-frame logic over component arrays. A system declares, in its
+    // constructor, which component types it reads and writes; the scheduler
+    // uses that to run systems that don't conflict at the same time. Systems
+    // that run in parallel may touch only the components they declared and
+    // must not add or remove components.
+    class System {
+    public:
+        struct Access {
+            ComponentTypeId type;
+            bool write;
+            void (*createPool)(Registry& registry);
+        };
+
+        // Entities are whatever the system reports through CountProcessed();
+        // allocations are only counted in builds that define
+        // ENGINE_PROFILE_ALLOCATIONS
+        struct Stats {
+            double lastMilliseconds = 0.0;
+            double totalMilliseconds = 0.0;
+            uint64_t runs = 0;
+            uint64_t entities = 0;          // Last run
+            uint64_t allocations = 0;       // Last run, on the system's thread
+        };
+
+    private:
+        std::string name_;
+        std::vector<Access> access_;
+        Stats stats_;
+        uint64_t processed_;
+
+        template<typename T>
+        static void CreatePool(Registry& registry) { registry.GetPool<T>(); }
+
+    protected:
+        template<typename T>
+        void Reads() { access_.push_back({ComponentType::Id<T>(), false, &CreatePool<T>}); }
+
+        template<typename T>
+        void Writes() { access_.push_back({ComponentType::Id<T>(), true, &CreatePool<T>}); }
+
+        void CountProcessed(uint64_t entities) { processed_ += entities; }
+
+    public:
+        explicit System(const std::string& name) : name_(name), processed_(0) {}
+        virtual ~System() = default;
+
+        virtual void Update(Registry& registry, float deltaTime) = 0;
+
+        // Update() wrapped in a profiling marker and the stats bookkeeping
+        void Run(Registry& registry, float deltaTime) {
+            PROFILE_SCOPE_CATEGORY(name_.c_str(), "system");
+            uint64_t allocationsBefore = Profiling::threadAllocations().count;
+            auto start = std::chrono::steady_clock::now();
+            processed_ = 0;
+            Update(registry, deltaTime);
+            stats_.lastMilliseconds =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            stats_.totalMilliseconds += stats_.lastMilliseconds;
+            stats_.runs++;
+            stats_.entities = processed_;
+            stats_.allocations = Profiling::threadAllocations().count - allocationsBefore;
+            PROFILE_COUNTER(name_.c_str(), processed_);
+        }
+
+        const std::string& GetName() const { return name_; }
+        const Stats& GetStats() const { return stats_; }
+        const std::vector<Access>& GetAccess() const { return access_; }
+
+        // Two systems conflict if either writes a type the other touches
+        bool ConflictsWith(const System& other) const {
+            for (const Access& mine : access_) {
+                for (const Access& theirs : other.access_) {
+                    if (mine.type == theirs.type && (mine.write || theirs.write)) return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    // System built from a callable, for logic that needs no state of its own
+    template<typename Fn>
+    class FunctionSystem : public System {
+    private:
+        Fn fn_;
+
+    public:
+        FunctionSystem(const std::string& name, Fn fn) : System(name), fn_(std::move(fn)) {}
+
+        template<typename T>
+        FunctionSystem& Reading() { Reads<T>(); return *this; }
+
+        template<typename T>
+        FunctionSystem& Writing() { Writes<T>(); return *this; }
+
+        // fn may return the number of entities it processed
+        void Update(Registry& registry, float deltaTime) override {
+            if constexpr (std::is_void<decltype(fn_(registry, deltaTime))>::value) {
+                fn_(registry, deltaTime);
+            } else {
+                CountProcessed((uint64_t)fn_(registry, deltaTime));
+            }
+        }
     };
 
-    // Scene manager for managing entities
+    // Orders systems into stages: a system goes one stage after the last
+    // earlier-registered system it conflicts with, so registration order is
+    // kept wherever it matters and everything within a stage runs in parallel.
+    class SystemScheduler {
+    private:
+        std::vector<std::unique_ptr<System>> systems_;
+        std::vector<std::vector<System*>> stages_;
+        bool dirty_;
+        bool parallel_;
+        Threading::JobSystem* jobs_;        // Null uses JobSystem::shared()
+
+        void BuildStages(Registry& registry) {
+            stages_.clear();
+            std::vector<size_t> stageOf(systems_.size(), 0);
+            for (size_t j = 0; j < systems_.size(); j++) {
+                for (size_t i = 0; i < j; i++) {
+                    if (systems_[j]->ConflictsWith(*systems_[i])) {
+                        stageOf[j] = std::max(stageOf[j], stageOf[i] + 1);
+                    }
+                }
+                if (stageOf[j] >= stages_.size()) stages_.resize(stageOf[j] + 1);
+                stages_[stageOf[j]].push_back(systems_[j].get());
+
+                // Pools must exist before systems look them up concurrently
+                for (const System::Access& access : systems_[j]->GetAccess()) {
+                    access.createPool(registry);
+                }
+            }
+            dirty_ = false;
+        }
+
+    public:
+        SystemScheduler() : dirty_(false), parallel_(true), jobs_(nullptr) {}
+
+        template<typename T, typename... Args>
+        T& AddSystem(Args&&... args) {
+            systems_.push_back(std::make_unique<T>(std::forward<Args>(args)...));
+            dirty_ = true;
+            return static_cast<T&>(*systems_.back());
+        }
+
+        // Declare access on the returned system, e.g.
+        // AddSystem("move", fn).Reading<A>().Writing<B>()
+        template<typename Fn>
+        FunctionSystem<Fn>& AddSystem(const std::string& name, Fn fn) {
+            return AddSystem<FunctionSystem<Fn>>(name, std::move(fn));
+        }
+
+        // Null selects the engine-wide JobSystem::shared()
+        void SetJobSystem(Threading::JobSystem* jobs) { jobs_ = jobs; }
+        Threading::JobSystem& GetJobSystem() { return jobs_ ? *jobs_ : Threading::JobSystem::shared(); }
+
+        // When off, every system runs on the calling thread in stage order
+        void SetParallel(bool parallel) { parallel_ = parallel; }
+
+        void Run(Registry& registry, float deltaTime) {
+            if (dirty_) BuildStages(registry);
+
+            for (const std::vector<System*>& stage : stages_) {
+                if (stage.size() == 1 || !parallel_) {
+                    for (System* system : stage) system->Run(registry, deltaTime);
+                    continue;
+                }
+                // The caller takes the first system and helps with the rest
+                Threading::JobSystem& jobs = GetJobSystem();
+                Threading::JobCounter counter;
+                for (size_t i = 1; i < stage.size(); i++) {
+                    System* system = stage[i];
+                    jobs.run([system, &registry, deltaTime] { system->Run(registry, deltaTime); }, &counter);
+                }
+                stage[0]->Run(registry, deltaTime);
+                jobs.wait(counter);
+            }
+        }
+
+        // Stages as of the last Run()
+        const std::vector<std::vector<System*>>& GetStages() const { return stages_; }
+        size_t GetSystemCount() const { return systems_.size(); }
+    };
+
+    // Transform for entities updated in bulk (particles, crowds), stored
+    // by TransformSoA rather than one object per entity
+    struct BatchTransform {
+        float x = 0, y = 0, z = 0;
+        float rotationX = 0, rotationY = 0, rotationZ = 0;
+        float scaleX = 1, scaleY = 1, scaleZ = 1;
+        float velocityX = 0, velocityY = 0, velocityZ = 0;
+    };
+
+    namespace BatchKernels {
+
+        // p[i] += v[i] * dt over [0, count)
+        inline void integrateScalar(float* p, const float* v, uint32_t count, float dt) {
+            for (uint32_t i = 0; i < count; i++) p[i] += v[i] * dt;
+        }
+
+#if defined(GE_SIMD_X86)
+        inline void integrateSSE(float* p, const float* v, uint32_t count, float dt) {
+            const __m128 step = _mm_set1_ps(dt);
+            uint32_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                __m128 moved = _mm_add_ps(_mm_loadu_ps(p + i), _mm_mul_ps(_mm_loadu_ps(v + i), step));
+                _mm_storeu_ps(p + i, moved);
+            }
+            integrateScalar(p + i, v + i, count - i, dt);
+        }
+
+        // Two 8-wide FMAs per iteration, 16 entities
+        GE_TARGET_AVX2 inline void integrateAVX2(float* p, const float* v, uint32_t count, float dt) {
+            const __m256 step = _mm256_set1_ps(dt);
+            uint32_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                __m256 a = _mm256_fmadd_ps(_mm256_loadu_ps(v + i), step, _mm256_loadu_ps(p + i));
+                __m256 b = _mm256_fmadd_ps(_mm256_loadu_ps(v + i + 8), step, _mm256_loadu_ps(p + i + 8));
+                _mm256_storeu_ps(p + i, a);
+                _mm256_storeu_ps(p + i + 8, b);
+            }
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(p + i, _mm256_fmadd_ps(_mm256_loadu_ps(v + i), step, _mm256_loadu_ps(p + i)));
+            }
+            integrateScalar(p + i, v + i, count - i, dt);
+        }
+#elif defined(GE_SIMD_NEON)
+        inline void integrateNEON(float* p, const float* v, uint32_t count, float dt) {
+            uint32_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                vst1q_f32(p + i, vmlaq_n_f32(vld1q_f32(p + i), vld1q_f32(v + i), dt));
+            }
+            integrateScalar(p + i, v + i, count - i, dt);
+        }
+#endif
+
+        using IntegrateKernel = void (*)(float* p, const float* v, uint32_t count, float dt);
+
+        // Widest kernel the running CPU supports, picked once
+        inline IntegrateKernel integrateKernel() {
+            static const IntegrateKernel kernel = [] {
+#if defined(GE_SIMD_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+                return &integrateSSE;
+#else
+                __builtin_cpu_init();
+                bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+                return avx2 ? &integrateAVX2 : &integrateSSE;
+#endif
+#elif defined(GE_SIMD_NEON)
+                return &integrateNEON;
+#else
+                return &integrateScalar;
+#endif
+            }();
+            return kernel;
+        }
+
+    } // namespace BatchKernels
+
+    // BatchTransform pool laid out as one float array per field, parallel
+    // to GetEntities(), so batch updates stream through memory many
+    // entities per instruction instead of visiting objects one by one.
+    // Batch transforms are not tracked by the scene's spatial index.
+    class TransformSoA : public ComponentPoolBase {
+    private:
+        std::vector<float> x_, y_, z_;
+        std::vector<float> rotationX_, rotationY_, rotationZ_;
+        std::vector<float> scaleX_, scaleY_, scaleZ_;
+        std::vector<float> velocityX_, velocityY_, velocityZ_;
+
+        template<typename Fn>
+        void ForEachArray(Fn&& fn) {
+            for (std::vector<float>* array : {&x_, &y_, &z_, &rotationX_, &rotationY_, &rotationZ_,
+                                              &scaleX_, &scaleY_, &scaleZ_,
+                                              &velocityX_, &velocityY_, &velocityZ_}) {
+                fn(*array);
+            }
+        }
+
+        void Store(uint32_t i, const BatchTransform& t) {
+            x_[i] = t.x; y_[i] = t.y; z_[i] = t.z;
+            rotationX_[i] = t.rotationX; rotationY_[i] = t.rotationY; rotationZ_[i] = t.rotationZ;
+            scaleX_[i] = t.scaleX; scaleY_[i] = t.scaleY; scaleZ_[i] = t.scaleZ;
+            velocityX_[i] = t.velocityX; velocityY_[i] = t.velocityY; velocityZ_[i] = t.velocityZ;
+        }
+
+    public:
+        // Replaces any batch transform the entity already has; returns its index
+        uint32_t Emplace(EntityHandle entity, const BatchTransform& transform = BatchTransform()) {
+            if (!Contains(entity)) {
+                Insert(entity);
+                ForEachArray([](std::vector<float>& array) { array.push_back(0.0f); });
+            }
+            uint32_t i = SlotOf(entity);
+            Store(i, transform);
+            return i;
+        }
+
+        uint32_t Emplace(EntityHandle entity, float x, float y, float z) {
+            BatchTransform transform;
+            transform.x = x; transform.y = y; transform.z = z;
+            return Emplace(entity, transform);
+        }
+
+        bool Remove(EntityHandle entity) override {
+            if (!Contains(entity)) return false;
+            uint32_t slot = Erase(entity);
+            ForEachArray([slot](std::vector<float>& array) {
+                array[slot] = array.back();
+                array.pop_back();
+            });
+            return true;
+        }
+
+        void Clear() override {
+            sparse_.clear();
+            dense_.clear();
+            ForEachArray([](std::vector<float>& array) { array.clear(); });
+        }
+
+        void Reserve(size_t count) {
+            dense_.reserve(count);
+            ForEachArray([count](std::vector<float>& array) { array.reserve(count); });
+        }
+
+        // Index into the arrays; valid until the pool next changes
+        uint32_t IndexOf(EntityHandle entity) const { return SlotOf(entity); }
+
+        BatchTransform Get(uint32_t i) const {
+            BatchTransform t;
+            t.x = x_[i]; t.y = y_[i]; t.z = z_[i];
+            t.rotationX = rotationX_[i]; t.rotationY = rotationY_[i]; t.rotationZ = rotationZ_[i];
+            t.scaleX = scaleX_[i]; t.scaleY = scaleY_[i]; t.scaleZ = scaleZ_[i];
+            t.velocityX = velocityX_[i]; t.velocityY = velocityY_[i]; t.velocityZ = velocityZ_[i];
+            return t;
+        }
+
+        void Set(uint32_t i, const BatchTransform& transform) { Store(i, transform); }
+
+        void SetPosition(uint32_t i, float x, float y, float z) { x_[i] = x; y_[i] = y; z_[i] = z; }
+        void SetVelocity(uint32_t i, float x, float y, float z) { velocityX_[i] = x; velocityY_[i] = y; velocityZ_[i] = z; }
+
+        // Field arrays, Size() long
+        float* X() { return x_.data(); }
+        float* Y() { return y_.data(); }
+        float* Z() { return z_.data(); }
+        float* VelocityX() { return velocityX_.data(); }
+        float* VelocityY() { return velocityY_.data(); }
+        float* VelocityZ() { return velocityZ_.data(); }
+        float* RotationX() { return rotationX_.data(); }
+        float* RotationY() { return rotationY_.data(); }
+        float* RotationZ() { return rotationZ_.data(); }
+        float* ScaleX() { return scaleX_.data(); }
+        float* ScaleY() { return scaleY_.data(); }
+        float* ScaleZ() { return scaleZ_.data(); }
+        const float* X() const { return x_.data(); }
+        const float* Y() const { return y_.data(); }
+        const float* Z() const { return z_.data(); }
+
+        // position += velocity * dt for entities [begin, end)
+        void TranslateAll(const float* velocityX, const float* velocityY, const float* velocityZ,
+                          float dt, uint32_t begin, uint32_t end) {
+            BatchKernels::IntegrateKernel integrate = BatchKernels::integrateKernel();
+            uint32_t count = end - begin;
+            integrate(x_.data() + begin, velocityX + begin, count, dt);
+            integrate(y_.data() + begin, velocityY + begin, count, dt);
+            integrate(z_.data() + begin, velocityZ + begin, count, dt);
+        }
+
+        // Moves every entity by the given per-entity velocities, which are
+        // arrays parallel to GetEntities()
+        void TranslateAll(const float* velocityX, const float* velocityY, const float* velocityZ, float dt) {
+            TranslateAll(velocityX, velocityY, velocityZ, dt, 0, (uint32_t)Size());
+        }
+
+        // Moves entities [begin, end) by their own velocities
+        void Integrate(float dt, uint32_t begin, uint32_t end) {
+            TranslateAll(velocityX_.data(), velocityY_.data(), velocityZ_.data(), dt, begin, end);
+        }
+
+        void Integrate(float dt) { Integrate(dt, 0, (uint32_t)Size()); }
+    };
+
+    template<>
+    struct PoolFor<BatchTransform> {
+        using Type = TransformSoA;
+    };
+
+    // Integrates every batch transform's velocity, split across the job
+    // system in chunks big enough to amortise the job overhead
+    class VelocityIntegrationSystem : public System {
+    private:
+        Threading::JobSystem* jobs_;        // Null uses JobSystem::shared()
+        uint32_t grain_;
+
+    public:
+        explicit VelocityIntegrationSystem(Threading::JobSystem* jobs = nullptr, uint32_t grain = 16384)
+            : System("integrate velocities"), jobs_(jobs), grain_(grain) {
+            Writes<BatchTransform>();
+        }
+
+        void Update(Registry& registry, float deltaTime) override {
+            TransformSoA* transforms = registry.FindPool<BatchTransform>();
+            if (!transforms) return;
+            Threading::JobSystem& jobs = jobs_ ? *jobs_ : Threading::JobSystem::shared();
+            jobs.parallelFor((uint32_t)transforms->Size(), grain_, [&](uint32_t begin, uint32_t end) {
+                transforms->Integrate(deltaTime, begin, end);
+            });
+            CountProcessed(transforms->Size());
+        }
+    };
+
+    // Scene manager for managing entities. Destroying an entity is
+    // deferred to the end of the update, so systems never see one vanish
+    // mid-frame. Names are kept for debugging only, in builds with
+    // ENGINE_ENTITY_NAMES (the default unless NDEBUG is defined).
     class Scene {
     private:
-        std::vector<std::unique_ptr<Entity>> entities_;
+        Registry registry_;
+        std::mutex destroyMutex_;
+        std::vector<EntityHandle> pendingDestroy_;
+        std::vector<EntityHandle> destroying_;      // Swapped with the queue, keeps its capacity
+#if ENGINE_ENTITY_NAMES
+        std::unordered_map<std::string, EntityHandle> handlesByName_;
+        std::unordered_map<EntityHandle, std::string> namesByHandle_;
+#endif
+        SystemScheduler systems_;
+        SpatialGrid spatial_;
+        AssetManager* assets_;
+
+        void TrackTransforms() {
+            ComponentPool<TransformComponent>& transforms = registry_.GetPool<TransformComponent>();
+            transforms.SetOnAdd([this](EntityHandle entity, TransformComponent& transform) {
+                transform.AttachSpatialIndex(&spatial_, entity);
+                spatial_.Insert(entity, transform.GetX(), transform.GetY(), transform.GetZ());
+            });
+            transforms.SetOnRemove([this](EntityHandle entity, TransformComponent& transform) {
+                transform.AttachSpatialIndex(nullptr, kNullEntity);
+                spatial_.Remove(entity);
+            });
+        }
+
+        void FlushSpatialIndex() {
+            ComponentPool<TransformComponent>& transforms = registry_.GetPool<TransformComponent>();
+            spatial_.Flush([&](EntityHandle entity, float& x, float& y, float& z) {
+                TransformComponent* transform = transforms.Get(entity);
+                if (!transform) return false;
+                transform->ClearMoveQueued();
+                x = transform->GetX();
+                y = transform->GetY();
+                z = transform->GetZ();
+                return true;
+            });
+        }
 
     public:
-        Entity* CreateEntity(const std::string& id) {
-            entities_.push_back(std::make_unique<Entity>(id));
-            return entities_.back().get();
+        // Every entity with a TransformComponent is kept in a spatial index
+        // whose cells are cellSize wide; pick roughly the common query radius
+        explicit Scene(float cellSize = 4.0f) : spatial_(cellSize), assets_(nullptr) {
+            TrackTransforms();
         }
 
+        // Entities point back at the registry, so scenes stay in place
+        Scene(const Scene&) = delete;
+        Scene& operator=(const Scene&) = delete;
+
+        Entity CreateEntity() { return Entity(registry_, registry_.CreateEntity()); }
+
+        // The name is only recorded in builds with ENGINE_ENTITY_NAMES
+        Entity CreateEntity(const std::string& name) {
+            EntityHandle entity = registry_.CreateEntity();
+#if ENGINE_ENTITY_NAMES
+            handlesByName_[name] = entity;
+            namesByHandle_[entity] = name;
+#else
+            (void)name;
+#endif
+            return Entity(registry_, entity);
+        }
+
+        Entity GetEntity(EntityHandle entity) { return Entity(registry_, entity); }
+        bool IsAlive(EntityHandle entity) const { return registry_.IsAlive(entity); }
+
+        // Queues the entity for destruction at the end of the update; safe
+        // to call from systems running in parallel
+        void DestroyEntity(EntityHandle entity) {
+            std::lock_guard<std::mutex> lock(destroyMutex_);
+            pendingDestroy_.push_back(entity);
+        }
+
+        void DestroyEntity(const Entity& entity) { DestroyEntity(entity.GetHandle()); }
+
+        // Applies queued destroys now; Update() calls this after its systems
+        void FlushDestroyed() {
+            {
+                std::lock_guard<std::mutex> lock(destroyMutex_);
+                if (pendingDestroy_.empty()) return;
+                destroying_.swap(pendingDestroy_);
+            }
+            PROFILE_SCOPE("Scene::FlushDestroyed");
+            for (EntityHandle entity : destroying_) {
+                // Queued twice, the second attempt finds a stale handle
+                if (!registry_.DestroyEntity(entity)) continue;
+#if ENGINE_ENTITY_NAMES
+                auto it = namesByHandle_.find(entity);
+                if (it != namesByHandle_.end()) {
+                    auto named = handlesByName_.find(it->second);
+                    if (named != handlesByName_.end() && named->second == entity) handlesByName_.erase(named);
+                    namesByHandle_.erase(it);
+                }
+#endif
+            }
+            destroying_.clear();
+        }
+
+        // Debugging lookups; kNullEntity and "" when names are compiled out
+        EntityHandle FindEntity(const std::string& name) const {
+#if ENGINE_ENTITY_NAMES
+            auto it = handlesByName_.find(name);
+            return it != handlesByName_.end() ? it->second : kNullEntity;
+#else
+            (void)name;
+            return kNullEntity;
+#endif
+        }
+
+        const std::string& GetEntityName(EntityHandle entity) const {
+            static const std::string unnamed;
+#if ENGINE_ENTITY_NAMES
+            auto it = namesByHandle_.find(entity);
+            return it != namesByHandle_.end() ? it->second : unnamed;
+#else
+            (void)entity;
+            return unnamed;
+#endif
+        }
+
+        // Destroys every entity at once; pools keep their capacity for the next level
+        void Clear() {
+            {
+                std::lock_guard<std::mutex> lock(destroyMutex_);
+                pendingDestroy_.clear();
+            }
+#if ENGINE_ENTITY_NAMES
+            handlesByName_.clear();
+            namesByHandle_.clear();
+#endif
+            registry_.Clear();
+            spatial_.Clear();
+        }
+
+        Registry& GetRegistry() { return registry_; }
+        const Registry& GetRegistry() const { return registry_; }
+
+        // Runs every system once, in parallel where their access allows
         void Update(float deltaTime) {
-            for (auto& entity : entities_) {
-                // Update all components of each entity
-                // In a real implementation, this would iterate through components
+            PROFILE_SCOPE("Scene::Update");
+            systems_.Run(registry_, deltaTime);
+            FlushDestroyed();
+            FlushSpatialIndex();
+        }
+
+        SystemScheduler& GetSystems() { return systems_; }
+
+        // Copies every visible renderable that has a transform into
+        // snapshot, reusing its storage
+        void CaptureSnapshot(RenderSnapshot& snapshot) {
+            PROFILE_SCOPE("Scene::CaptureSnapshot");
+            snapshot.instances.clear();
+            ComponentPool<RenderComponent>* renders = registry_.FindPool<RenderComponent>();
+            ComponentPool<TransformComponent>* transforms = registry_.FindPool<TransformComponent>();
+            if (!renders || !transforms) return;
+            const std::vector<EntityHandle>& entities = renders->GetEntities();
+            const RenderComponent* components = renders->Data();
+            for (size_t i = 0; i < entities.size(); i++) {
+                const RenderComponent& render = components[i];
+                const TransformComponent* t = render.IsVisible() ? transforms->Get(entities[i]) : nullptr;
+                if (!t) continue;
+                snapshot.instances.push_back(RenderSnapshot::Instance{
+                    entities[i], render.GetMeshId(), render.GetMaterialId(), render.IsMeshReady(),
+                    render.GetBoundingRadius(), t->GetX(), t->GetY(), t->GetZ(),
+                    t->GetRotationX(), t->GetRotationY(), t->GetRotationZ(),
+                    t->GetScaleX(), t->GetScaleY(), t->GetScaleZ()});
+            }
+        }
+
+        // Streams every renderable's mesh through assets, now and as
+        // renderables are added; null stops requesting. The manager must
+        // outlive the scene's components.
+        void SetAssetManager(AssetManager* assets) {
+            assets_ = assets;
+            ComponentPool<RenderComponent>& renders = registry_.GetPool<RenderComponent>();
+            if (!assets_) {
+                renders.SetOnAdd(nullptr);
+                return;
+            }
+            renders.SetOnAdd([this](EntityHandle, RenderComponent& render) {
+                render.SetMeshAsset(assets_->Request(render.GetMeshId()));
+            });
+            RenderComponent* components = renders.Data();
+            for (size_t i = 0; i < renders.Size(); i++) {
+                components[i].SetMeshAsset(assets_->Request(components[i].GetMeshId()));
             }
         }
 
-        size_t GetEntityCount() const { return entities_.size(); }
+        AssetManager* GetAssetManager() { return assets_; }
+
+        // Frustum-culled, sorted draw list of the scene's renderables,
+        // built on the systems' job system
+        void BuildDrawList(const Frustum& frustum, DrawList& drawList) {
+            drawList.Build(registry_, frustum, systems_.GetJobSystem());
+        }
+
+        // Index over transform positions, first catching up with moves made
+        // since the last Update(). Not for use from inside parallel systems;
+        // they should query through a reference taken before Update().
+        SpatialGrid& GetSpatialIndex() {
+            FlushSpatialIndex();
+            return spatial_;
+        }
+
+        size_t GetEntityCount() const { return registry_.GetEntityCount(); }
     };
 
-    // Main game engine class
+    // Main game engine class. Update() advances the simulation in fixed
+    // steps by the real time elapsed on a monotonic clock, carrying the
+    // remainder over to the next frame; renderers blend the last two
+    // simulation states by GetInterpolationAlpha().
     class GameEngine {
+    public:
+        using Clock = std::chrono::steady_clock;
+
     private:
+        AssetManager assets_;               // Declared first so it outlives the scene's handles
         std::unique_ptr<Scene> scene_;
         bool isRunning_;
-        float lastFrameTime_;
+        Clock::time_point startTime_;
+        double lastFrameTime_;
+        double accumulator_;
+        float fixedTimestep_;
+        float maxFrameTime_;
+        float frameTime_;
+        float alpha_;
+        uint64_t frameCount_;
+        Clock::duration framePeriod_;       // Zero when pacing is off
+        Clock::time_point nextFrame_;
+        TripleBuffer<RenderSnapshot> snapshots_;
+        bool snapshotsEnabled_;
 
     public:
-        GameEngine() : isRunning_(false), lastFrameTime_(0.0f) {
+        GameEngine()
+            : isRunning_(false), startTime_(Clock::now()), lastFrameTime_(0.0), accumulator_(0.0),
+              fixedTimestep_(1.0f / 60.0f), maxFrameTime_(0.25f), frameTime_(0.0f), alpha_(0.0f),
+              frameCount_(0), framePeriod_(Clock::duration::zero()), snapshotsEnabled_(false) {
             scene_ = std::make_unique<Scene>();
+            scene_->SetAssetManager(&assets_);
         }
 
         void Initialize() {
             isRunning_ = true;
+            startTime_ = Clock::now();
+            nextFrame_ = startTime_;
             lastFrameTime_ = GetCurrentTime();
+            accumulator_ = 0.0;
+            frameCount_ = 0;
         }
 
-        void Update() {
-            if (!isRunning_) return;
+        // Runs as many fixed steps as the time since the last frame covers
+        // and returns how many ran. Frames longer than the max frame time
+        // are clamped so a stall doesn't snowball into ever longer catch-up.
+        int Update() {
+            if (!isRunning_) return 0;
+            PROFILE_SCOPE("GameEngine::Update");
 
-            float currentTime = GetCurrentTime();
-            float deltaTime = currentTime - lastFrameTime_;
+            double currentTime = GetCurrentTime();
+            frameTime_ = (float)(currentTime - lastFrameTime_);
             lastFrameTime_ = currentTime;
+            frameCount_++;
+
+            // Loads that finished since last frame become visible together
+            assets_.Update();
 
-            scene_->Update(deltaTime);
+            accumulator_ += std::min(frameTime_, maxFrameTime_);
+            int steps = 0;
+            while (accumulator_ >= fixedTimestep_) {
+                scene_->Update(fixedTimestep_);
+                accumulator_ -= fixedTimestep_;
+                steps++;
+            }
+            alpha_ = (float)(accumulator_ / fixedTimestep_);
+
+            // Destroys requested outside the fixed steps land by frame end too
+            scene_->FlushDestroyed();
+
+            if (snapshotsEnabled_) {
+                RenderSnapshot& snapshot = snapshots_.GetWriteBuffer();
+                scene_->CaptureSnapshot(snapshot);
+                snapshot.frame = frameCount_;
+                snapshot.time = currentTime;
+                snapshot.interpolationAlpha = alpha_;
+                snapshots_.Publish();
+            }
+            return steps;
+        }
+
+        // Sleeps until the next frame is due under the target frame rate.
+        // A frame that overran starts the schedule afresh rather than
+        // bunching up the frames after it.
+        void WaitForNextFrame() {
+            if (framePeriod_ == Clock::duration::zero()) return;
+            nextFrame_ += framePeriod_;
+            Clock::time_point now = Clock::now();
+            if (nextFrame_ < now) {
+                nextFrame_ = now;
+                return;
+            }
+            PROFILE_SCOPE("GameEngine::WaitForNextFrame");
+            std::this_thread::sleep_until(nextFrame_);
+        }
+
+        // 0 disables pacing
+        void SetTargetFrameRate(float framesPerSecond) {
+            framePeriod_ = framesPerSecond > 0.0f
+                ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond))
+                : Clock::duration::zero();
+            nextFrame_ = Clock::now();
+        }
+
+        void SetFixedTimestep(float seconds) { fixedTimestep_ = seconds; }
+        void SetMaxFrameTime(float seconds) { maxFrameTime_ = seconds; }
+
+        float GetFixedTimestep() const { return fixedTimestep_; }
+        float GetInterpolationAlpha() const { return alpha_; }
+        float GetFrameTime() const { return frameTime_; }
+        uint64_t GetFrameCount() const { return frameCount_; }
+
+        // Seconds since Initialize()
+        double GetCurrentTime() const {
+            return std::chrono::duration<double>(Clock::now() - startTime_).count();
         }
 
         Scene* GetScene() { return scene_.get(); }
+        AssetManager& GetAssets() { return assets_; }
+
+        // When on, every Update() ends by publishing a RenderSnapshot of the
+        // scene, so one render thread can draw frame N from
+        // AcquireSnapshot() while frame N + 1 simulates, without locking
+        // the scene
+        void SetSnapshotsEnabled(bool enabled) { snapshotsEnabled_ = enabled; }
+
+        // For the render thread only. Returns the newest published snapshot,
+        // or the one it already holds if nothing newer is out (frame 0 if
+        // none has been published). Valid until the next call.
+        const RenderSnapshot& AcquireSnapshot(bool* isNew = nullptr) { return snapshots_.Acquire(isNew); }
 
         void Shutdown() {
             isRunning_ = false;
         }
 
         bool IsRunning() const { return isRunning_; }
-
-    private:
-        float GetCurrentTime() {
-            // In real implementation, this would use platform-specific timing
-            static float time = 0.0f;
-            time += 0.016f; // Simulate 60 FPS
-            return time;
-        }
     };
 
 } // namespace GameEngine
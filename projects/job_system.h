@@ -0,0 +1,328 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Threading {
+
+    // Chase–Lev work-stealing deque. Only the owning worker pushes and pops,
+    // at the bottom; any thread may steal from the top. The ring grows when
+    // full and retired rings stay alive until the deque is destroyed, since a
+    // thief may still be reading one.
+    template<typename T>
+    class WorkStealingDeque {
+    private:
+        struct Ring {
+            int64_t capacity;
+            std::unique_ptr<std::atomic<T>[]> items;
+
+            explicit Ring(int64_t size) : capacity(size), items(new std::atomic<T>[size]) {}
+
+            T get(int64_t i) const { return items[i & (capacity - 1)].load(std::memory_order_relaxed); }
+            void put(int64_t i, T item) { items[i & (capacity - 1)].store(item, std::memory_order_relaxed); }
+        };
+
+        std::atomic<int64_t> top;
+        std::atomic<int64_t> bottom;
+        std::atomic<Ring*> ring;
+        std::vector<std::unique_ptr<Ring>> rings;      // Owner only
+
+        Ring* grow(Ring* old, int64_t b, int64_t t) {
+            rings.push_back(std::make_unique<Ring>(old->capacity * 2));
+            Ring* bigger = rings.back().get();
+            for (int64_t i = t; i < b; i++) {
+                bigger->put(i, old->get(i));
+            }
+            ring.store(bigger, std::memory_order_release);
+            return bigger;
+        }
+
+    public:
+        explicit WorkStealingDeque(int64_t capacity = 256) : top(0), bottom(0) {
+            rings.push_back(std::make_unique<Ring>(capacity));
+            ring.store(rings.back().get(), std::memory_order_relaxed);
+        }
+
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+        void push(T item) {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            Ring* r = ring.load(std::memory_order_relaxed);
+            if (b - t > r->capacity - 1) {
+                r = grow(r, b, t);
+            }
+            r->put(b, item);
+            bottom.store(b + 1, std::memory_order_release);
+        }
+
+        bool pop(T& item) {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            Ring* r = ring.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_seq_cst);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+            item = r->get(b);
+            if (t == b) {
+                // Last item: race the thieves for it
+                bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                       std::memory_order_relaxed);
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        bool steal(T& item) {
+            int64_t t = top.load(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_seq_cst);
+            if (t >= b) return false;
+            Ring* r = ring.load(std::memory_order_acquire);
+            item = r->get(t);
+            return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+        bool empty() const {
+            return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+        }
+    };
+
+    // Number of unfinished jobs in a group. Jobs submitted with a counter
+    // increment it and decrement it when they finish; wait() returns once it
+    // reaches zero.
+    class JobCounter {
+    private:
+        std::atomic<int> pending;
+        friend class JobSystem;
+
+    public:
+        JobCounter() : pending(0) {}
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+    };
+
+    // Engine-wide job scheduler. Background workers each own a work-stealing
+    // deque; jobs submitted from a worker go to its own deque, jobs from any
+    // other thread go to a shared injection queue. A thread that waits on a
+    // counter runs queued jobs until the counter drains instead of blocking,
+    // so a waiting thread is never an idle one. Workers sleep when there is
+    // nothing to run anywhere.
+    //
+    // Worker indices are 1..getWorkerCount() for background workers and 0
+    // for every other thread.
+    class JobSystem {
+    private:
+        struct Job {
+            std::function<void()> fn;
+            JobCounter* counter;
+        };
+
+        struct Worker {
+            WorkStealingDeque<Job*> deque;
+        };
+
+        struct ThreadContext {
+            const JobSystem* system;
+            int index;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;       // Slot i - 1 for worker i
+        std::vector<std::thread> threads;
+        std::mutex injectionMutex;
+        std::deque<Job*> injection;
+        std::mutex sleepMutex;
+        std::condition_variable wakeCondition;
+        std::atomic<int> queued;            // Jobs pushed and not yet taken
+        std::atomic<int> sleeping;
+        std::atomic<bool> stopping;
+
+        static ThreadContext& context() {
+            thread_local ThreadContext current{nullptr, 0};
+            return current;
+        }
+
+        void enqueue(Job* job) {
+            int index = getWorkerIndex();
+            queued.fetch_add(1, std::memory_order_seq_cst);
+            if (index > 0) {
+                workers[index - 1]->deque.push(job);
+            } else {
+                std::lock_guard<std::mutex> lock(injectionMutex);
+                injection.push_back(job);
+            }
+            if (sleeping.load(std::memory_order_seq_cst) > 0) {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                wakeCondition.notify_one();
+            }
+        }
+
+        bool findJob(int index, Job*& job) {
+            if (index > 0 && workers[index - 1]->deque.pop(job)) {
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            {
+                std::lock_guard<std::mutex> lock(injectionMutex);
+                if (!injection.empty()) {
+                    job = injection.front();
+                    injection.pop_front();
+                    queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            int count = (int)workers.size();
+            for (int i = 0; i < count; i++) {
+                int victim = (index + i) % count;
+                if (victim == index - 1) continue;
+                if (workers[victim]->deque.steal(job)) {
+                    queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void execute(Job* job) {
+            job->fn();
+            if (job->counter) {
+                job->counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            delete job;
+        }
+
+        void workerLoop(int index) {
+            context() = ThreadContext{this, index};
+            PROFILE_THREAD_NAME("Job worker " + std::to_string(index));
+            int idleSpins = 0;
+            while (!stopping.load(std::memory_order_acquire)) {
+                Job* job;
+                if (findJob(index, job)) {
+                    execute(job);
+                    idleSpins = 0;
+                    continue;
+                }
+                if (++idleSpins < 64) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                sleeping.fetch_add(1, std::memory_order_seq_cst);
+                wakeCondition.wait(lock, [&] {
+                    return stopping.load(std::memory_order_acquire) ||
+                           queued.load(std::memory_order_seq_cst) > 0;
+                });
+                sleeping.fetch_sub(1, std::memory_order_relaxed);
+                idleSpins = 0;
+            }
+        }
+
+    public:
+        // workerCount background threads; the threads that wait on jobs
+        // make up the rest of the parallelism
+        explicit JobSystem(int workerCount) : queued(0), sleeping(0), stopping(false) {
+            workerCount = std::max(0, workerCount);
+            for (int i = 0; i < workerCount; i++) {
+                workers.push_back(std::make_unique<Worker>());
+            }
+            for (int i = 0; i < workerCount; i++) {
+                threads.emplace_back(&JobSystem::workerLoop, this, i + 1);
+            }
+        }
+
+        // Runs whatever is still queued on the calling thread, then stops
+        ~JobSystem() {
+            Job* job;
+            while (findJob(0, job)) {
+                execute(job);
+            }
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping.store(true, std::memory_order_release);
+            }
+            wakeCondition.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        // One worker per hardware thread besides the caller, created on
+        // first use. Subsystems share it so they never oversubscribe the
+        // machine between them.
+        static JobSystem& shared() {
+            static JobSystem system((int)std::max(1u, std::thread::hardware_concurrency()) - 1);
+            return system;
+        }
+
+        int getWorkerCount() const { return (int)workers.size(); }
+
+        // Background workers plus the calling thread
+        int getThreadCount() const { return (int)workers.size() + 1; }
+
+        int getWorkerIndex() const {
+            const ThreadContext& current = context();
+            return current.system == this ? current.index : 0;
+        }
+
+        // Queues fn; counter, if given, covers it until it has finished
+        void run(std::function<void()> fn, JobCounter* counter = nullptr) {
+            if (counter) {
+                counter->pending.fetch_add(1, std::memory_order_relaxed);
+            }
+            enqueue(new Job{std::move(fn), counter});
+        }
+
+        // Runs queued jobs, these or any others, until counter drains
+        void wait(JobCounter& counter) {
+            int index = getWorkerIndex();
+            while (!counter.isDone()) {
+                Job* job;
+                if (findJob(index, job)) {
+                    execute(job);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // Calls fn(begin, end) over [0, count) in chunks of up to grain
+        // items and returns once all of them have run
+        void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& fn) {
+            if (count == 0) return;
+            grain = std::max(1u, grain);
+            if (count <= grain) {
+                fn(0, count);
+                return;
+            }
+            JobCounter counter;
+            for (uint32_t begin = grain; begin < count; begin += grain) {
+                uint32_t end = std::min(count, begin + grain);
+                run([&fn, begin, end] { fn(begin, end); }, &counter);
+            }
+            fn(0, grain);
+            wait(counter);
+        }
+    };
+
+} // namespace Threading
+
+#endif // JOB_SYSTEM_H
@@ -0,0 +1,109 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace IO {
+
+    // Read-only memory mapping of a whole file
+    class MappedFile {
+    private:
+        const uint8_t* base;
+        size_t length;
+#if defined(_WIN32)
+        HANDLE file;
+        HANDLE mapping;
+#endif
+
+        MappedFile() : base(nullptr), length(0) {
+#if defined(_WIN32)
+            file = INVALID_HANDLE_VALUE;
+            mapping = nullptr;
+#endif
+        }
+
+    public:
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+#if defined(_WIN32)
+            if (base) UnmapViewOfFile(base);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+            if (base) munmap(const_cast<uint8_t*>(base), length);
+#endif
+        }
+
+        // Returns nullptr (and sets error) if the file cannot be mapped
+        static std::shared_ptr<MappedFile> open(const std::string& path, std::string* error = nullptr) {
+            std::shared_ptr<MappedFile> mapped(new MappedFile());
+#if defined(_WIN32)
+            mapped->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            LARGE_INTEGER size;
+            if (mapped->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(mapped->file, &size) ||
+                size.QuadPart == 0) {
+                if (error) *error = "cannot open " + path;
+                return nullptr;
+            }
+            mapped->length = (size_t)size.QuadPart;
+            mapped->mapping = CreateFileMappingA(mapped->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapped->mapping) {
+                mapped->base = (const uint8_t*)MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+            }
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            struct stat info;
+            if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+                if (fd >= 0) ::close(fd);
+                if (error) *error = "cannot open " + path;
+                return nullptr;
+            }
+            mapped->length = (size_t)info.st_size;
+            void* address = mmap(nullptr, mapped->length, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            mapped->base = address == MAP_FAILED ? nullptr : (const uint8_t*)address;
+#endif
+            if (!mapped->base) {
+                if (error) *error = "cannot map " + path;
+                return nullptr;
+            }
+            return mapped;
+        }
+
+        const uint8_t* data() const { return base; }
+        size_t size() const { return length; }
+    };
+
+    // Reads one byte per page so later reads of the mapping don't fault;
+    // meant for loader threads, ahead of a consumer that must not stall
+    inline void touchPages(const MappedFile& file, size_t pageSize = 4096) {
+        const volatile uint8_t* bytes = file.data();
+        uint8_t sink = 0;
+        for (size_t offset = 0; offset < file.size(); offset += pageSize) sink ^= bytes[offset];
+        (void)sink;
+    }
+
+} // namespace IO
+
+#endif // MAPPED_FILE_H
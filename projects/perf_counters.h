@@ -0,0 +1,143 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Profiling {
+
+    // Hardware counters for the calling thread, read through Linux
+    // perf_event as one group so every counter covers the same interval.
+    // Counters the CPU or kernel won't provide are left out and marked
+    // invalid; elsewhere, or when perf_event is restricted (see
+    // /proc/sys/kernel/perf_event_paranoid), none are available and
+    // getError() says why. Threads other than the caller aren't counted.
+    class PerfCounters {
+    public:
+        enum Counter { Cycles, Instructions, CacheReferences, CacheMisses, BranchMisses, kCounterCount };
+
+        struct Sample {
+            uint64_t values[kCounterCount];
+            bool valid[kCounterCount];
+        };
+
+        static const char* counterName(int counter) {
+            static const char* const names[kCounterCount] = {
+                "cycles", "instructions", "cache_references", "cache_misses", "branch_misses"};
+            return names[counter];
+        }
+
+    private:
+        int fds[kCounterCount];
+        int slots[kCounterCount];           // Position in the group read, or -1
+        int leader;
+        int opened;
+        std::string error;
+
+#if defined(__linux__)
+        static int openEvent(uint64_t config, int group) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = config;
+            attr.disabled = group < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+        }
+#endif
+
+    public:
+        PerfCounters() : leader(-1), opened(0) {
+            for (int i = 0; i < kCounterCount; i++) {
+                fds[i] = -1;
+                slots[i] = -1;
+            }
+#if defined(__linux__)
+            const uint64_t configs[kCounterCount] = {
+                PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES,
+                PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+            for (int i = 0; i < kCounterCount; i++) {
+                int fd = openEvent(configs[i], leader);
+                if (fd < 0) {
+                    if (error.empty()) error = std::string(counterName(i)) + ": " + std::strerror(errno);
+                    continue;
+                }
+                if (leader < 0) leader = fd;
+                fds[i] = fd;
+                slots[i] = opened++;
+            }
+            if (opened > 0) error.clear();
+#else
+            error = "perf_event is only available on Linux";
+#endif
+        }
+
+        ~PerfCounters() {
+#if defined(__linux__)
+            for (int fd : fds) {
+                if (fd >= 0) close(fd);
+            }
+#endif
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        bool isAvailable() const { return opened > 0; }
+        bool isAvailable(int counter) const { return slots[counter] >= 0; }
+
+        // Why nothing could be counted; empty when something can
+        const std::string& getError() const { return error; }
+
+        void start() {
+#if defined(__linux__)
+            if (leader < 0) return;
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+        }
+
+        // Counts since start(), scaled up if the kernel had to multiplex
+        // the group with other users of the PMU
+        Sample stop() {
+            Sample sample;
+            for (int i = 0; i < kCounterCount; i++) {
+                sample.values[i] = 0;
+                sample.valid[i] = false;
+            }
+#if defined(__linux__)
+            if (leader < 0) return sample;
+            ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            uint64_t data[3 + kCounterCount];
+            ssize_t bytes = read(leader, data, sizeof(data));
+            if (bytes < (ssize_t)(3 * sizeof(uint64_t))) return sample;
+            uint64_t count = data[0];
+            uint64_t enabled = data[1];
+            uint64_t running = data[2];
+            if (running == 0) return sample;
+            double scale = (double)enabled / (double)running;
+            for (int i = 0; i < kCounterCount; i++) {
+                if (slots[i] < 0 || (uint64_t)slots[i] >= count) continue;
+                sample.values[i] = (uint64_t)(data[3 + slots[i]] * scale);
+                sample.valid[i] = true;
+            }
+#endif
+            return sample;
+        }
+    };
+
+} // namespace Profiling
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,241 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Build with ENGINE_PROFILING=1 to compile the PROFILE_* markers in; by
+// default they expand to nothing and cost nothing.
+#ifndef ENGINE_PROFILING
+#define ENGINE_PROFILING 0
+#endif
+
+namespace Profiling {
+
+    // One slot of a thread's ring: a completed scope or a counter sample.
+    // Names are stored by pointer, so they must outlive the trace (string
+    // literals, or strings owned by long-lived objects).
+    struct Event {
+        const char* name;
+        const char* category;
+        uint64_t startNs;
+        uint64_t value;             // Duration in ns for scopes
+        bool isCounter;
+    };
+
+    // Events recorded by one thread. Only the owner writes; exporting reads
+    // everything written so far, so export once markers have gone quiet
+    // (e.g. between frames) or the oldest events may be overwritten mid-read.
+    class ThreadLog {
+    private:
+        std::unique_ptr<Event[]> events;
+        size_t capacity;
+        std::atomic<uint64_t> written;
+        uint32_t threadId;
+        std::string threadName;
+
+        friend class Profiler;
+
+    public:
+        ThreadLog(uint32_t id, size_t size)
+            : events(new Event[size]), capacity(size), written(0), threadId(id) {}
+
+        void record(const Event& event) {
+            uint64_t index = written.load(std::memory_order_relaxed);
+            events[index % capacity] = event;
+            written.store(index + 1, std::memory_order_release);
+        }
+    };
+
+    // Heap allocations made by the calling thread, when counting is enabled
+    // (see ENGINE_PROFILE_ALLOCATIONS below); zero otherwise
+    struct AllocationCount {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+    };
+
+    inline AllocationCount& threadAllocations() {
+        thread_local AllocationCount allocations;
+        return allocations;
+    }
+
+    // Process-wide collection point for every thread's log
+    class Profiler {
+    public:
+        static constexpr size_t kEventsPerThread = 1 << 16;
+
+    private:
+        std::chrono::steady_clock::time_point epoch;
+        std::mutex mutex;                   // Guards logs, not the events in them
+        std::vector<std::unique_ptr<ThreadLog>> logs;
+
+        Profiler() : epoch(std::chrono::steady_clock::now()) {}
+
+        static void writeString(std::ostream& out, const char* text) {
+            out << '"';
+            for (const char* c = text ? text : ""; *c; c++) {
+                if (*c == '"' || *c == '\\') out << '\\';
+                if ((unsigned char)*c >= 0x20) out << *c;
+            }
+            out << '"';
+        }
+
+    public:
+        static Profiler& instance() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        // Nanoseconds since the profiler was first used
+        uint64_t now() const {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - epoch).count();
+        }
+
+        ThreadLog& threadLog() {
+            thread_local ThreadLog* log = nullptr;
+            if (!log) {
+                std::lock_guard<std::mutex> lock(mutex);
+                logs.push_back(std::make_unique<ThreadLog>((uint32_t)logs.size(), kEventsPerThread));
+                log = logs.back().get();
+            }
+            return *log;
+        }
+
+        void setThreadName(const std::string& name) {
+            ThreadLog& log = threadLog();
+            std::lock_guard<std::mutex> lock(mutex);
+            log.threadName = name;
+        }
+
+        void recordScope(const char* name, const char* category, uint64_t startNs, uint64_t endNs) {
+            threadLog().record(Event{name, category, startNs, endNs - startNs, false});
+        }
+
+        void recordCounter(const char* name, uint64_t value) {
+            threadLog().record(Event{name, "counter", now(), value, true});
+        }
+
+        // Drops every recorded event; threads keep their logs
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& log : logs) log->written.store(0, std::memory_order_relaxed);
+        }
+
+        // Chrome trace event JSON, readable by chrome://tracing and Perfetto
+        void writeChromeTrace(std::ostream& out) {
+            std::lock_guard<std::mutex> lock(mutex);
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+            bool first = true;
+            auto separator = [&] {
+                if (!first) out << ",\n";
+                first = false;
+            };
+            for (const auto& log : logs) {
+                if (!log->threadName.empty()) {
+                    separator();
+                    out << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << log->threadId
+                        << ", \"args\": {\"name\": ";
+                    writeString(out, log->threadName.c_str());
+                    out << "}}";
+                }
+                uint64_t written = log->written.load(std::memory_order_acquire);
+                uint64_t begin = written > log->capacity ? written - log->capacity : 0;
+                for (uint64_t i = begin; i < written; i++) {
+                    const Event& event = log->events[i % log->capacity];
+                    separator();
+                    out << "{\"name\": ";
+                    writeString(out, event.name);
+                    out << ", \"cat\": ";
+                    writeString(out, event.category);
+                    out << ", \"pid\": 1, \"tid\": " << log->threadId << ", \"ts\": " << event.startNs / 1000.0;
+                    if (event.isCounter) {
+                        out << ", \"ph\": \"C\", \"args\": {\"value\": " << event.value << "}}";
+                    } else {
+                        out << ", \"ph\": \"X\", \"dur\": " << event.value / 1000.0 << "}";
+                    }
+                }
+            }
+            out << "\n]}\n";
+        }
+
+        bool saveChromeTrace(const std::string& path) {
+            std::ofstream out(path, std::ios::trunc);
+            if (!out) return false;
+            writeChromeTrace(out);
+            return (bool)out;
+        }
+    };
+
+    // Records the enclosing scope as one complete event
+    class ScopedMarker {
+    private:
+        const char* name;
+        const char* category;
+        uint64_t start;
+
+    public:
+        ScopedMarker(const char* markerName, const char* markerCategory = "engine")
+            : name(markerName), category(markerCategory), start(Profiler::instance().now()) {}
+
+        ~ScopedMarker() {
+            Profiler& profiler = Profiler::instance();
+            profiler.recordScope(name, category, start, profiler.now());
+        }
+
+        ScopedMarker(const ScopedMarker&) = delete;
+        ScopedMarker& operator=(const ScopedMarker&) = delete;
+    };
+
+} // namespace Profiling
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if ENGINE_PROFILING
+#define PROFILE_SCOPE(name) ::Profiling::ScopedMarker PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_SCOPE_CATEGORY(name, category) \
+    ::Profiling::ScopedMarker PROFILE_CONCAT(profileScope, __LINE__)(name, category)
+#define PROFILE_COUNTER(name, value) ::Profiling::Profiler::instance().recordCounter(name, (uint64_t)(value))
+#define PROFILE_THREAD_NAME(name) ::Profiling::Profiler::instance().setThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_SCOPE_CATEGORY(name, category) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
+
+// Define ENGINE_PROFILE_ALLOCATIONS in exactly one translation unit before
+// including this header to count every heap allocation per thread in
+// Profiling::threadAllocations(). It replaces the global operator new.
+#if defined(ENGINE_PROFILE_ALLOCATIONS)
+// Kept out of line so GCC can't pair the malloc inside one with the free
+// inside the other and warn about mismatched new/delete
+#if defined(__GNUC__)
+#define PROFILE_NOINLINE __attribute__((noinline))
+#else
+#define PROFILE_NOINLINE
+#endif
+
+PROFILE_NOINLINE void* operator new(std::size_t size) {
+    Profiling::AllocationCount& allocations = Profiling::threadAllocations();
+    allocations.count++;
+    allocations.bytes += size;
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+PROFILE_NOINLINE void operator delete(void* memory) noexcept { std::free(memory); }
+PROFILE_NOINLINE void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+#endif
+
+#endif // PROFILER_H
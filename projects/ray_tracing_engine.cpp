@@ -17,21 +17,42 @@ int main() {
     // Create scene
     Scene scene(Vector3(0.1f, 0.1f, 0.15f));
 
-    // Add spheres to scene
+    // Register materials and add spheres to scene
+    uint32_t red = scene.addMaterial(redMaterial);
+    uint32_t blue = scene.addMaterial(blueMaterial);
+    uint32_t green = scene.addMaterial(greenMaterial);
+    uint32_t gold = scene.addMaterial(goldMaterial);
+
     scene.addShape(std::make_unique<Sphere>(
-        Vector3(-2.0f, 0.0f, -5.0f), 1.0f, redMaterial
+        Vector3(-2.0f, 0.0f, -5.0f), 1.0f, red
     ));
     scene.addShape(std::make_unique<Sphere>(
-        Vector3(0.0f, 0.0f, -5.0f), 1.0f, blueMaterial
+        Vector3(0.0f, 0.0f, -5.0f), 1.0f, blue
     ));
     scene.addShape(std::make_unique<Sphere>(
-        Vector3(2.0f, 0.0f, -5.0f), 1.0f, greenMaterial
+        Vector3(2.0f, 0.0f, -5.0f), 1.0f, green
     ));
     scene.addShape(std::make_unique<Sphere>(
-        Vector3(0.0f, -2.0f, -3.0f), 0.8f, goldMaterial
+        Vector3(0.0f, -2.0f, -3.0f), 0.8f, gold
     ));
 
-    std::cout << "Scene created with " << scene.getShapeCount() << " objects\n";
+    // Ground plane as a two-triangle indexed mesh
+    uint32_t floorMaterial = scene.addMaterial(Material(Vector3(0.6f, 0.6f, 0.6f), 0.9f, 0.0f));
+    TriangleMesh floor(floorMaterial);
+    uint32_t a = floor.addVertex(Vector3(-10.0f, -3.0f, 0.0f));
+    uint32_t b = floor.addVertex(Vector3(10.0f, -3.0f, 0.0f));
+    uint32_t c = floor.addVertex(Vector3(10.0f, -3.0f, -20.0f));
+    uint32_t d = floor.addVertex(Vector3(-10.0f, -3.0f, -20.0f));
+    floor.addTriangle(a, b, c);
+    floor.addTriangle(a, c, d);
+    scene.addMesh(floor);
+
+    scene.finalize();
+    std::cout << "Scene created with " << scene.getShapeCount() << " objects and "
+              << scene.getTriangleCount() << " triangles ("
+              << scene.getPrimitiveBVH().getNodeCount() + scene.getBVH().getNodeCount()
+              << " BVH nodes)\n";
+    std::cout << "Sphere kernel: " << simdLevelName(scene.getSimdLevel()) << "\n";
 
     // Create camera
     Camera camera(
@@ -47,7 +68,7 @@ int main() {
               << "x" << camera.getHeight() << "\n\n";
 
     // Create engine
-    RayTracingEngine engine(scene, camera);
+    RayTracingEngine engine(std::move(scene), camera);
 
     // Render a sample pixel
     std::cout << "Rendering sample pixels...\n";
@@ -63,12 +84,46 @@ int main() {
     std::cout << "Right pixel color: (" 
               << rightColor.x << ", " << rightColor.y << ", " << rightColor.z << ")\n\n";
 
+    // Path-traced frame: materials' roughness and metallic now shape the
+    // reflections, and light bounces between the objects
+    PathTraceOptions pathOptions(4, 4);
+    AccumulationBuffer accumulation;
+    PathTraceStats pathStats = engine.renderPathTraced(accumulation, pathOptions);
+    Vector3 tracedCenter = accumulation.getColor(400, 300);
+    std::cout << "Path traced " << pathStats.samples << " samples (" << pathStats.rays << " rays, "
+              << pathStats.shadowRays << " shadow rays) in " << pathStats.milliseconds << " ms\n";
+    std::cout << "Path-traced center pixel: ("
+              << tracedCenter.x << ", " << tracedCenter.y << ", " << tracedCenter.z << ")\n";
+
+    // Stream the traced image out in row bands without keeping the frame;
+    // every row must arrive exactly once, top to bottom, and already
+    // written (alpha is only 255 once a pixel has been resolved)
+    Framebuffer streamed(accumulation.getWidth(), accumulation.getHeight(), PixelFormat::RGBA8);
+    int nextRow = 0;
+    bool rowsInOrder = true;
+    streamed.setSink([&](const FramebufferRegion& region) {
+        rowsInOrder = rowsInOrder && region.x == 0 && region.width == streamed.getWidth() && region.y == nextRow;
+        for (int y = 0; y < region.height; y++) {
+            const uint8_t* row = region.data + y * region.rowStride;
+            for (int x = 0; x < region.width; x++) {
+                rowsInOrder = rowsInOrder && row[x * 4 + 3] == 255;
+            }
+        }
+        nextRow = region.y + region.height;
+    }, StreamMode::Rows, false);
+    accumulation.resolve(streamed);
+    rowsInOrder = rowsInOrder && nextRow == streamed.getHeight();
+    std::cout << "Row streaming: " << (rowsInOrder ? "every row once, in order" : "FAILED") << "\n\n";
+    if (!rowsInOrder) return 1;
+
     std::cout << "Ray tracing engine ready for full scene rendering!\n";
     std::cout << "Features:\n";
     std::cout << "  - Physically-based ray tracing\n";
     std::cout << "  - Multiple material support\n";
     std::cout << "  - Sphere intersection algorithms\n";
+    std::cout << "  - Indexed triangle meshes\n";
     std::cout << "  - Normal-based lighting\n";
+    std::cout << "  - Path tracing with next-event estimation\n";
     std::cout << "  - Configurable camera system\n";
 
     return 0;
@@ -1,10 +1,42 @@
 #ifndef RAY_TRACING_ENGINE_H
 #define RAY_TRACING_ENGINE_H
 
+#include "arena_allocator.h"
+#include "job_system.h"
+#include "profiler.h"
+#include "simd_math.h"
 #include <vector>
 #include <memory>
 #include <cmath>
+#include <cstdint>
+#include <limits>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RT_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define RT_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang need per-function target attributes to emit AVX2 code in a
+// translation unit compiled for the baseline ISA; MSVC accepts it anywhere.
+#if defined(RT_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define RT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define RT_TARGET_AVX2
+#endif
 
 namespace RayTracing {
 
@@ -14,6 +46,10 @@ namespace RayTracing {
         float x, y, z;
 
         Vector3(float x = 0, float y = 0, float z = 0) : x(x), y(y), z(z) {}
+        explicit Vector3(const Math::float4& v) : x(v.x()), y(v.y()), z(v.z()) {}
+
+        // w is 0, as for a direction
+        Math::float4 toFloat4() const { return Math::float4(x, y, z); }
 
         Vector3 operator+(const Vector3& v) const {
             return Vector3(x + v.x, y + v.y, z + v.z);
@@ -43,22 +79,231 @@ namespace RayTracing {
             return std::sqrt(x * x + y * y + z * z);
         }
 
+        // One reciprocal square root and three multiplies; vectors shorter
+        // than 1e-4 come back as zero
         Vector3 normalize() const {
-            float len = length();
-            if (len > 0.0001f) {
-                return Vector3(x / len, y / len, z / len);
+            float lengthSquared = x * x + y * y + z * z;
+            if (lengthSquared > 1e-8f) {
+                return *this * Math::rsqrt(lengthSquared);
             }
             return Vector3(0, 0, 0);
         }
+
+        float operator[](int axis) const {
+            return axis == 0 ? x : (axis == 1 ? y : z);
+        }
+
+        Vector3 min(const Vector3& v) const {
+            return Vector3(std::min(x, v.x), std::min(y, v.y), std::min(z, v.z));
+        }
+
+        Vector3 max(const Vector3& v) const {
+            return Vector3(std::max(x, v.x), std::max(y, v.y), std::max(z, v.z));
+        }
     };
 
+    // Passed to Ray's constructor to say the direction is already unit length
+    struct UnitDirection {};
+    constexpr UnitDirection unitDirection{};
+
     // Ray structure
     struct Ray {
         Vector3 origin;
         Vector3 direction;
 
+        Ray() = default;
         Ray(const Vector3& o, const Vector3& d) 
             : origin(o), direction(d.normalize()) {}
+
+        // Takes d as is; for callers that have just normalized it
+        Ray(const Vector3& o, const Vector3& d, UnitDirection)
+            : origin(o), direction(d) {}
+    };
+
+    // Axis-aligned bounding box
+    struct AABB {
+        Vector3 min;
+        Vector3 max;
+
+        AABB()
+            : min(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::max()),
+              max(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                  -std::numeric_limits<float>::max()) {}
+
+        AABB(const Vector3& mn, const Vector3& mx) : min(mn), max(mx) {}
+
+        void expand(const Vector3& p) {
+            min = min.min(p);
+            max = max.max(p);
+        }
+
+        void expand(const AABB& b) {
+            min = min.min(b.min);
+            max = max.max(b.max);
+        }
+
+        bool valid() const {
+            return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+        }
+
+        Vector3 centroid() const {
+            return (min + max) * 0.5f;
+        }
+
+        float surfaceArea() const {
+            if (!valid()) return 0.0f;
+            Vector3 e = max - min;
+            return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+
+        int longestAxis() const {
+            Vector3 e = max - min;
+            if (e.x >= e.y && e.x >= e.z) return 0;
+            return e.y >= e.z ? 1 : 2;
+        }
+
+        // Slab test; invDir is the per-axis reciprocal of the ray direction
+        bool intersect(const Vector3& origin, const Vector3& invDir,
+                       float tMax, float& tNear) const {
+            float tx1 = (min.x - origin.x) * invDir.x;
+            float tx2 = (max.x - origin.x) * invDir.x;
+            float t0 = std::min(tx1, tx2);
+            float t1 = std::max(tx1, tx2);
+
+            float ty1 = (min.y - origin.y) * invDir.y;
+            float ty2 = (max.y - origin.y) * invDir.y;
+            t0 = std::max(t0, std::min(ty1, ty2));
+            t1 = std::min(t1, std::max(ty1, ty2));
+
+            float tz1 = (min.z - origin.z) * invDir.z;
+            float tz2 = (max.z - origin.z) * invDir.z;
+            t0 = std::max(t0, std::min(tz1, tz2));
+            t1 = std::min(t1, std::max(tz1, tz2));
+
+            tNear = t0;
+            return t1 >= std::max(t0, 0.0f) && t0 < tMax;
+        }
+    };
+
+    // Affine transform stored as the top three rows of a 4x4 matrix
+    // (row-major, column 3 is the translation)
+    struct Transform {
+        float m[3][4];
+
+        Transform() {
+            for (int r = 0; r < 3; r++) {
+                for (int c = 0; c < 4; c++) {
+                    m[r][c] = r == c ? 1.0f : 0.0f;
+                }
+            }
+        }
+
+        static Transform translation(const Vector3& offset) {
+            Transform t;
+            t.m[0][3] = offset.x;
+            t.m[1][3] = offset.y;
+            t.m[2][3] = offset.z;
+            return t;
+        }
+
+        static Transform scaling(const Vector3& factors) {
+            Transform t;
+            t.m[0][0] = factors.x;
+            t.m[1][1] = factors.y;
+            t.m[2][2] = factors.z;
+            return t;
+        }
+
+        // Right-handed rotation about axis by the given angle in degrees
+        static Transform rotation(const Vector3& axis, float degrees) {
+            Vector3 a = axis.normalize();
+            float radians = degrees * (float)M_PI / 180.0f;
+            float c = std::cos(radians);
+            float s = std::sin(radians);
+            float k = 1.0f - c;
+            Transform t;
+            t.m[0][0] = c + a.x * a.x * k;
+            t.m[0][1] = a.x * a.y * k - a.z * s;
+            t.m[0][2] = a.x * a.z * k + a.y * s;
+            t.m[1][0] = a.y * a.x * k + a.z * s;
+            t.m[1][1] = c + a.y * a.y * k;
+            t.m[1][2] = a.y * a.z * k - a.x * s;
+            t.m[2][0] = a.z * a.x * k - a.y * s;
+            t.m[2][1] = a.z * a.y * k + a.x * s;
+            t.m[2][2] = c + a.z * a.z * k;
+            return t;
+        }
+
+        // Composition: (a * b) applies b first, then a
+        Transform operator*(const Transform& b) const {
+            Transform t;
+            for (int r = 0; r < 3; r++) {
+                for (int c = 0; c < 4; c++) {
+                    t.m[r][c] = m[r][0] * b.m[0][c] + m[r][1] * b.m[1][c] + m[r][2] * b.m[2][c] +
+                                (c == 3 ? m[r][3] : 0.0f);
+                }
+            }
+            return t;
+        }
+
+        // Inverse of an invertible transform
+        Transform inverse() const {
+            float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+            float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+            float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+            float invDet = 1.0f / (m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02);
+
+            Transform t;
+            t.m[0][0] = c00 * invDet;
+            t.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet;
+            t.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet;
+            t.m[1][0] = c01 * invDet;
+            t.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet;
+            t.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet;
+            t.m[2][0] = c02 * invDet;
+            t.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet;
+            t.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet;
+            for (int r = 0; r < 3; r++) {
+                t.m[r][3] = -(t.m[r][0] * m[0][3] + t.m[r][1] * m[1][3] + t.m[r][2] * m[2][3]);
+            }
+            return t;
+        }
+
+        Vector3 transformPoint(const Vector3& p) const {
+            return Vector3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                           m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                           m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+        }
+
+        Vector3 transformVector(const Vector3& v) const {
+            return Vector3(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                           m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                           m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+        }
+
+        // Multiplies by the transposed linear part. Called on the inverse of
+        // a transform, this maps normals through that transform.
+        Vector3 transformTransposed(const Vector3& v) const {
+            return Vector3(m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+                           m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+                           m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z);
+        }
+
+        // Tight box around the transformed box (Arvo's method)
+        AABB transformBounds(const AABB& box) const {
+            float lo[3], hi[3];
+            for (int r = 0; r < 3; r++) {
+                lo[r] = hi[r] = m[r][3];
+                for (int c = 0; c < 3; c++) {
+                    float a = m[r][c] * box.min[c];
+                    float b = m[r][c] * box.max[c];
+                    lo[r] += std::min(a, b);
+                    hi[r] += std::max(a, b);
+                }
+            }
+            return AABB(Vector3(lo[0], lo[1], lo[2]), Vector3(hi[0], hi[1], hi[2]));
+        }
     };
 
     // Material properties
@@ -73,27 +318,56 @@ namespace RayTracing {
             : albedo(alb), roughness(rough), metallic(met), emission(em) {}
     };
 
-    // Hit information
+    // Light source. Directional lights store the unit direction towards the
+    // light; point lights fall off with the squared distance.
+    struct Light {
+        enum class Type { Directional, Point };
+
+        Type type;
+        Vector3 position;
+        Vector3 direction;
+        Vector3 color;
+        float intensity;
+
+        static Light directional(const Vector3& towardLight, const Vector3& col = Vector3(1, 1, 1),
+                                 float strength = 1.0f) {
+            return Light{Type::Directional, Vector3(), towardLight.normalize(), col, strength};
+        }
+
+        static Light point(const Vector3& pos, const Vector3& col = Vector3(1, 1, 1),
+                           float strength = 1.0f) {
+            return Light{Type::Point, pos, Vector3(), col, strength};
+        }
+    };
+
+    // Hit information. Point and normal are only resolved for the closest
+    // hit; the material is an index into the scene's material table.
     struct HitInfo {
         float t;                    // Distance along ray
         Vector3 point;              // Hit point
         Vector3 normal;             // Surface normal
-        Material material;          // Material at hit point
+        uint32_t materialId;        // Scene material table index
+        uint32_t sphereId;          // Id of the top-level sphere hit, or kNoSphere
         bool hit;                   // Whether ray hit something
 
-        HitInfo() : t(0), hit(false) {}
+        static constexpr uint32_t kNoSphere = std::numeric_limits<uint32_t>::max();
+
+        HitInfo() : t(0), materialId(0), sphereId(kNoSphere), hit(false) {}
     };
 
     // Base shape class
     class Shape {
     public:
-        Material material;
+        uint32_t materialId;
 
-        Shape(const Material& mat) : material(mat) {}
+        explicit Shape(uint32_t matId = 0) : materialId(matId) {}
         virtual ~Shape() = default;
 
-        virtual bool intersect(const Ray& ray, HitInfo& hitInfo) const = 0;
+        // Nearest hit in (epsilon, tMax). Only t is reported; the scene works
+        // out point and normal once the closest hit is known.
+        virtual bool intersect(const Ray& ray, float tMax, float& t) const = 0;
         virtual Vector3 getNormal(const Vector3& point) const = 0;
+        virtual AABB getBounds() const = 0;
     };
 
     // Sphere shape
@@ -103,10 +377,13 @@ namespace RayTracing {
         float radius;
 
     public:
-        Sphere(const Vector3& c, float r, const Material& mat)
-            : Shape(mat), center(c), radius(r) {}
+        Sphere(const Vector3& c, float r, uint32_t matId = 0)
+            : Shape(matId), center(c), radius(r) {}
 
-        bool intersect(const Ray& ray, HitInfo& hitInfo) const override {
+        const Vector3& getCenter() const { return center; }
+        float getRadius() const { return radius; }
+
+        bool intersect(const Ray& ray, float tMax, float& hitT) const override {
             Vector3 oc = ray.origin - center;
             float a = ray.direction.dot(ray.direction);
             float b = 2.0f * oc.dot(ray.direction);
@@ -122,128 +399,4162 @@ namespace RayTracing {
             float t2 = (-b + sqrtD) / (2.0f * a);
 
             float t = (t1 > 0.001f) ? t1 : t2;
-            if (t < 0.001f) {
+            if (t < 0.001f || t >= tMax) {
                 return false;
             }
 
-            hitInfo.t = t;
-            hitInfo.point = ray.origin + ray.direction * t;
-            hitInfo.normal = getNormal(hitInfo.point);
-            hitInfo.material = material;
-            hitInfo.hit = true;
+            hitT = t;
             return true;
         }
 
         Vector3 getNormal(const Vector3& point) const override {
             return (point - center).normalize();
         }
+
+        AABB getBounds() const override {
+            Vector3 extent(radius, radius, radius);
+            return AABB(center - extent, center + extent);
+        }
     };
 
-    // Scene containing all objects
-    class Scene {
+    // Indexed triangle mesh: one shared vertex buffer and three 32-bit
+    // indices per triangle. Scene::addMesh copies it into the scene's
+    // triangle store, so the mesh can be dropped afterwards.
+    struct TriangleMesh {
+        std::vector<Vector3> vertices;
+        std::vector<uint32_t> indices;
+        uint32_t materialId;
+
+        explicit TriangleMesh(uint32_t matId = 0) : materialId(matId) {}
+
+        uint32_t addVertex(const Vector3& v) {
+            vertices.push_back(v);
+            return (uint32_t)(vertices.size() - 1);
+        }
+
+        void addTriangle(uint32_t a, uint32_t b, uint32_t c) {
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(c);
+        }
+
+        size_t getTriangleCount() const { return indices.size() / 3; }
+    };
+
+    // Contiguous array that either owns its elements or borrows a read-only
+    // range kept alive by someone else (e.g. a section of a memory-mapped
+    // scene file). Any mutation of a borrowed array first copies it into
+    // owned storage, so borrowed data is never written.
+    template<typename T>
+    class StorageArray {
     private:
-        std::vector<std::unique_ptr<Shape>> shapes;
-        Vector3 backgroundColor;
+        std::vector<T> owned;
+        const T* view;
+        size_t count;
+        bool borrowed;
+
+        void refresh() {
+            view = owned.data();
+            count = owned.size();
+        }
+
+        void own() {
+            if (!borrowed) return;
+            owned.assign(view, view + count);
+            borrowed = false;
+            refresh();
+        }
 
     public:
-        Scene(const Vector3& bgColor = Vector3(0.1f, 0.1f, 0.15f))
-            : backgroundColor(bgColor) {}
+        using value_type = T;
 
-        void addShape(std::unique_ptr<Shape> shape) {
-            shapes.push_back(std::move(shape));
+        StorageArray() : view(nullptr), count(0), borrowed(false) {}
+
+        StorageArray(const StorageArray& other)
+            : owned(other.begin(), other.end()), borrowed(false) {
+            refresh();
         }
 
-        HitInfo traceRay(const Ray& ray) const {
-            HitInfo closestHit;
-            float closestT = std::numeric_limits<float>::max();
+        StorageArray(StorageArray&& other) noexcept
+            : owned(std::move(other.owned)), view(other.view), count(other.count), borrowed(other.borrowed) {
+            other.borrowed = false;
+            other.owned.clear();
+            other.refresh();
+        }
 
-            for (const auto& shape : shapes) {
-                HitInfo hitInfo;
-                if (shape->intersect(ray, hitInfo) && hitInfo.t < closestT) {
-                    closestT = hitInfo.t;
-                    closestHit = hitInfo;
+        StorageArray& operator=(StorageArray other) noexcept {
+            owned.swap(other.owned);
+            std::swap(view, other.view);
+            std::swap(count, other.count);
+            std::swap(borrowed, other.borrowed);
+            return *this;
+        }
+
+        // Points the array at data[0, n) without copying; data must outlive
+        // the array or the next mutation, whichever comes first
+        void borrow(const T* data, size_t n) {
+            std::vector<T>().swap(owned);
+            view = data;
+            count = n;
+            borrowed = true;
+        }
+
+        bool isBorrowed() const { return borrowed; }
+
+        const T* data() const { return view; }
+        T* mutableData() { own(); return owned.data(); }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const T* begin() const { return view; }
+        const T* end() const { return view + count; }
+
+        const T& operator[](size_t i) const { return view[i]; }
+        T& operator[](size_t i) { own(); return owned[i]; }
+
+        void push_back(const T& value) { own(); owned.push_back(value); refresh(); }
+
+        template<typename... Args>
+        T& emplace_back(Args&&... args) {
+            own();
+            owned.emplace_back(std::forward<Args>(args)...);
+            refresh();
+            return owned.back();
+        }
+
+        template<typename It>
+        void append(It first, It last) { own(); owned.insert(owned.end(), first, last); refresh(); }
+
+        void resize(size_t n, const T& value = T()) { own(); owned.resize(n, value); refresh(); }
+        void reserve(size_t n) { own(); owned.reserve(n); refresh(); }
+        void assign(std::vector<T>&& values) { borrowed = false; owned = std::move(values); refresh(); }
+
+        void clear() { borrowed = false; owned.clear(); refresh(); }
+
+        // Empties the array and releases its memory
+        void reset() { borrowed = false; std::vector<T>().swap(owned); refresh(); }
+    };
+
+    // Bounding volume hierarchy node. Interior nodes store the index of the
+    // left child in leftFirst (the right child follows it); leaves store the
+    // first primitive index and a non-zero primitive count.
+    struct BVHNode {
+        AABB bounds;
+        uint32_t leftFirst;
+        uint32_t count;
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    // BVH build parameters. leafBatchSize is the number of primitives a leaf
+    // kernel tests at once; the SAH charges each started batch as one test.
+    struct BVHBuildOptions {
+        uint32_t maxLeafSize;
+        uint32_t leafBatchSize;
+
+        BVHBuildOptions(uint32_t maxLeaf = 4, uint32_t batch = 1)
+            : maxLeafSize(maxLeaf), leafBatchSize(batch) {}
+    };
+
+    // Bounding volume hierarchy built with binned SAH splits
+    class BVH {
+    private:
+        static constexpr int kBinCount = 16;
+        static constexpr int kMaxDepth = 60;
+        static constexpr float kTraversalCost = 1.0f;
+        static constexpr float kIntersectCost = 1.0f;
+
+        StorageArray<BVHNode> nodes;
+        std::vector<uint32_t> primIndices;
+        BVHBuildOptions options;
+
+        // Refit state, derived from the nodes on the first refit after a build
+        std::vector<uint32_t> parents;
+        std::vector<uint32_t> leafOf;       // Leaf holding each leaf-order position
+        std::vector<uint32_t> visitMark;
+        uint32_t visitEpoch = 0;
+        double sahCost = 0.0;               // Sum of area * cost over all nodes
+        double builtCost = 0.0;             // sahCost / root area as built
+
+        float batchCost(uint32_t count) const {
+            uint32_t batch = std::max(1u, options.leafBatchSize);
+            return (float)((count + batch - 1) / batch);
+        }
+
+        struct Bin {
+            AABB bounds;
+            uint32_t count = 0;
+        };
+
+        void subdivide(uint32_t nodeIndex, const std::vector<AABB>& primBounds,
+                       const std::vector<Vector3>& centroids, int depth) {
+            BVHNode& node = nodes[nodeIndex];
+            uint32_t first = node.leftFirst;
+            uint32_t count = node.count;
+            if (count <= 1 || depth >= kMaxDepth) return;
+
+            AABB centroidBounds;
+            for (uint32_t i = first; i < first + count; i++) {
+                centroidBounds.expand(centroids[primIndices[i]]);
+            }
+
+            // Find the cheapest split plane across all three axes
+            int bestAxis = -1;
+            int bestBin = 0;
+            float bestCost = std::numeric_limits<float>::max();
+            for (int axis = 0; axis < 3; axis++) {
+                float lo = centroidBounds.min[axis];
+                float hi = centroidBounds.max[axis];
+                if (hi - lo <= 1e-6f) continue;
+
+                Bin bins[kBinCount];
+                float scale = kBinCount / (hi - lo);
+                for (uint32_t i = first; i < first + count; i++) {
+                    uint32_t prim = primIndices[i];
+                    int b = std::min(kBinCount - 1, (int)((centroids[prim][axis] - lo) * scale));
+                    bins[b].count++;
+                    bins[b].bounds.expand(primBounds[prim]);
+                }
+
+                // Sweep from both ends so each plane is evaluated in O(1)
+                float leftArea[kBinCount - 1];
+                uint32_t leftCount[kBinCount - 1];
+                AABB leftBox;
+                uint32_t leftSum = 0;
+                for (int b = 0; b < kBinCount - 1; b++) {
+                    leftSum += bins[b].count;
+                    leftBox.expand(bins[b].bounds);
+                    leftCount[b] = leftSum;
+                    leftArea[b] = leftBox.surfaceArea();
+                }
+
+                AABB rightBox;
+                uint32_t rightSum = 0;
+                for (int b = kBinCount - 1; b > 0; b--) {
+                    rightSum += bins[b].count;
+                    rightBox.expand(bins[b].bounds);
+                    if (leftCount[b - 1] == 0 || rightSum == 0) continue;
+                    float cost = batchCost(leftCount[b - 1]) * leftArea[b - 1] +
+                                 batchCost(rightSum) * rightBox.surfaceArea();
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = b;
+                    }
                 }
             }
 
-            return closestHit;
+            uint32_t mid;
+            float parentArea = node.bounds.surfaceArea();
+            float splitCost = kTraversalCost + kIntersectCost * bestCost / std::max(parentArea, 1e-12f);
+            float leafCost = kIntersectCost * batchCost(count);
+            if (bestAxis >= 0 && (splitCost < leafCost || count > options.maxLeafSize)) {
+                float lo = centroidBounds.min[bestAxis];
+                float scale = kBinCount / (centroidBounds.max[bestAxis] - lo);
+                auto split = std::partition(
+                    primIndices.begin() + first, primIndices.begin() + first + count,
+                    [&](uint32_t prim) {
+                        int b = std::min(kBinCount - 1, (int)((centroids[prim][bestAxis] - lo) * scale));
+                        return b < bestBin;
+                    });
+                mid = (uint32_t)(split - primIndices.begin());
+            } else if (count > options.maxLeafSize) {
+                // Coincident centroids: fall back to an object median split
+                mid = first + count / 2;
+            } else {
+                return;
+            }
+
+            uint32_t leftIndex = (uint32_t)nodes.size();
+            nodes.push_back(makeNode(first, mid - first, primBounds));
+            nodes.push_back(makeNode(mid, first + count - mid, primBounds));
+
+            BVHNode& parent = nodes[nodeIndex];
+            parent.leftFirst = leftIndex;
+            parent.count = 0;
+
+            subdivide(leftIndex, primBounds, centroids, depth + 1);
+            subdivide(leftIndex + 1, primBounds, centroids, depth + 1);
         }
 
-        Vector3 getBackgroundColor() const {
-            return backgroundColor;
+        BVHNode makeNode(uint32_t first, uint32_t count, const std::vector<AABB>& primBounds) const {
+            BVHNode node;
+            node.leftFirst = first;
+            node.count = count;
+            for (uint32_t i = first; i < first + count; i++) {
+                node.bounds.expand(primBounds[primIndices[i]]);
+            }
+            return node;
         }
 
-        size_t getShapeCount() const {
-            return shapes.size();
+        struct Group {
+            uint32_t first;
+            uint32_t count;
+        };
+
+        float nodeCost(const BVHNode& node) const {
+            return node.isLeaf() ? kIntersectCost * batchCost(node.count) : kTraversalCost;
         }
-    };
 
-    // Camera for rendering
-    class Camera {
-    private:
-        Vector3 position;
-        Vector3 target;
-        Vector3 up;
-        float fov;
-        int width, height;
+        void resetRefitState() {
+            parents.clear();
+            leafOf.clear();
+            visitMark.clear();
+            sahCost = 0.0;
+            builtCost = 0.0;
+        }
+
+        void prepareRefit() {
+            if (!parents.empty() || nodes.empty()) return;
+
+            parents.assign(nodes.size(), 0);
+            visitMark.assign(nodes.size(), 0);
+            visitEpoch = 0;
+            uint32_t positions = 0;
+            sahCost = 0.0;
+            for (uint32_t n = 0; n < nodes.size(); n++) {
+                const BVHNode& node = nodes.data()[n];
+                sahCost += (double)node.bounds.surfaceArea() * nodeCost(node);
+                if (node.isLeaf()) {
+                    positions = std::max(positions, node.leftFirst + node.count);
+                } else {
+                    parents[node.leftFirst] = n;
+                    parents[node.leftFirst + 1] = n;
+                }
+            }
+            leafOf.assign(positions, 0);
+            for (uint32_t n = 0; n < nodes.size(); n++) {
+                const BVHNode& node = nodes.data()[n];
+                if (!node.isLeaf()) continue;
+                for (uint32_t p = node.leftFirst; p < node.leftFirst + node.count; p++) {
+                    leafOf[p] = n;
+                }
+            }
+            builtCost = sahCost / std::max(nodes.data()[0].bounds.surfaceArea(), 1e-12f);
+        }
+
+        // Gives each group its own subtree and joins them pairwise above
+        void buildGroups(uint32_t nodeIndex, const std::vector<Group>& groups, size_t lo, size_t hi,
+                         const std::vector<AABB>& primBounds, const std::vector<Vector3>& centroids,
+                         int depth) {
+            if (hi - lo == 1) {
+                nodes[nodeIndex] = makeNode(groups[lo].first, groups[lo].count, primBounds);
+                subdivide(nodeIndex, primBounds, centroids, depth);
+                return;
+            }
+
+            size_t mid = (lo + hi) / 2;
+            uint32_t leftIndex = (uint32_t)nodes.size();
+            nodes.emplace_back();
+            nodes.emplace_back();
+            buildGroups(leftIndex, groups, lo, mid, primBounds, centroids, depth + 1);
+            buildGroups(leftIndex + 1, groups, mid, hi, primBounds, centroids, depth + 1);
+
+            BVHNode& node = nodes[nodeIndex];
+            node.bounds = nodes[leftIndex].bounds;
+            node.bounds.expand(nodes[leftIndex + 1].bounds);
+            node.leftFirst = leftIndex;
+            node.count = 0;
+        }
 
     public:
-        Camera(const Vector3& pos, const Vector3& tgt, const Vector3& u,
-               float fieldOfView, int w, int h)
-            : position(pos), target(tgt), up(u), fov(fieldOfView), width(w), height(h) {}
+        void build(const std::vector<AABB>& primBounds,
+                   const BVHBuildOptions& buildOptions = BVHBuildOptions()) {
+            build(primBounds, std::vector<uint32_t>{(uint32_t)primBounds.size()}, buildOptions);
+        }
 
-        Ray generateRay(int x, int y) const {
-            float aspect = (float)width / height;
-            float scale = std::tan(fov * 0.5f * M_PI / 180.0f);
-            
-            Vector3 forward = (target - position).normalize();
-            Vector3 right = forward.cross(up).normalize();
-            Vector3 upVec = right.cross(forward).normalize();
+        // Builds one tree over consecutive groups of primitives (e.g. spheres
+        // followed by triangles). No leaf straddles two groups, so a leaf's
+        // first index tells which group it belongs to.
+        void build(const std::vector<AABB>& primBounds, const std::vector<uint32_t>& groupSizes,
+                   const BVHBuildOptions& buildOptions = BVHBuildOptions()) {
+            options = buildOptions;
+            resetRefitState();
+            nodes.clear();
+            primIndices.resize(primBounds.size());
+            if (primBounds.empty()) return;
 
-            float px = (2.0f * (x + 0.5f) / width - 1.0f) * aspect * scale;
-            float py = (1.0f - 2.0f * (y + 0.5f) / height) * scale;
+            std::vector<Vector3> centroids(primBounds.size());
+            for (size_t i = 0; i < primBounds.size(); i++) {
+                primIndices[i] = (uint32_t)i;
+                centroids[i] = primBounds[i].centroid();
+            }
+
+            std::vector<Group> groups;
+            uint32_t first = 0;
+            for (uint32_t size : groupSizes) {
+                if (size > 0) groups.push_back({first, size});
+                first += size;
+            }
 
-            Vector3 direction = (forward + right * px + upVec * py).normalize();
-            return Ray(position, direction);
+            nodes.reserve(primBounds.size() * 2 + groups.size());
+            nodes.emplace_back();
+            buildGroups(0, groups, 0, groups.size(), primBounds, centroids, 0);
         }
 
-        int getWidth() const { return width; }
-        int getHeight() const { return height; }
-    };
+        void clear() {
+            nodes.clear();
+            primIndices.clear();
+            resetRefitState();
+        }
 
-    // Ray Tracing Engine
-    class RayTracingEngine {
-    private:
-        Scene scene;
-        Camera camera;
+        // Recomputes the bounds of the leaves holding the given leaf-order
+        // positions and of their ancestors, each node once, children before
+        // parents. leafBounds(first, count) returns a leaf's new box. Returns
+        // the number of nodes updated.
+        template<typename LeafBounds>
+        uint32_t refit(const std::vector<uint32_t>& positions, LeafBounds&& leafBounds) {
+            if (nodes.empty() || positions.empty()) return 0;
+            prepareRefit();
+            if (++visitEpoch == 0) {
+                std::fill(visitMark.begin(), visitMark.end(), 0);
+                visitEpoch = 1;
+            }
 
-    public:
-        RayTracingEngine(const Scene& s, const Camera& c)
-            : scene(s), camera(c) {}
+            std::vector<uint32_t> dirty;
+            for (uint32_t position : positions) {
+                uint32_t n = leafOf[position];
+                while (visitMark[n] != visitEpoch) {
+                    visitMark[n] = visitEpoch;
+                    dirty.push_back(n);
+                    if (n == 0) break;
+                    n = parents[n];
+                }
+            }
 
-        Vector3 renderPixel(int x, int y) const {
-            Ray ray = camera.generateRay(x, y);
-            HitInfo hit = scene.traceRay(ray);
+            // Children are always allocated after their parent
+            std::sort(dirty.begin(), dirty.end(), std::greater<uint32_t>());
+            for (uint32_t n : dirty) {
+                BVHNode& node = nodes[n];
+                double oldArea = node.bounds.surfaceArea();
+                if (node.isLeaf()) {
+                    node.bounds = leafBounds(node.leftFirst, node.count);
+                } else {
+                    node.bounds = nodes[node.leftFirst].bounds;
+                    node.bounds.expand(nodes[node.leftFirst + 1].bounds);
+                }
+                sahCost += (node.bounds.surfaceArea() - oldArea) * nodeCost(node);
+            }
+            return (uint32_t)dirty.size();
+        }
 
-            if (hit.hit) {
-                // Simple shading with normal-based lighting
-                Vector3 lightDir = Vector3(1, 1, 1).normalize();
-                float lightIntensity = std::max(0.0f, hit.normal.dot(lightDir));
-                return hit.material.albedo * (0.3f + 0.7f * lightIntensity);
+        // SAH cost relative to the tree as built: 1 right after a build,
+        // growing as refits stretch nodes over primitives that drifted apart
+        float getQualityRatio() const {
+            if (parents.empty() || builtCost <= 0.0) return 1.0f;
+            double rootArea = std::max(nodes[0].bounds.surfaceArea(), 1e-12f);
+            return (float)(sahCost / rootArea / builtCost);
+        }
+
+        bool empty() const { return nodes.empty(); }
+        size_t getNodeCount() const { return nodes.size(); }
+        const StorageArray<BVHNode>& getNodes() const { return nodes; }
+
+        // Uses a prebuilt node array in place, e.g. from a scene file. The
+        // primitive order is then only known to whoever built the nodes.
+        // Whether count nodes form a tree the traversals can walk safely:
+        // children come after their parent and inside the array, leaves
+        // cover primitives below primitiveCount, and no leaf is deeper than
+        // the traversal stacks allow. One pass, since parents precede children.
+        static bool isValidTree(const BVHNode* data, size_t count, uint64_t primitiveCount) {
+            std::vector<uint8_t> depth(count, 0);
+            for (size_t i = 0; i < count; i++) {
+                const BVHNode& node = data[i];
+                if (node.isLeaf()) {
+                    if ((uint64_t)node.leftFirst + node.count > primitiveCount) return false;
+                    continue;
+                }
+                if (node.leftFirst <= i || (uint64_t)node.leftFirst + 1 >= count) return false;
+                if (depth[i] >= kMaxDepth) return false;
+                for (uint32_t child = node.leftFirst; child <= node.leftFirst + 1; child++) {
+                    depth[child] = std::max<uint8_t>(depth[child], depth[i] + 1);
+                }
             }
+            return true;
+        }
 
-            return scene.getBackgroundColor();
+        void borrowNodes(const BVHNode* data, size_t count) {
+            nodes.borrow(data, count);
+            primIndices.clear();
+            resetRefitState();
         }
+        const std::vector<uint32_t>& getPrimIndices() const { return primIndices; }
 
-        void render(int* pixels) const {
-            for (int y = 0; y < camera.getHeight(); y++) {
-                for (int x = 0; x < camera.getWidth(); x++) {
-                    Vector3 color = renderPixel(x, y);
-                    int index = (y * camera.getWidth() + x) * 3;
-                    pixels[index] = (int)(std::min(1.0f, color.x) * 255);
-                    pixels[index + 1] = (int)(std::min(1.0f, color.y) * 255);
-                    pixels[index + 2] = (int)(std::min(1.0f, color.z) * 255);
+        // Walks the tree front to back. visit(primIndex, tMax) tests one
+        // primitive and shrinks tMax when it finds a closer hit.
+        template<typename Visitor>
+        void traverse(const Ray& ray, float& tMax, Visitor&& visit) const {
+            traverseLeaves(ray, tMax, [&](uint32_t first, uint32_t count, float& t) {
+                for (uint32_t i = first; i < first + count; i++) {
+                    visit(primIndices[i], t);
+                }
+            });
+        }
+
+        // Packet walk. query.intersectBox(bounds, mask, tNear) returns the
+        // lanes of mask whose rays enter the box; visit(first, count, mask)
+        // receives each leaf together with the lanes that reached it.
+        template<typename PacketQuery, typename LeafVisitor>
+        void traversePacket(PacketQuery& query, uint32_t activeMask, LeafVisitor&& visit) const {
+            if (nodes.empty() || activeMask == 0) return;
+            const BVHNode* nodeData = nodes.data();
+
+            float tNear;
+            uint32_t rootMask = query.intersectBox(nodeData[0].bounds, activeMask, tNear);
+            if (rootMask == 0) return;
+
+            struct Entry {
+                uint32_t node;
+                uint32_t mask;
+            };
+            Entry stack[kMaxDepth + 4];
+            int stackSize = 0;
+            stack[stackSize++] = {0, rootMask};
+
+            while (stackSize > 0) {
+                Entry entry = stack[--stackSize];
+                const BVHNode& node = nodeData[entry.node];
+                if (node.isLeaf()) {
+                    visit(node.leftFirst, node.count, entry.mask);
+                    continue;
+                }
+
+                uint32_t left = node.leftFirst;
+                uint32_t right = left + 1;
+                float tLeft, tRight;
+                uint32_t maskLeft = query.intersectBox(nodeData[left].bounds, entry.mask, tLeft);
+                uint32_t maskRight = query.intersectBox(nodeData[right].bounds, entry.mask, tRight);
+
+                // Nearest entry point over the active lanes decides the order
+                if (maskLeft && maskRight) {
+                    if (tLeft > tRight) {
+                        std::swap(left, right);
+                        std::swap(maskLeft, maskRight);
+                    }
+                    stack[stackSize++] = {right, maskRight};
+                    stack[stackSize++] = {left, maskLeft};
+                } else if (maskLeft) {
+                    stack[stackSize++] = {left, maskLeft};
+                } else if (maskRight) {
+                    stack[stackSize++] = {right, maskRight};
+                }
+            }
+        }
+
+        // Any-hit walk for occlusion queries: visit(first, count) returns true
+        // on the first blocking primitive and the walk stops there. Children
+        // are tested before they are pushed and the nearer one is visited
+        // first, the way traverseLeaves() does, since blockers near the
+        // origin end the walk soonest.
+        template<typename LeafVisitor>
+        bool traverseAny(const Ray& ray, float tMax, LeafVisitor&& visit) const {
+            if (nodes.empty()) return false;
+            const BVHNode* nodeData = nodes.data();
+
+            Vector3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+            float tNear;
+            if (!nodeData[0].bounds.intersect(ray.origin, invDir, tMax, tNear)) return false;
+
+            uint32_t stack[kMaxDepth + 4];
+            int stackSize = 0;
+            stack[stackSize++] = 0;
+
+            while (stackSize > 0) {
+                const BVHNode& node = nodeData[stack[--stackSize]];
+                if (node.isLeaf()) {
+                    if (visit(node.leftFirst, node.count)) return true;
+                    continue;
+                }
+
+                uint32_t left = node.leftFirst;
+                uint32_t right = left + 1;
+                float tLeft, tRight;
+                bool hitLeft = nodeData[left].bounds.intersect(ray.origin, invDir, tMax, tLeft);
+                bool hitRight = nodeData[right].bounds.intersect(ray.origin, invDir, tMax, tRight);
+
+                if (hitLeft && hitRight) {
+                    if (tLeft > tRight) std::swap(left, right);
+                    stack[stackSize++] = right;
+                    stack[stackSize++] = left;
+                } else if (hitLeft) {
+                    stack[stackSize++] = left;
+                } else if (hitRight) {
+                    stack[stackSize++] = right;
+                }
+            }
+            return false;
+        }
+
+        // Same walk, but hands whole leaves to visit(first, count, tMax) as
+        // ranges into getPrimIndices() for batched leaf kernels.
+        template<typename LeafVisitor>
+        void traverseLeaves(const Ray& ray, float& tMax, LeafVisitor&& visit) const {
+            if (nodes.empty()) return;
+            const BVHNode* nodeData = nodes.data();
+
+            Vector3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+            float tNear;
+            if (!nodeData[0].bounds.intersect(ray.origin, invDir, tMax, tNear)) return;
+
+            struct Entry {
+                uint32_t node;
+                float tNear;
+            };
+            Entry stack[kMaxDepth + 4];
+            int stackSize = 0;
+            stack[stackSize++] = {0, tNear};
+
+            while (stackSize > 0) {
+                Entry entry = stack[--stackSize];
+                if (entry.tNear >= tMax) continue;
+
+                const BVHNode& node = nodeData[entry.node];
+                if (node.isLeaf()) {
+                    visit(node.leftFirst, node.count, tMax);
+                    continue;
+                }
+
+                uint32_t left = node.leftFirst;
+                uint32_t right = left + 1;
+                float tLeft, tRight;
+                bool hitLeft = nodeData[left].bounds.intersect(ray.origin, invDir, tMax, tLeft);
+                bool hitRight = nodeData[right].bounds.intersect(ray.origin, invDir, tMax, tRight);
+
+                // Push the far child first so the near child is popped next
+                if (hitLeft && hitRight) {
+                    if (tLeft > tRight) {
+                        std::swap(left, right);
+                        std::swap(tLeft, tRight);
+                    }
+                    stack[stackSize++] = {right, tRight};
+                    stack[stackSize++] = {left, tLeft};
+                } else if (hitLeft) {
+                    stack[stackSize++] = {left, tLeft};
+                } else if (hitRight) {
+                    stack[stackSize++] = {right, tRight};
+                }
+            }
+        }
+    };
+
+    // Instruction sets the intersection kernels are specialised for
+    enum class SimdLevel {
+        Scalar,
+        SSE,        // 4-wide, x86 baseline
+        AVX2,       // 8-wide with FMA
+        NEON        // 4-wide, AArch64 baseline
+    };
+
+    inline const char* simdLevelName(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::SSE: return "sse";
+            case SimdLevel::AVX2: return "avx2";
+            case SimdLevel::NEON: return "neon";
+            default: return "scalar";
+        }
+    }
+
+    // Best kernel the running CPU supports, detected once
+    inline SimdLevel detectSimdLevel() {
+        static const SimdLevel level = [] {
+#if defined(RT_SIMD_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool fma = (info[2] & (1 << 12)) != 0;
+            bool ymmEnabled = osxsave && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            bool avx2 = (info[1] & (1 << 5)) != 0;
+            return (avx2 && fma && ymmEnabled) ? SimdLevel::AVX2 : SimdLevel::SSE;
+#else
+            __builtin_cpu_init();
+            bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            return avx2 ? SimdLevel::AVX2 : SimdLevel::SSE;
+#endif
+#elif defined(RT_SIMD_NEON)
+            return SimdLevel::NEON;
+#else
+            return SimdLevel::Scalar;
+#endif
+        }();
+        return level;
+    }
+
+    inline bool isSimdLevelSupported(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::Scalar: return true;
+#if defined(RT_SIMD_X86)
+            case SimdLevel::SSE: return true;
+            case SimdLevel::AVX2: return detectSimdLevel() == SimdLevel::AVX2;
+#elif defined(RT_SIMD_NEON)
+            case SimdLevel::NEON: return true;
+#endif
+            default: return false;
+        }
+    }
+
+    // Read-only view of the sphere arrays handed to the kernels
+    struct SphereArrays {
+        const float* cx;
+        const float* cy;
+        const float* cz;
+        const float* radius2;
+    };
+
+    // Tests one ray against spheres [first, first + count) and returns the
+    // index of the closest hit nearer than tMax (shrinking tMax), or -1.
+    // Ray directions are unit length, so the quadratic's a term is 1.
+    using SphereKernel = int (*)(const SphereArrays& spheres, uint32_t first, uint32_t count,
+                                 const Ray& ray, float& tMax);
+
+    namespace SphereKernels {
+
+        constexpr float kEpsilon = 0.001f;
+
+        inline int intersectScalar(const SphereArrays& s, uint32_t first, uint32_t count,
+                                   const Ray& ray, float& tMax) {
+            int best = -1;
+            for (uint32_t i = first; i < first + count; i++) {
+                float ocx = ray.origin.x - s.cx[i];
+                float ocy = ray.origin.y - s.cy[i];
+                float ocz = ray.origin.z - s.cz[i];
+                float b = ocx * ray.direction.x + ocy * ray.direction.y + ocz * ray.direction.z;
+                float c = ocx * ocx + ocy * ocy + ocz * ocz - s.radius2[i];
+                float discriminant = b * b - c;
+                if (discriminant < 0) continue;
+
+                float sqrtD = std::sqrt(discriminant);
+                float t = (-b - sqrtD > kEpsilon) ? -b - sqrtD : -b + sqrtD;
+                if (t > kEpsilon && t < tMax) {
+                    tMax = t;
+                    best = (int)i;
+                }
+            }
+            return best;
+        }
+
+        // Picks the lowest t among the lanes; ties go to the lowest index
+        template<int Width>
+        inline int reduceClosest(const float* laneT, const int* laneIndex, float& tMax) {
+            int best = -1;
+            for (int lane = 0; lane < Width; lane++) {
+                if (laneIndex[lane] >= 0 &&
+                    (laneT[lane] < tMax || (laneT[lane] == tMax && laneIndex[lane] < best))) {
+                    tMax = laneT[lane];
+                    best = laneIndex[lane];
                 }
             }
+            return best;
+        }
+
+#if defined(RT_SIMD_X86)
+        inline int intersectSSE(const SphereArrays& s, uint32_t first, uint32_t count,
+                                const Ray& ray, float& tMax) {
+            const __m128 ox = _mm_set1_ps(ray.origin.x);
+            const __m128 oy = _mm_set1_ps(ray.origin.y);
+            const __m128 oz = _mm_set1_ps(ray.origin.z);
+            const __m128 dx = _mm_set1_ps(ray.direction.x);
+            const __m128 dy = _mm_set1_ps(ray.direction.y);
+            const __m128 dz = _mm_set1_ps(ray.direction.z);
+            const __m128 eps = _mm_set1_ps(kEpsilon);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+
+            __m128 bestT = _mm_set1_ps(tMax);
+            __m128i bestIndex = _mm_set1_epi32(-1);
+
+            for (uint32_t i = 0; i < count; i += 4) {
+                uint32_t base = first + i;
+                __m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(s.cx + base));
+                __m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(s.cy + base));
+                __m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(s.cz + base));
+                __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+                __m128 c = _mm_sub_ps(
+                    _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)),
+                    _mm_loadu_ps(s.radius2 + base));
+                __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), c);
+                __m128 sqrtD = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+                __m128 negB = _mm_sub_ps(zero, b);
+                __m128 t1 = _mm_sub_ps(negB, sqrtD);
+                __m128 t2 = _mm_add_ps(negB, sqrtD);
+                __m128 useNear = _mm_cmpgt_ps(t1, eps);
+                __m128 t = _mm_or_ps(_mm_and_ps(useNear, t1), _mm_andnot_ps(useNear, t2));
+
+                __m128i inRange = _mm_cmpgt_epi32(_mm_set1_epi32((int)(count - i)), laneOffsets);
+                __m128 mask = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_cmpgt_ps(t, eps));
+                mask = _mm_and_ps(mask, _mm_cmplt_ps(t, bestT));
+                mask = _mm_and_ps(mask, _mm_castsi128_ps(inRange));
+
+                __m128i index = _mm_add_epi32(_mm_set1_epi32((int)base), laneOffsets);
+                __m128i maskI = _mm_castps_si128(mask);
+                bestT = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, bestT));
+                bestIndex = _mm_or_si128(_mm_and_si128(maskI, index), _mm_andnot_si128(maskI, bestIndex));
+            }
+
+            alignas(16) float laneT[4];
+            alignas(16) int laneIndex[4];
+            _mm_store_ps(laneT, bestT);
+            _mm_store_si128((__m128i*)laneIndex, bestIndex);
+            return reduceClosest<4>(laneT, laneIndex, tMax);
+        }
+
+        RT_TARGET_AVX2
+        inline int intersectAVX2(const SphereArrays& s, uint32_t first, uint32_t count,
+                                 const Ray& ray, float& tMax) {
+            const __m256 ox = _mm256_set1_ps(ray.origin.x);
+            const __m256 oy = _mm256_set1_ps(ray.origin.y);
+            const __m256 oz = _mm256_set1_ps(ray.origin.z);
+            const __m256 dx = _mm256_set1_ps(ray.direction.x);
+            const __m256 dy = _mm256_set1_ps(ray.direction.y);
+            const __m256 dz = _mm256_set1_ps(ray.direction.z);
+            const __m256 eps = _mm256_set1_ps(kEpsilon);
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+            __m256 bestT = _mm256_set1_ps(tMax);
+            __m256i bestIndex = _mm256_set1_epi32(-1);
+
+            for (uint32_t i = 0; i < count; i += 8) {
+                uint32_t base = first + i;
+                __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(s.cx + base));
+                __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(s.cy + base));
+                __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(s.cz + base));
+                __m256 b = _mm256_fmadd_ps(ocx, dx, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocz, dz)));
+                __m256 c = _mm256_fmadd_ps(ocx, ocx, _mm256_fmadd_ps(ocy, ocy,
+                    _mm256_fmsub_ps(ocz, ocz, _mm256_loadu_ps(s.radius2 + base))));
+                __m256 discriminant = _mm256_fmsub_ps(b, b, c);
+                __m256 sqrtD = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+                __m256 negB = _mm256_sub_ps(zero, b);
+                __m256 t1 = _mm256_sub_ps(negB, sqrtD);
+                __m256 t2 = _mm256_add_ps(negB, sqrtD);
+                __m256 t = _mm256_blendv_ps(t2, t1, _mm256_cmp_ps(t1, eps, _CMP_GT_OQ));
+
+                __m256i inRange = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(count - i)), laneOffsets);
+                __m256 mask = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ),
+                                            _mm256_cmp_ps(t, eps, _CMP_GT_OQ));
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, bestT, _CMP_LT_OQ));
+                mask = _mm256_and_ps(mask, _mm256_castsi256_ps(inRange));
+
+                __m256i index = _mm256_add_epi32(_mm256_set1_epi32((int)base), laneOffsets);
+                bestT = _mm256_blendv_ps(bestT, t, mask);
+                bestIndex = _mm256_castps_si256(_mm256_blendv_ps(
+                    _mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(index), mask));
+            }
+
+            alignas(32) float laneT[8];
+            alignas(32) int laneIndex[8];
+            _mm256_store_ps(laneT, bestT);
+            _mm256_store_si256((__m256i*)laneIndex, bestIndex);
+            return reduceClosest<8>(laneT, laneIndex, tMax);
+        }
+#endif
+
+#if defined(RT_SIMD_NEON)
+        inline int intersectNEON(const SphereArrays& s, uint32_t first, uint32_t count,
+                                 const Ray& ray, float& tMax) {
+            const float32x4_t ox = vdupq_n_f32(ray.origin.x);
+            const float32x4_t oy = vdupq_n_f32(ray.origin.y);
+            const float32x4_t oz = vdupq_n_f32(ray.origin.z);
+            const float32x4_t dx = vdupq_n_f32(ray.direction.x);
+            const float32x4_t dy = vdupq_n_f32(ray.direction.y);
+            const float32x4_t dz = vdupq_n_f32(ray.direction.z);
+            const float32x4_t eps = vdupq_n_f32(kEpsilon);
+            const float32x4_t zero = vdupq_n_f32(0.0f);
+            const int32_t offsets[4] = {0, 1, 2, 3};
+            const int32x4_t laneOffsets = vld1q_s32(offsets);
+
+            float32x4_t bestT = vdupq_n_f32(tMax);
+            int32x4_t bestIndex = vdupq_n_s32(-1);
+
+            for (uint32_t i = 0; i < count; i += 4) {
+                uint32_t base = first + i;
+                float32x4_t ocx = vsubq_f32(ox, vld1q_f32(s.cx + base));
+                float32x4_t ocy = vsubq_f32(oy, vld1q_f32(s.cy + base));
+                float32x4_t ocz = vsubq_f32(oz, vld1q_f32(s.cz + base));
+                float32x4_t b = vfmaq_f32(vfmaq_f32(vmulq_f32(ocz, dz), ocy, dy), ocx, dx);
+                float32x4_t c = vsubq_f32(
+                    vfmaq_f32(vfmaq_f32(vmulq_f32(ocz, ocz), ocy, ocy), ocx, ocx),
+                    vld1q_f32(s.radius2 + base));
+                float32x4_t discriminant = vfmsq_f32(vnegq_f32(c), b, vnegq_f32(b));
+                float32x4_t sqrtD = vsqrtq_f32(vmaxq_f32(discriminant, zero));
+                float32x4_t negB = vnegq_f32(b);
+                float32x4_t t1 = vsubq_f32(negB, sqrtD);
+                float32x4_t t2 = vaddq_f32(negB, sqrtD);
+                float32x4_t t = vbslq_f32(vcgtq_f32(t1, eps), t1, t2);
+
+                uint32x4_t inRange = vcgtq_s32(vdupq_n_s32((int32_t)(count - i)), laneOffsets);
+                uint32x4_t mask = vandq_u32(vcgeq_f32(discriminant, zero), vcgtq_f32(t, eps));
+                mask = vandq_u32(mask, vcltq_f32(t, bestT));
+                mask = vandq_u32(mask, inRange);
+
+                int32x4_t index = vaddq_s32(vdupq_n_s32((int32_t)base), laneOffsets);
+                bestT = vbslq_f32(mask, t, bestT);
+                bestIndex = vbslq_s32(mask, index, bestIndex);
+            }
+
+            float laneT[4];
+            int laneIndex[4];
+            vst1q_f32(laneT, bestT);
+            vst1q_s32(laneIndex, bestIndex);
+            return reduceClosest<4>(laneT, laneIndex, tMax);
+        }
+#endif
+
+        inline SphereKernel select(SimdLevel level) {
+            switch (level) {
+#if defined(RT_SIMD_X86)
+                case SimdLevel::SSE: return intersectSSE;
+                case SimdLevel::AVX2: return intersectAVX2;
+#elif defined(RT_SIMD_NEON)
+                case SimdLevel::NEON: return intersectNEON;
+#endif
+                default: return intersectScalar;
+            }
+        }
+
+        inline uint32_t width(SimdLevel level) {
+            switch (level) {
+                case SimdLevel::AVX2: return 8;
+                case SimdLevel::SSE:
+                case SimdLevel::NEON: return 4;
+                default: return 1;
+            }
+        }
+
+    } // namespace SphereKernels
+
+    // Structure-of-arrays sphere storage. Every array carries kPadding
+    // trailing never-hit spheres so the SIMD kernels can load full vectors
+    // past the end of a range without bounds checks.
+    class SphereSoA {
+    public:
+        static constexpr uint32_t kPadding = 8;
+
+    private:
+        StorageArray<float> cx, cy, cz;
+        StorageArray<float> radius2;
+        StorageArray<uint32_t> materialIndex;
+        StorageArray<uint32_t> ids;         // Slot -> stable id; empty means identity
+        std::vector<uint32_t> slots;        // Id -> slot, rebuilt whenever the order changes
+        uint32_t count;
+        SimdLevel simdLevel;
+        SphereKernel kernel;
+
+        void materializeIds() {
+            if (!ids.empty() || count == 0) return;
+            ids.resize(count);
+            for (uint32_t i = 0; i < count; i++) ids[i] = i;
+        }
+
+        // Kept current by every change of order, so const readers on
+        // several threads never write it
+        void rebuildSlots() {
+            slots.resize(count);
+            for (uint32_t i = 0; i < count; i++) slots[getId(i)] = i;
+        }
+
+        // A radius of 0 is stored like padding: a point-sized sphere can
+        // still be hit through rounding in the discriminant
+        static float squaredRadius(float radius) {
+            return radius > 0.0f ? radius * radius : -1.0f;
+        }
+
+        void pad() {
+            // radius2 = -1 keeps the discriminant negative for any ray
+            cx.resize(count + kPadding, 0.0f);
+            cy.resize(count + kPadding, 0.0f);
+            cz.resize(count + kPadding, 0.0f);
+            radius2.resize(count + kPadding, -1.0f);
+        }
+
+    public:
+        SphereSoA() : count(0) {
+            setSimdLevel(detectSimdLevel());
+            pad();
+        }
+
+        // Returns the sphere's id, which survives the reordering done by
+        // BVH builds
+        uint32_t add(const Vector3& center, float radius, uint32_t material) {
+            materializeIds();
+            cx[count] = center.x;
+            cy[count] = center.y;
+            cz[count] = center.z;
+            radius2[count] = squaredRadius(radius);
+            materialIndex.push_back(material);
+            ids.push_back(count);
+            slots.push_back(count);
+            count++;
+            pad();
+            return count - 1;
+        }
+
+        // Moves the sphere in the given slot; padding is left untouched
+        void update(uint32_t slot, const Vector3& center, float radius) {
+            cx[slot] = center.x;
+            cy[slot] = center.y;
+            cz[slot] = center.z;
+            radius2[slot] = squaredRadius(radius);
+        }
+
+        void setMaterialIndex(uint32_t slot, uint32_t materialId) { materialIndex[slot] = materialId; }
+
+        uint32_t getId(uint32_t slot) const { return ids.empty() ? slot : ids[slot]; }
+
+        uint32_t getSlot(uint32_t id) const { return slots[id]; }
+
+        void reserve(size_t capacity) {
+            cx.reserve(capacity + kPadding);
+            cy.reserve(capacity + kPadding);
+            cz.reserve(capacity + kPadding);
+            radius2.reserve(capacity + kPadding);
+            materialIndex.reserve(capacity);
+            ids.reserve(capacity);
+        }
+
+        // Reorders the spheres so slot i holds the sphere previously at order[i]
+        void permute(const std::vector<uint32_t>& order) {
+            auto apply = [&](auto& values) {
+                std::vector<typename std::decay_t<decltype(values)>::value_type> reordered(
+                    values.begin(), values.end());
+                for (uint32_t i = 0; i < count; i++) {
+                    reordered[i] = values.data()[order[i]];
+                }
+                values.assign(std::move(reordered));
+            };
+            apply(cx);
+            apply(cy);
+            apply(cz);
+            apply(radius2);
+            apply(materialIndex);
+            materializeIds();
+            apply(ids);
+            rebuildSlots();
+        }
+
+        // Falls back to the scalar kernel if the CPU lacks the requested ISA
+        SimdLevel setSimdLevel(SimdLevel level) {
+            simdLevel = isSimdLevelSupported(level) ? level : SimdLevel::Scalar;
+            kernel = SphereKernels::select(simdLevel);
+            return simdLevel;
+        }
+
+        SimdLevel getSimdLevel() const { return simdLevel; }
+        uint32_t getKernelWidth() const { return SphereKernels::width(simdLevel); }
+
+        SphereArrays getArrays() const {
+            return SphereArrays{cx.data(), cy.data(), cz.data(), radius2.data()};
+        }
+
+        const uint32_t* getMaterialIndices() const { return materialIndex.data(); }
+
+        // Uses existing arrays in place: the four geometry arrays hold
+        // sphereCount + kPadding entries, materials and sphereIds (which may be
+        // null for identity ids) hold sphereCount
+        void borrow(const SphereArrays& arrays, const uint32_t* materials, const uint32_t* sphereIds,
+                    uint32_t sphereCount) {
+            count = sphereCount;
+            if (sphereIds) {
+                ids.borrow(sphereIds, count);
+            } else {
+                ids.reset();
+            }
+            rebuildSlots();
+            cx.borrow(arrays.cx, count + kPadding);
+            cy.borrow(arrays.cy, count + kPadding);
+            cz.borrow(arrays.cz, count + kPadding);
+            radius2.borrow(arrays.radius2, count + kPadding);
+            materialIndex.borrow(materials, count);
+        }
+
+        int intersect(uint32_t first, uint32_t rangeCount, const Ray& ray, float& tMax) const {
+            return kernel(getArrays(), first, rangeCount, ray, tMax);
+        }
+
+        uint32_t size() const { return count; }
+        Vector3 getCenter(uint32_t i) const { return Vector3(cx[i], cy[i], cz[i]); }
+        float getRadius(uint32_t i) const { return radius2[i] > 0.0f ? std::sqrt(radius2[i]) : 0.0f; }
+        uint32_t getMaterialIndex(uint32_t i) const { return materialIndex[i]; }
+
+        AABB getBounds(uint32_t i) const {
+            float r = getRadius(i);
+            Vector3 extent(r, r, r);
+            return AABB(getCenter(i) - extent, getCenter(i) + extent);
+        }
+    };
+
+    // Read-only view of per-triangle v0 and edges e1 = v1 - v0, e2 = v2 - v0
+    struct TriangleArrays {
+        const float* v0x;
+        const float* v0y;
+        const float* v0z;
+        const float* e1x;
+        const float* e1y;
+        const float* e1z;
+        const float* e2x;
+        const float* e2y;
+        const float* e2z;
+    };
+
+    // Same contract as SphereKernel, for triangles [first, first + count)
+    using TriangleKernel = int (*)(const TriangleArrays& triangles, uint32_t first, uint32_t count,
+                                   const Ray& ray, float& tMax);
+
+    // Möller–Trumbore ray/triangle tests. Triangles are two-sided and
+    // degenerate ones (zero determinant) never hit.
+    namespace TriangleKernels {
+
+        constexpr float kEpsilon = SphereKernels::kEpsilon;
+        constexpr float kDetEpsilon = 1e-12f;
+
+        inline int intersectScalar(const TriangleArrays& tr, uint32_t first, uint32_t count,
+                                   const Ray& ray, float& tMax) {
+            const Vector3& o = ray.origin;
+            const Vector3& d = ray.direction;
+            int best = -1;
+            for (uint32_t i = first; i < first + count; i++) {
+                float px = d.y * tr.e2z[i] - d.z * tr.e2y[i];
+                float py = d.z * tr.e2x[i] - d.x * tr.e2z[i];
+                float pz = d.x * tr.e2y[i] - d.y * tr.e2x[i];
+                float det = tr.e1x[i] * px + tr.e1y[i] * py + tr.e1z[i] * pz;
+                if (std::fabs(det) <= kDetEpsilon) continue;
+
+                float invDet = 1.0f / det;
+                float tx = o.x - tr.v0x[i];
+                float ty = o.y - tr.v0y[i];
+                float tz = o.z - tr.v0z[i];
+                float u = (tx * px + ty * py + tz * pz) * invDet;
+                if (u < 0.0f || u > 1.0f) continue;
+
+                float qx = ty * tr.e1z[i] - tz * tr.e1y[i];
+                float qy = tz * tr.e1x[i] - tx * tr.e1z[i];
+                float qz = tx * tr.e1y[i] - ty * tr.e1x[i];
+                float v = (d.x * qx + d.y * qy + d.z * qz) * invDet;
+                if (v < 0.0f || u + v > 1.0f) continue;
+
+                float t = (tr.e2x[i] * qx + tr.e2y[i] * qy + tr.e2z[i] * qz) * invDet;
+                if (t > kEpsilon && t < tMax) {
+                    tMax = t;
+                    best = (int)i;
+                }
+            }
+            return best;
+        }
+
+#if defined(RT_SIMD_X86)
+        inline int intersectSSE(const TriangleArrays& tr, uint32_t first, uint32_t count,
+                                const Ray& ray, float& tMax) {
+            const __m128 ox = _mm_set1_ps(ray.origin.x);
+            const __m128 oy = _mm_set1_ps(ray.origin.y);
+            const __m128 oz = _mm_set1_ps(ray.origin.z);
+            const __m128 dx = _mm_set1_ps(ray.direction.x);
+            const __m128 dy = _mm_set1_ps(ray.direction.y);
+            const __m128 dz = _mm_set1_ps(ray.direction.z);
+            const __m128 eps = _mm_set1_ps(kEpsilon);
+            const __m128 detEps = _mm_set1_ps(kDetEpsilon);
+            const __m128 signBit = _mm_set1_ps(-0.0f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+
+            __m128 bestT = _mm_set1_ps(tMax);
+            __m128i bestIndex = _mm_set1_epi32(-1);
+
+            for (uint32_t i = 0; i < count; i += 4) {
+                uint32_t base = first + i;
+                __m128 e1x = _mm_loadu_ps(tr.e1x + base);
+                __m128 e1y = _mm_loadu_ps(tr.e1y + base);
+                __m128 e1z = _mm_loadu_ps(tr.e1z + base);
+                __m128 e2x = _mm_loadu_ps(tr.e2x + base);
+                __m128 e2y = _mm_loadu_ps(tr.e2y + base);
+                __m128 e2z = _mm_loadu_ps(tr.e2z + base);
+
+                __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+                __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+                __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+                __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+                __m128 invDet = _mm_div_ps(one, det);
+
+                __m128 tx = _mm_sub_ps(ox, _mm_loadu_ps(tr.v0x + base));
+                __m128 ty = _mm_sub_ps(oy, _mm_loadu_ps(tr.v0y + base));
+                __m128 tz = _mm_sub_ps(oz, _mm_loadu_ps(tr.v0z + base));
+                __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+                __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+                __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+                __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+                __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+                __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+                __m128i inRange = _mm_cmpgt_epi32(_mm_set1_epi32((int)(count - i)), laneOffsets);
+                __m128 mask = _mm_cmpgt_ps(_mm_andnot_ps(signBit, det), detEps);
+                mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+                mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+                mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(t, eps), _mm_cmplt_ps(t, bestT)));
+                mask = _mm_and_ps(mask, _mm_castsi128_ps(inRange));
+
+                __m128i index = _mm_add_epi32(_mm_set1_epi32((int)base), laneOffsets);
+                __m128i maskI = _mm_castps_si128(mask);
+                bestT = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, bestT));
+                bestIndex = _mm_or_si128(_mm_and_si128(maskI, index), _mm_andnot_si128(maskI, bestIndex));
+            }
+
+            alignas(16) float laneT[4];
+            alignas(16) int laneIndex[4];
+            _mm_store_ps(laneT, bestT);
+            _mm_store_si128((__m128i*)laneIndex, bestIndex);
+            return SphereKernels::reduceClosest<4>(laneT, laneIndex, tMax);
+        }
+
+        RT_TARGET_AVX2
+        inline int intersectAVX2(const TriangleArrays& tr, uint32_t first, uint32_t count,
+                                 const Ray& ray, float& tMax) {
+            const __m256 ox = _mm256_set1_ps(ray.origin.x);
+            const __m256 oy = _mm256_set1_ps(ray.origin.y);
+            const __m256 oz = _mm256_set1_ps(ray.origin.z);
+            const __m256 dx = _mm256_set1_ps(ray.direction.x);
+            const __m256 dy = _mm256_set1_ps(ray.direction.y);
+            const __m256 dz = _mm256_set1_ps(ray.direction.z);
+            const __m256 eps = _mm256_set1_ps(kEpsilon);
+            const __m256 detEps = _mm256_set1_ps(kDetEpsilon);
+            const __m256 signBit = _mm256_set1_ps(-0.0f);
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+            __m256 bestT = _mm256_set1_ps(tMax);
+            __m256i bestIndex = _mm256_set1_epi32(-1);
+
+            for (uint32_t i = 0; i < count; i += 8) {
+                uint32_t base = first + i;
+                __m256 e1x = _mm256_loadu_ps(tr.e1x + base);
+                __m256 e1y = _mm256_loadu_ps(tr.e1y + base);
+                __m256 e1z = _mm256_loadu_ps(tr.e1z + base);
+                __m256 e2x = _mm256_loadu_ps(tr.e2x + base);
+                __m256 e2y = _mm256_loadu_ps(tr.e2y + base);
+                __m256 e2z = _mm256_loadu_ps(tr.e2z + base);
+
+                __m256 px = _mm256_fmsub_ps(dy, e2z, _mm256_mul_ps(dz, e2y));
+                __m256 py = _mm256_fmsub_ps(dz, e2x, _mm256_mul_ps(dx, e2z));
+                __m256 pz = _mm256_fmsub_ps(dx, e2y, _mm256_mul_ps(dy, e2x));
+                __m256 det = _mm256_fmadd_ps(e1x, px, _mm256_fmadd_ps(e1y, py, _mm256_mul_ps(e1z, pz)));
+                __m256 invDet = _mm256_div_ps(one, det);
+
+                __m256 tx = _mm256_sub_ps(ox, _mm256_loadu_ps(tr.v0x + base));
+                __m256 ty = _mm256_sub_ps(oy, _mm256_loadu_ps(tr.v0y + base));
+                __m256 tz = _mm256_sub_ps(oz, _mm256_loadu_ps(tr.v0z + base));
+                __m256 u = _mm256_mul_ps(_mm256_fmadd_ps(tx, px, _mm256_fmadd_ps(ty, py, _mm256_mul_ps(tz, pz))), invDet);
+
+                __m256 qx = _mm256_fmsub_ps(ty, e1z, _mm256_mul_ps(tz, e1y));
+                __m256 qy = _mm256_fmsub_ps(tz, e1x, _mm256_mul_ps(tx, e1z));
+                __m256 qz = _mm256_fmsub_ps(tx, e1y, _mm256_mul_ps(ty, e1x));
+                __m256 v = _mm256_mul_ps(_mm256_fmadd_ps(dx, qx, _mm256_fmadd_ps(dy, qy, _mm256_mul_ps(dz, qz))), invDet);
+                __m256 t = _mm256_mul_ps(_mm256_fmadd_ps(e2x, qx, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2z, qz))), invDet);
+
+                __m256i inRange = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(count - i)), laneOffsets);
+                __m256 mask = _mm256_cmp_ps(_mm256_andnot_ps(signBit, det), detEps, _CMP_GT_OQ);
+                mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ),
+                                                         _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+                mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                                         _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+                mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(t, eps, _CMP_GT_OQ),
+                                                         _mm256_cmp_ps(t, bestT, _CMP_LT_OQ)));
+                mask = _mm256_and_ps(mask, _mm256_castsi256_ps(inRange));
+
+                __m256i index = _mm256_add_epi32(_mm256_set1_epi32((int)base), laneOffsets);
+                bestT = _mm256_blendv_ps(bestT, t, mask);
+                bestIndex = _mm256_castps_si256(_mm256_blendv_ps(
+                    _mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(index), mask));
+            }
+
+            alignas(32) float laneT[8];
+            alignas(32) int laneIndex[8];
+            _mm256_store_ps(laneT, bestT);
+            _mm256_store_si256((__m256i*)laneIndex, bestIndex);
+            return SphereKernels::reduceClosest<8>(laneT, laneIndex, tMax);
+        }
+#endif
+
+#if defined(RT_SIMD_NEON)
+        inline int intersectNEON(const TriangleArrays& tr, uint32_t first, uint32_t count,
+                                 const Ray& ray, float& tMax) {
+            const float32x4_t ox = vdupq_n_f32(ray.origin.x);
+            const float32x4_t oy = vdupq_n_f32(ray.origin.y);
+            const float32x4_t oz = vdupq_n_f32(ray.origin.z);
+            const float32x4_t dx = vdupq_n_f32(ray.direction.x);
+            const float32x4_t dy = vdupq_n_f32(ray.direction.y);
+            const float32x4_t dz = vdupq_n_f32(ray.direction.z);
+            const float32x4_t eps = vdupq_n_f32(kEpsilon);
+            const float32x4_t detEps = vdupq_n_f32(kDetEpsilon);
+            const float32x4_t zero = vdupq_n_f32(0.0f);
+            const float32x4_t one = vdupq_n_f32(1.0f);
+            const int32_t offsets[4] = {0, 1, 2, 3};
+            const int32x4_t laneOffsets = vld1q_s32(offsets);
+
+            float32x4_t bestT = vdupq_n_f32(tMax);
+            int32x4_t bestIndex = vdupq_n_s32(-1);
+
+            for (uint32_t i = 0; i < count; i += 4) {
+                uint32_t base = first + i;
+                float32x4_t e1x = vld1q_f32(tr.e1x + base);
+                float32x4_t e1y = vld1q_f32(tr.e1y + base);
+                float32x4_t e1z = vld1q_f32(tr.e1z + base);
+                float32x4_t e2x = vld1q_f32(tr.e2x + base);
+                float32x4_t e2y = vld1q_f32(tr.e2y + base);
+                float32x4_t e2z = vld1q_f32(tr.e2z + base);
+
+                float32x4_t px = vfmsq_f32(vmulq_f32(dy, e2z), dz, e2y);
+                float32x4_t py = vfmsq_f32(vmulq_f32(dz, e2x), dx, e2z);
+                float32x4_t pz = vfmsq_f32(vmulq_f32(dx, e2y), dy, e2x);
+                float32x4_t det = vfmaq_f32(vfmaq_f32(vmulq_f32(e1z, pz), e1y, py), e1x, px);
+                float32x4_t invDet = vdivq_f32(one, det);
+
+                float32x4_t tx = vsubq_f32(ox, vld1q_f32(tr.v0x + base));
+                float32x4_t ty = vsubq_f32(oy, vld1q_f32(tr.v0y + base));
+                float32x4_t tz = vsubq_f32(oz, vld1q_f32(tr.v0z + base));
+                float32x4_t u = vmulq_f32(vfmaq_f32(vfmaq_f32(vmulq_f32(tz, pz), ty, py), tx, px), invDet);
+
+                float32x4_t qx = vfmsq_f32(vmulq_f32(ty, e1z), tz, e1y);
+                float32x4_t qy = vfmsq_f32(vmulq_f32(tz, e1x), tx, e1z);
+                float32x4_t qz = vfmsq_f32(vmulq_f32(tx, e1y), ty, e1x);
+                float32x4_t v = vmulq_f32(vfmaq_f32(vfmaq_f32(vmulq_f32(dz, qz), dy, qy), dx, qx), invDet);
+                float32x4_t t = vmulq_f32(vfmaq_f32(vfmaq_f32(vmulq_f32(e2z, qz), e2y, qy), e2x, qx), invDet);
+
+                uint32x4_t inRange = vcgtq_s32(vdupq_n_s32((int32_t)(count - i)), laneOffsets);
+                uint32x4_t mask = vcgtq_f32(vabsq_f32(det), detEps);
+                mask = vandq_u32(mask, vandq_u32(vcgeq_f32(u, zero), vcleq_f32(u, one)));
+                mask = vandq_u32(mask, vandq_u32(vcgeq_f32(v, zero), vcleq_f32(vaddq_f32(u, v), one)));
+                mask = vandq_u32(mask, vandq_u32(vcgtq_f32(t, eps), vcltq_f32(t, bestT)));
+                mask = vandq_u32(mask, inRange);
+
+                int32x4_t index = vaddq_s32(vdupq_n_s32((int32_t)base), laneOffsets);
+                bestT = vbslq_f32(mask, t, bestT);
+                bestIndex = vbslq_s32(mask, index, bestIndex);
+            }
+
+            float laneT[4];
+            int laneIndex[4];
+            vst1q_f32(laneT, bestT);
+            vst1q_s32(laneIndex, bestIndex);
+            return SphereKernels::reduceClosest<4>(laneT, laneIndex, tMax);
+        }
+#endif
+
+        inline TriangleKernel select(SimdLevel level) {
+            switch (level) {
+#if defined(RT_SIMD_X86)
+                case SimdLevel::SSE: return intersectSSE;
+                case SimdLevel::AVX2: return intersectAVX2;
+#elif defined(RT_SIMD_NEON)
+                case SimdLevel::NEON: return intersectNEON;
+#endif
+                default: return intersectScalar;
+            }
+        }
+
+    } // namespace TriangleKernels
+
+    // How the triangle store keeps per-triangle geometry
+    enum class TriangleLayout {
+        Indexed,        // Vertex buffer and indices only (12 bytes per triangle)
+        Precomputed     // Adds v0 and both edges as SoA arrays (36 more bytes per triangle)
+    };
+
+    // Triangle storage for all meshes in a scene: one shared vertex buffer,
+    // three 32-bit indices per triangle and, in the precomputed layout,
+    // padded SoA edge arrays the kernels read directly. The indexed layout
+    // gathers each leaf's vertices into a small scratch block instead.
+    class TriangleSoA {
+    public:
+        static constexpr uint32_t kPadding = 8;
+        static constexpr uint32_t kBlockSize = 8;
+
+    private:
+        StorageArray<Vector3> vertices;
+        StorageArray<uint32_t> i0, i1, i2;
+        StorageArray<uint32_t> materialIndex;
+        StorageArray<float> v0x, v0y, v0z;
+        StorageArray<float> e1x, e1y, e1z;
+        StorageArray<float> e2x, e2y, e2z;
+        uint32_t count;
+        TriangleLayout layout;
+        SimdLevel simdLevel;
+        TriangleKernel kernel;
+
+        struct Block {
+            alignas(32) float data[9][kBlockSize];
+        };
+
+        // Writes v0, e1 and e2 of triangle i into the nine rows of dst at column k
+        void loadTriangle(uint32_t i, float* const* dst, uint32_t k) const {
+            const Vector3& a = vertices[i0[i]];
+            Vector3 e1 = vertices[i1[i]] - a;
+            Vector3 e2 = vertices[i2[i]] - a;
+            dst[0][k] = a.x;  dst[1][k] = a.y;  dst[2][k] = a.z;
+            dst[3][k] = e1.x; dst[4][k] = e1.y; dst[5][k] = e1.z;
+            dst[6][k] = e2.x; dst[7][k] = e2.y; dst[8][k] = e2.z;
+        }
+
+        // Recomputes the edge arrays from triangle `from` on; padding
+        // triangles keep zero edges, so their determinant is zero.
+        void updateEdges(uint32_t from) {
+            StorageArray<float>* arrays[9] = {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z};
+            if (layout != TriangleLayout::Precomputed) {
+                for (StorageArray<float>* values : arrays) {
+                    values->reset();
+                }
+                return;
+            }
+
+            float* rows[9];
+            for (int r = 0; r < 9; r++) {
+                arrays[r]->resize(count + kPadding, 0.0f);
+                rows[r] = arrays[r]->mutableData();
+            }
+            for (uint32_t i = from; i < count; i++) {
+                loadTriangle(i, rows, i);
+            }
+        }
+
+    public:
+        TriangleSoA() : count(0), layout(TriangleLayout::Precomputed) {
+            setSimdLevel(detectSimdLevel());
+            updateEdges(0);
+        }
+
+        // Appends every triangle of mesh; indices must be < mesh.vertices.size()
+        void add(const TriangleMesh& mesh) {
+            uint32_t base = (uint32_t)vertices.size();
+            uint32_t added = (uint32_t)mesh.getTriangleCount();
+            vertices.append(mesh.vertices.begin(), mesh.vertices.end());
+            reserve(count + added);
+            for (uint32_t t = 0; t < added; t++) {
+                i0.push_back(base + mesh.indices[3 * t]);
+                i1.push_back(base + mesh.indices[3 * t + 1]);
+                i2.push_back(base + mesh.indices[3 * t + 2]);
+                materialIndex.push_back(mesh.materialId);
+            }
+            count += added;
+            updateEdges(count - added);
+        }
+
+        void reserve(size_t capacity) {
+            i0.reserve(capacity);
+            i1.reserve(capacity);
+            i2.reserve(capacity);
+            materialIndex.reserve(capacity);
+        }
+
+        // Reorders the triangles so slot i holds the triangle previously at order[i]
+        void permute(const std::vector<uint32_t>& order) {
+            auto apply = [&](auto& values) {
+                if (values.empty()) return;
+                std::vector<typename std::decay_t<decltype(values)>::value_type> reordered(
+                    values.begin(), values.end());
+                for (uint32_t i = 0; i < count; i++) {
+                    reordered[i] = values.data()[order[i]];
+                }
+                values.assign(std::move(reordered));
+            };
+            apply(i0);
+            apply(i1);
+            apply(i2);
+            apply(materialIndex);
+            updateEdges(0);
+        }
+
+        void setLayout(TriangleLayout newLayout) {
+            layout = newLayout;
+            updateEdges(0);
+        }
+
+        TriangleLayout getLayout() const { return layout; }
+
+        SimdLevel setSimdLevel(SimdLevel level) {
+            simdLevel = isSimdLevelSupported(level) ? level : SimdLevel::Scalar;
+            kernel = TriangleKernels::select(simdLevel);
+            return simdLevel;
+        }
+
+        SimdLevel getSimdLevel() const { return simdLevel; }
+
+        // Runs fn(arrays, first, count, slotBase) over triangles [first,
+        // first + count): index k of arrays is store slot slotBase + k. The
+        // precomputed layout hands over its own arrays in a single call; the
+        // indexed layout gathers kBlockSize triangles at a time.
+        template<typename Fn>
+        void forEachBlock(uint32_t first, uint32_t rangeCount, Fn&& fn) const {
+            if (layout == TriangleLayout::Precomputed) {
+                fn(getEdges(), first, rangeCount, 0u);
+                return;
+            }
+
+            Block block{};
+            float* rows[9];
+            for (int r = 0; r < 9; r++) rows[r] = block.data[r];
+            TriangleArrays arrays{rows[0], rows[1], rows[2], rows[3], rows[4],
+                                  rows[5], rows[6], rows[7], rows[8]};
+            for (uint32_t start = first; start < first + rangeCount; start += kBlockSize) {
+                uint32_t n = std::min(kBlockSize, first + rangeCount - start);
+                for (uint32_t k = 0; k < n; k++) {
+                    loadTriangle(start + k, rows, k);
+                }
+                fn(arrays, 0u, n, start);
+            }
+        }
+
+        int intersect(uint32_t first, uint32_t rangeCount, const Ray& ray, float& tMax) const {
+            int best = -1;
+            forEachBlock(first, rangeCount, [&](const TriangleArrays& arrays, uint32_t blockFirst,
+                                                uint32_t blockCount, uint32_t slotBase) {
+                int slot = kernel(arrays, blockFirst, blockCount, ray, tMax);
+                if (slot >= 0) best = (int)(slotBase + slot);
+            });
+            return best;
+        }
+
+        // Uses existing arrays in place. edges (v0 and edge arrays of
+        // triangleCount + kPadding entries) selects the precomputed layout;
+        // without it the store is indexed.
+        void borrow(const Vector3* vertexData, size_t vertexCount, const uint32_t* const indices[3],
+                    const uint32_t* materials, uint32_t triangleCount, const TriangleArrays* edges) {
+            count = triangleCount;
+            vertices.borrow(vertexData, vertexCount);
+            i0.borrow(indices[0], count);
+            i1.borrow(indices[1], count);
+            i2.borrow(indices[2], count);
+            materialIndex.borrow(materials, count);
+            if (!edges) {
+                layout = TriangleLayout::Indexed;
+                updateEdges(0);
+                return;
+            }
+
+            layout = TriangleLayout::Precomputed;
+            const float* rows[9] = {edges->v0x, edges->v0y, edges->v0z, edges->e1x, edges->e1y,
+                                    edges->e1z, edges->e2x, edges->e2y, edges->e2z};
+            StorageArray<float>* arrays[9] = {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z};
+            for (int r = 0; r < 9; r++) {
+                arrays[r]->borrow(rows[r], count + kPadding);
+            }
+        }
+
+        // Padded edge arrays; only valid in the precomputed layout
+        TriangleArrays getEdges() const {
+            return TriangleArrays{v0x.data(), v0y.data(), v0z.data(), e1x.data(), e1y.data(),
+                                  e1z.data(), e2x.data(), e2y.data(), e2z.data()};
+        }
+
+        const Vector3* getVertices() const { return vertices.data(); }
+        const uint32_t* getIndices(int corner) const {
+            return corner == 0 ? i0.data() : (corner == 1 ? i1.data() : i2.data());
+        }
+        const uint32_t* getMaterialIndices() const { return materialIndex.data(); }
+
+        uint32_t size() const { return count; }
+        size_t getVertexCount() const { return vertices.size(); }
+        uint32_t getMaterialIndex(uint32_t i) const { return materialIndex[i]; }
+
+        // Geometric normal, wound by the triangle's vertex order
+        Vector3 getNormal(uint32_t i) const {
+            const Vector3& a = vertices[i0[i]];
+            return (vertices[i1[i]] - a).cross(vertices[i2[i]] - a).normalize();
+        }
+
+        AABB getBounds(uint32_t i) const {
+            AABB bounds;
+            bounds.expand(vertices[i0[i]]);
+            bounds.expand(vertices[i1[i]]);
+            bounds.expand(vertices[i2[i]]);
+            return bounds;
+        }
+    };
+
+    // Bundle of N coherent rays in SoA layout. Lanes that are not set stay
+    // out of activeMask and are ignored by every packet query.
+    template<int N>
+    struct RayPacket {
+        static_assert(N == 4 || N == 8 || N == 16, "packets hold 4, 8 or 16 rays");
+        static constexpr int kSize = N;
+
+        alignas(32) float ox[N];
+        alignas(32) float oy[N];
+        alignas(32) float oz[N];
+        alignas(32) float dx[N];
+        alignas(32) float dy[N];
+        alignas(32) float dz[N];
+        alignas(32) float invDx[N];
+        alignas(32) float invDy[N];
+        alignas(32) float invDz[N];
+        uint32_t activeMask;
+
+        RayPacket() { clear(); }
+
+        void clear() {
+            for (int i = 0; i < N; i++) {
+                ox[i] = oy[i] = oz[i] = 0.0f;
+                dx[i] = dy[i] = dz[i] = 0.0f;
+                invDx[i] = invDy[i] = invDz[i] = 0.0f;
+            }
+            activeMask = 0;
+        }
+
+        void setRay(int lane, const Ray& ray) {
+            ox[lane] = ray.origin.x;
+            oy[lane] = ray.origin.y;
+            oz[lane] = ray.origin.z;
+            dx[lane] = ray.direction.x;
+            dy[lane] = ray.direction.y;
+            dz[lane] = ray.direction.z;
+            invDx[lane] = 1.0f / ray.direction.x;
+            invDy[lane] = 1.0f / ray.direction.y;
+            invDz[lane] = 1.0f / ray.direction.z;
+            activeMask |= 1u << lane;
+        }
+
+        Ray getRay(int lane) const {
+            Ray ray;
+            ray.origin = Vector3(ox[lane], oy[lane], oz[lane]);
+            ray.direction = Vector3(dx[lane], dy[lane], dz[lane]);
+            return ray;
+        }
+
+        bool isActive(int lane) const { return (activeMask >> lane) & 1u; }
+    };
+
+    // Packet kernels work on groups of lanes: the portable versions loop over
+    // any lane count, the AVX2 versions handle exactly 8 lanes per call.
+    namespace PacketKernels {
+
+        struct LaneGroup {
+            const float* ox;
+            const float* oy;
+            const float* oz;
+            const float* dx;
+            const float* dy;
+            const float* dz;
+            const float* invDx;
+            const float* invDy;
+            const float* invDz;
+            float* tMax;
+            int32_t* slot;
+        };
+
+        inline uint32_t intersectBoxLanes(const AABB& box, const LaneGroup& g, int lanes,
+                                          uint32_t mask, float& tNear) {
+            uint32_t hitMask = 0;
+            tNear = std::numeric_limits<float>::max();
+            for (int i = 0; i < lanes; i++) {
+                float tx1 = (box.min.x - g.ox[i]) * g.invDx[i];
+                float tx2 = (box.max.x - g.ox[i]) * g.invDx[i];
+                float ty1 = (box.min.y - g.oy[i]) * g.invDy[i];
+                float ty2 = (box.max.y - g.oy[i]) * g.invDy[i];
+                float tz1 = (box.min.z - g.oz[i]) * g.invDz[i];
+                float tz2 = (box.max.z - g.oz[i]) * g.invDz[i];
+                float t0 = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::min(tz1, tz2));
+                float t1 = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::max(tz1, tz2));
+                bool hit = ((mask >> i) & 1u) && t1 >= std::max(t0, 0.0f) && t0 < g.tMax[i];
+                if (hit) {
+                    hitMask |= 1u << i;
+                    tNear = std::min(tNear, t0);
+                }
+            }
+            return hitMask;
+        }
+
+        // Same arithmetic as SphereKernels::intersectScalar, one sphere at a
+        // time against every lane in mask
+        inline void intersectSpheresLanes(const SphereArrays& s, uint32_t first, uint32_t count,
+                                          const LaneGroup& g, int lanes, uint32_t mask) {
+            for (uint32_t k = first; k < first + count; k++) {
+                for (int i = 0; i < lanes; i++) {
+                    if (!((mask >> i) & 1u)) continue;
+                    float ocx = g.ox[i] - s.cx[k];
+                    float ocy = g.oy[i] - s.cy[k];
+                    float ocz = g.oz[i] - s.cz[k];
+                    float b = ocx * g.dx[i] + ocy * g.dy[i] + ocz * g.dz[i];
+                    float c = ocx * ocx + ocy * ocy + ocz * ocz - s.radius2[k];
+                    float discriminant = b * b - c;
+                    if (discriminant < 0) continue;
+
+                    float sqrtD = std::sqrt(discriminant);
+                    float t = (-b - sqrtD > SphereKernels::kEpsilon) ? -b - sqrtD : -b + sqrtD;
+                    if (t > SphereKernels::kEpsilon && t < g.tMax[i]) {
+                        g.tMax[i] = t;
+                        g.slot[i] = (int32_t)k;
+                    }
+                }
+            }
+        }
+
+        // Same arithmetic as TriangleKernels::intersectScalar. Hits record
+        // slotBase + k as the lane's slot.
+        inline void intersectTrianglesLanes(const TriangleArrays& tr, uint32_t first, uint32_t count,
+                                            int32_t slotBase, const LaneGroup& g, int lanes, uint32_t mask) {
+            for (uint32_t k = first; k < first + count; k++) {
+                for (int i = 0; i < lanes; i++) {
+                    if (!((mask >> i) & 1u)) continue;
+                    float px = g.dy[i] * tr.e2z[k] - g.dz[i] * tr.e2y[k];
+                    float py = g.dz[i] * tr.e2x[k] - g.dx[i] * tr.e2z[k];
+                    float pz = g.dx[i] * tr.e2y[k] - g.dy[i] * tr.e2x[k];
+                    float det = tr.e1x[k] * px + tr.e1y[k] * py + tr.e1z[k] * pz;
+                    if (std::fabs(det) <= TriangleKernels::kDetEpsilon) continue;
+
+                    float invDet = 1.0f / det;
+                    float tx = g.ox[i] - tr.v0x[k];
+                    float ty = g.oy[i] - tr.v0y[k];
+                    float tz = g.oz[i] - tr.v0z[k];
+                    float u = (tx * px + ty * py + tz * pz) * invDet;
+                    if (u < 0.0f || u > 1.0f) continue;
+
+                    float qx = ty * tr.e1z[k] - tz * tr.e1y[k];
+                    float qy = tz * tr.e1x[k] - tx * tr.e1z[k];
+                    float qz = tx * tr.e1y[k] - ty * tr.e1x[k];
+                    float v = (g.dx[i] * qx + g.dy[i] * qy + g.dz[i] * qz) * invDet;
+                    if (v < 0.0f || u + v > 1.0f) continue;
+
+                    float t = (tr.e2x[k] * qx + tr.e2y[k] * qy + tr.e2z[k] * qz) * invDet;
+                    if (t > TriangleKernels::kEpsilon && t < g.tMax[i]) {
+                        g.tMax[i] = t;
+                        g.slot[i] = slotBase + (int32_t)k;
+                    }
+                }
+            }
+        }
+
+#if defined(RT_SIMD_X86)
+        RT_TARGET_AVX2
+        inline uint32_t intersectBox8(const AABB& box, const LaneGroup& g, uint32_t mask, float& tNear) {
+            __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.min.x), _mm256_load_ps(g.ox)), _mm256_load_ps(g.invDx));
+            __m256 tx2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.max.x), _mm256_load_ps(g.ox)), _mm256_load_ps(g.invDx));
+            __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.min.y), _mm256_load_ps(g.oy)), _mm256_load_ps(g.invDy));
+            __m256 ty2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.max.y), _mm256_load_ps(g.oy)), _mm256_load_ps(g.invDy));
+            __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.min.z), _mm256_load_ps(g.oz)), _mm256_load_ps(g.invDz));
+            __m256 tz2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.max.z), _mm256_load_ps(g.oz)), _mm256_load_ps(g.invDz));
+            __m256 t0 = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2)), _mm256_min_ps(tz1, tz2));
+            __m256 t1 = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2)), _mm256_max_ps(tz1, tz2));
+            __m256 hit = _mm256_and_ps(_mm256_cmp_ps(t1, _mm256_max_ps(t0, _mm256_setzero_ps()), _CMP_GE_OQ),
+                                       _mm256_cmp_ps(t0, _mm256_load_ps(g.tMax), _CMP_LT_OQ));
+            uint32_t hitMask = (uint32_t)_mm256_movemask_ps(hit) & mask;
+
+            tNear = std::numeric_limits<float>::max();
+            if (hitMask) {
+                alignas(32) float entry[8];
+                _mm256_store_ps(entry, t0);
+                for (int i = 0; i < 8; i++) {
+                    if ((hitMask >> i) & 1u) tNear = std::min(tNear, entry[i]);
+                }
+            }
+            return hitMask;
+        }
+
+        // Same arithmetic as SphereKernels::intersectAVX2, one sphere
+        // broadcast against 8 lanes
+        RT_TARGET_AVX2
+        inline void intersectSpheres8(const SphereArrays& s, uint32_t first, uint32_t count,
+                                      const LaneGroup& g, uint32_t mask) {
+            const __m256 ox = _mm256_load_ps(g.ox);
+            const __m256 oy = _mm256_load_ps(g.oy);
+            const __m256 oz = _mm256_load_ps(g.oz);
+            const __m256 dx = _mm256_load_ps(g.dx);
+            const __m256 dy = _mm256_load_ps(g.dy);
+            const __m256 dz = _mm256_load_ps(g.dz);
+            const __m256 eps = _mm256_set1_ps(SphereKernels::kEpsilon);
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            const __m256 active = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+                _mm256_and_si256(_mm256_set1_epi32((int)mask), laneBits), laneBits));
+
+            __m256 tMax = _mm256_load_ps(g.tMax);
+            __m256i slot = _mm256_loadu_si256((const __m256i*)g.slot);
+
+            for (uint32_t k = first; k < first + count; k++) {
+                __m256 ocx = _mm256_sub_ps(ox, _mm256_set1_ps(s.cx[k]));
+                __m256 ocy = _mm256_sub_ps(oy, _mm256_set1_ps(s.cy[k]));
+                __m256 ocz = _mm256_sub_ps(oz, _mm256_set1_ps(s.cz[k]));
+                __m256 b = _mm256_fmadd_ps(ocx, dx, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocz, dz)));
+                __m256 c = _mm256_fmadd_ps(ocx, ocx, _mm256_fmadd_ps(ocy, ocy,
+                    _mm256_fmsub_ps(ocz, ocz, _mm256_set1_ps(s.radius2[k]))));
+                __m256 discriminant = _mm256_fmsub_ps(b, b, c);
+                __m256 sqrtD = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+                __m256 negB = _mm256_sub_ps(zero, b);
+                __m256 t1 = _mm256_sub_ps(negB, sqrtD);
+                __m256 t2 = _mm256_add_ps(negB, sqrtD);
+                __m256 t = _mm256_blendv_ps(t2, t1, _mm256_cmp_ps(t1, eps, _CMP_GT_OQ));
+
+                __m256 hit = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ),
+                                           _mm256_cmp_ps(t, eps, _CMP_GT_OQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, tMax, _CMP_LT_OQ));
+                hit = _mm256_and_ps(hit, active);
+
+                tMax = _mm256_blendv_ps(tMax, t, hit);
+                slot = _mm256_castps_si256(_mm256_blendv_ps(
+                    _mm256_castsi256_ps(slot), _mm256_castsi256_ps(_mm256_set1_epi32((int)k)), hit));
+            }
+
+            _mm256_store_ps(g.tMax, tMax);
+            _mm256_storeu_si256((__m256i*)g.slot, slot);
+        }
+
+        // Same arithmetic as TriangleKernels::intersectAVX2, one triangle
+        // broadcast against 8 lanes
+        RT_TARGET_AVX2
+        inline void intersectTriangles8(const TriangleArrays& tr, uint32_t first, uint32_t count,
+                                        int32_t slotBase, const LaneGroup& g, uint32_t mask) {
+            const __m256 ox = _mm256_load_ps(g.ox);
+            const __m256 oy = _mm256_load_ps(g.oy);
+            const __m256 oz = _mm256_load_ps(g.oz);
+            const __m256 dx = _mm256_load_ps(g.dx);
+            const __m256 dy = _mm256_load_ps(g.dy);
+            const __m256 dz = _mm256_load_ps(g.dz);
+            const __m256 eps = _mm256_set1_ps(TriangleKernels::kEpsilon);
+            const __m256 detEps = _mm256_set1_ps(TriangleKernels::kDetEpsilon);
+            const __m256 signBit = _mm256_set1_ps(-0.0f);
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            const __m256 active = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+                _mm256_and_si256(_mm256_set1_epi32((int)mask), laneBits), laneBits));
+
+            __m256 tMax = _mm256_load_ps(g.tMax);
+            __m256i slot = _mm256_loadu_si256((const __m256i*)g.slot);
+
+            for (uint32_t k = first; k < first + count; k++) {
+                __m256 e1x = _mm256_set1_ps(tr.e1x[k]);
+                __m256 e1y = _mm256_set1_ps(tr.e1y[k]);
+                __m256 e1z = _mm256_set1_ps(tr.e1z[k]);
+                __m256 e2x = _mm256_set1_ps(tr.e2x[k]);
+                __m256 e2y = _mm256_set1_ps(tr.e2y[k]);
+                __m256 e2z = _mm256_set1_ps(tr.e2z[k]);
+
+                __m256 px = _mm256_fmsub_ps(dy, e2z, _mm256_mul_ps(dz, e2y));
+                __m256 py = _mm256_fmsub_ps(dz, e2x, _mm256_mul_ps(dx, e2z));
+                __m256 pz = _mm256_fmsub_ps(dx, e2y, _mm256_mul_ps(dy, e2x));
+                __m256 det = _mm256_fmadd_ps(e1x, px, _mm256_fmadd_ps(e1y, py, _mm256_mul_ps(e1z, pz)));
+                __m256 invDet = _mm256_div_ps(one, det);
+
+                __m256 tx = _mm256_sub_ps(ox, _mm256_set1_ps(tr.v0x[k]));
+                __m256 ty = _mm256_sub_ps(oy, _mm256_set1_ps(tr.v0y[k]));
+                __m256 tz = _mm256_sub_ps(oz, _mm256_set1_ps(tr.v0z[k]));
+                __m256 u = _mm256_mul_ps(_mm256_fmadd_ps(tx, px, _mm256_fmadd_ps(ty, py, _mm256_mul_ps(tz, pz))), invDet);
+
+                __m256 qx = _mm256_fmsub_ps(ty, e1z, _mm256_mul_ps(tz, e1y));
+                __m256 qy = _mm256_fmsub_ps(tz, e1x, _mm256_mul_ps(tx, e1z));
+                __m256 qz = _mm256_fmsub_ps(tx, e1y, _mm256_mul_ps(ty, e1x));
+                __m256 v = _mm256_mul_ps(_mm256_fmadd_ps(dx, qx, _mm256_fmadd_ps(dy, qy, _mm256_mul_ps(dz, qz))), invDet);
+                __m256 t = _mm256_mul_ps(_mm256_fmadd_ps(e2x, qx, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2z, qz))), invDet);
+
+                __m256 hit = _mm256_cmp_ps(_mm256_andnot_ps(signBit, det), detEps, _CMP_GT_OQ);
+                hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ),
+                                                       _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+                hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                                       _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+                hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(t, eps, _CMP_GT_OQ),
+                                                       _mm256_cmp_ps(t, tMax, _CMP_LT_OQ)));
+                hit = _mm256_and_ps(hit, active);
+
+                tMax = _mm256_blendv_ps(tMax, t, hit);
+                slot = _mm256_castps_si256(_mm256_blendv_ps(
+                    _mm256_castsi256_ps(slot), _mm256_castsi256_ps(_mm256_set1_epi32(slotBase + (int32_t)k)), hit));
+            }
+
+            _mm256_store_ps(g.tMax, tMax);
+            _mm256_storeu_si256((__m256i*)g.slot, slot);
+        }
+#endif
+
+    } // namespace PacketKernels
+
+    // Per-packet traversal state: closest t and primitive slot for every lane
+    template<int N>
+    class PacketQuery {
+    private:
+        const RayPacket<N>& packet;
+        bool wide;              // AVX2 groups of 8 lanes
+
+        PacketKernels::LaneGroup group(int firstLane) {
+            return PacketKernels::LaneGroup{
+                packet.ox + firstLane, packet.oy + firstLane, packet.oz + firstLane,
+                packet.dx + firstLane, packet.dy + firstLane, packet.dz + firstLane,
+                packet.invDx + firstLane, packet.invDy + firstLane, packet.invDz + firstLane,
+                tMax + firstLane, slot + firstLane};
+        }
+
+    public:
+        alignas(32) float tMax[N];
+        alignas(32) int32_t slot[N];
+
+        PacketQuery(const RayPacket<N>& p, SimdLevel level)
+            : packet(p), wide(N >= 8 && level == SimdLevel::AVX2) {
+            for (int i = 0; i < N; i++) {
+                tMax[i] = std::numeric_limits<float>::max();
+                slot[i] = -1;
+            }
+        }
+
+        uint32_t intersectBox(const AABB& box, uint32_t mask, float& tNear) {
+#if defined(RT_SIMD_X86)
+            if (wide) {
+                uint32_t hitMask = 0;
+                tNear = std::numeric_limits<float>::max();
+                for (int lane = 0; lane < N; lane += 8) {
+                    uint32_t groupMask = (mask >> lane) & 0xFFu;
+                    if (!groupMask) continue;
+                    float groupNear;
+                    hitMask |= PacketKernels::intersectBox8(box, group(lane), groupMask, groupNear) << lane;
+                    tNear = std::min(tNear, groupNear);
+                }
+                return hitMask;
+            }
+#endif
+            return PacketKernels::intersectBoxLanes(box, group(0), N, mask, tNear);
+        }
+
+        void intersectSpheres(const SphereArrays& spheres, uint32_t first, uint32_t count, uint32_t mask) {
+#if defined(RT_SIMD_X86)
+            if (wide) {
+                for (int lane = 0; lane < N; lane += 8) {
+                    uint32_t groupMask = (mask >> lane) & 0xFFu;
+                    if (groupMask) {
+                        PacketKernels::intersectSpheres8(spheres, first, count, group(lane), groupMask);
+                    }
+                }
+                return;
+            }
+#endif
+            PacketKernels::intersectSpheresLanes(spheres, first, count, group(0), N, mask);
+        }
+
+        void intersectTriangles(const TriangleArrays& triangles, uint32_t first, uint32_t count,
+                                int32_t slotBase, uint32_t mask) {
+#if defined(RT_SIMD_X86)
+            if (wide) {
+                for (int lane = 0; lane < N; lane += 8) {
+                    uint32_t groupMask = (mask >> lane) & 0xFFu;
+                    if (groupMask) {
+                        PacketKernels::intersectTriangles8(triangles, first, count, slotBase,
+                                                           group(lane), groupMask);
+                    }
+                }
+                return;
+            }
+#endif
+            PacketKernels::intersectTrianglesLanes(triangles, first, count, slotBase, group(0), N, mask);
+        }
+    };
+
+    // Scene containing all objects. Spheres and mesh triangles live in
+    // SIMD-friendly SoA stores that share one primitive BVH; any other Shape
+    // goes through the virtual path with its own BVH. Instances place shared
+    // finalized scenes under a transform and get a top-level BVH of their own.
+    //
+    // Primitive slots number spheres first and triangles after them, so slot
+    // s < getSphereCount() is a sphere and anything above is triangle
+    // s - getSphereCount().
+    class Scene {
+    private:
+        Memory::Arena arena;                    // Backs shapes made by emplaceShape()
+        std::vector<Shape*> shapes;
+        std::vector<std::unique_ptr<Shape>> heapShapes;     // Handed over by addShape()
+        SphereSoA spheres;
+        TriangleSoA triangles;
+        std::vector<Material> materials;
+        Vector3 backgroundColor;
+        std::vector<Light> lights;
+        BVH bvh;
+        BVH primitiveBvh;
+        bool finalized;
+        std::shared_ptr<const void> backing;    // Keeps borrowed arrays alive
+
+        struct Instance {
+            std::shared_ptr<const Scene> blas;
+            Transform objectToWorld;
+            Transform worldToObject;
+            uint32_t materialOverride;
+            AABB bounds;                        // World space
+            bool enabled;
+        };
+        std::vector<Instance> instances;
+        BVH instanceBvh;
+        std::vector<uint32_t> instancePositions;    // Instance -> instanceBvh leaf position
+
+        // Moves waiting for refit(), as leaf positions in their BVH
+        std::vector<uint32_t> movedPrimitives;
+        std::vector<uint32_t> movedInstances;
+        float rebuildThreshold;
+        bool deferBuilds;
+        bool buildPending;                      // Additions waiting for refit() to rebuild
+
+        friend class SceneFile;
+
+        // Additions to a finalized scene rebuild its BVHs, now or at the
+        // next refit() when builds are deferred
+        void structureChanged() {
+            if (!finalized) return;
+            if (deferBuilds) {
+                buildPending = true;
+            } else {
+                buildBVH();
+            }
+        }
+
+        void buildBVH() {
+            std::vector<AABB> bounds;
+            bounds.reserve(shapes.size());
+            for (const auto& shape : shapes) {
+                bounds.push_back(shape->getBounds());
+            }
+            bvh.build(bounds);
+            buildPrimitiveBVH();
+            buildInstanceBVH();
+        }
+
+        void buildPrimitiveBVH() {
+            movedPrimitives.clear();
+
+            // Leaves are sized for the kernel and both stores are sorted into
+            // leaf order, so every leaf is one contiguous SoA range of a
+            // single primitive kind.
+            uint32_t sphereCount = spheres.size();
+            std::vector<AABB> bounds;
+            bounds.reserve(sphereCount + triangles.size());
+            for (uint32_t i = 0; i < sphereCount; i++) {
+                bounds.push_back(spheres.getBounds(i));
+            }
+            for (uint32_t i = 0; i < triangles.size(); i++) {
+                bounds.push_back(triangles.getBounds(i));
+            }
+            uint32_t width = spheres.getKernelWidth();
+            primitiveBvh.build(bounds, {sphereCount, triangles.size()},
+                               BVHBuildOptions(std::max(4u, width), width));
+
+            const std::vector<uint32_t>& order = primitiveBvh.getPrimIndices();
+            spheres.permute(std::vector<uint32_t>(order.begin(), order.begin() + sphereCount));
+            std::vector<uint32_t> triangleOrder(order.begin() + sphereCount, order.end());
+            for (uint32_t& prim : triangleOrder) {
+                prim -= sphereCount;
+            }
+            triangles.permute(triangleOrder);
+        }
+
+        void buildInstanceBVH() {
+            movedInstances.clear();
+            std::vector<AABB> bounds;
+            bounds.reserve(instances.size());
+            for (const Instance& instance : instances) {
+                bounds.push_back(instance.bounds);
+            }
+            instanceBvh.build(bounds, BVHBuildOptions(1));
+
+            const std::vector<uint32_t>& order = instanceBvh.getPrimIndices();
+            instancePositions.resize(order.size());
+            for (uint32_t position = 0; position < order.size(); position++) {
+                instancePositions[order[position]] = position;
+            }
+        }
+
+        AABB primitiveLeafBounds(uint32_t first, uint32_t count) const {
+            uint32_t sphereCount = spheres.size();
+            AABB bounds;
+            for (uint32_t slot = first; slot < first + count; slot++) {
+                bounds.expand(slot < sphereCount ? spheres.getBounds(slot)
+                                                 : triangles.getBounds(slot - sphereCount));
+            }
+            return bounds;
+        }
+
+        AABB instanceLeafBounds(uint32_t first, uint32_t count) const {
+            const std::vector<uint32_t>& order = instanceBvh.getPrimIndices();
+            AABB bounds;
+            for (uint32_t position = first; position < first + count; position++) {
+                bounds.expand(instances[order[position]].bounds);
+            }
+            return bounds;
+        }
+
+        void updateInstanceBounds(Instance& instance) {
+            AABB local = instance.blas->getBounds();
+            // Disabled instances shrink to a point so the BVH stops
+            // reaching for them
+            if (!local.valid() || !instance.enabled) {
+                Vector3 origin = instance.objectToWorld.transformPoint(Vector3());
+                local = AABB(origin, origin);
+                instance.bounds = local;
+                return;
+            }
+            instance.bounds = instance.objectToWorld.transformBounds(local);
+        }
+
+        // Object-space copy of ray with a unit direction. Distances along it
+        // are scale times the world-space distances.
+        static Ray toObjectSpace(const Instance& instance, const Ray& ray, float& scale) {
+            Ray local;
+            local.origin = instance.worldToObject.transformPoint(ray.origin);
+            Vector3 direction = instance.worldToObject.transformVector(ray.direction);
+            scale = direction.length();
+            local.direction = direction * (1.0f / scale);
+            return local;
+        }
+
+        // Replaces hitInfo if an instance is hit nearer than closestT
+        void traceInstances(const Ray& ray, float& closestT, HitInfo& hitInfo) const {
+            auto visit = [&](uint32_t index, float& tMax) {
+                const Instance& instance = instances[index];
+                if (!instance.enabled) return;
+                float scale;
+                Ray local = toObjectSpace(instance, ray, scale);
+                HitInfo hit = instance.blas->traceRay(local, tMax * scale);
+                if (!hit.hit) return;
+
+                float t = hit.t / scale;
+                if (t >= tMax) return;
+                tMax = t;
+                hitInfo.t = t;
+                hitInfo.point = ray.origin + ray.direction * t;
+                hitInfo.normal = instance.worldToObject.transformTransposed(hit.normal).normalize();
+                hitInfo.materialId = instance.materialOverride != kNoMaterialOverride
+                                         ? instance.materialOverride : hit.materialId;
+                hitInfo.sphereId = HitInfo::kNoSphere;
+                hitInfo.hit = true;
+            };
+
+            if (finalized) {
+                instanceBvh.traverse(ray, closestT, visit);
+            } else {
+                for (uint32_t i = 0; i < instances.size(); i++) {
+                    visit(i, closestT);
+                }
+            }
+        }
+
+        bool instanceOccludes(uint32_t index, const Ray& ray, float tMax) const {
+            const Instance& instance = instances[index];
+            if (!instance.enabled) return false;
+            float scale;
+            Ray local = toObjectSpace(instance, ray, scale);
+            return instance.blas->occluded(local, tMax * scale);
+        }
+
+        // Closest primitive slot in one BVH leaf nearer than tMax, or -1
+        int intersectLeaf(uint32_t first, uint32_t count, const Ray& ray, float& tMax) const {
+            uint32_t sphereCount = spheres.size();
+            if (first < sphereCount) {
+                return spheres.intersect(first, count, ray, tMax);
+            }
+            int slot = triangles.intersect(first - sphereCount, count, ray, tMax);
+            return slot >= 0 ? (int)sphereCount + slot : -1;
+        }
+
+        // Returns the index of the closest shape nearer than closestT, or -1
+        int traceShapes(const Ray& ray, float& closestT) const {
+            int closest = -1;
+            if (!finalized) {
+                for (size_t i = 0; i < shapes.size(); i++) {
+                    float t;
+                    if (shapes[i]->intersect(ray, closestT, t)) {
+                        closestT = t;
+                        closest = (int)i;
+                    }
+                }
+                return closest;
+            }
+
+            bvh.traverse(ray, closestT, [&](uint32_t prim, float& tMax) {
+                float t;
+                if (shapes[prim]->intersect(ray, tMax, t)) {
+                    tMax = t;
+                    closest = (int)prim;
+                }
+            });
+            return closest;
+        }
+
+        // Fills point, normal and material for the winning primitive only.
+        // Triangles are two-sided: their normal is flipped towards the ray.
+        void resolveHit(const Ray& ray, float t, int primitiveSlot, int shapeIndex, HitInfo& hitInfo) const {
+            if (primitiveSlot < 0 && shapeIndex < 0) return;
+
+            hitInfo.t = t;
+            hitInfo.point = ray.origin + ray.direction * t;
+            hitInfo.sphereId = HitInfo::kNoSphere;
+            uint32_t sphereCount = spheres.size();
+            if (shapeIndex >= 0) {
+                const Shape& shape = *shapes[shapeIndex];
+                hitInfo.normal = shape.getNormal(hitInfo.point);
+                hitInfo.materialId = shape.materialId;
+            } else if ((uint32_t)primitiveSlot < sphereCount) {
+                hitInfo.normal = (hitInfo.point - spheres.getCenter(primitiveSlot)).normalize();
+                hitInfo.materialId = spheres.getMaterialIndex(primitiveSlot);
+                hitInfo.sphereId = spheres.getId(primitiveSlot);
+            } else {
+                uint32_t triangle = primitiveSlot - sphereCount;
+                Vector3 normal = triangles.getNormal(triangle);
+                hitInfo.normal = normal.dot(ray.direction) > 0.0f ? normal * -1.0f : normal;
+                hitInfo.materialId = triangles.getMaterialIndex(triangle);
+            }
+            hitInfo.hit = true;
+        }
+
+    public:
+        static constexpr uint32_t kNoMaterialOverride = std::numeric_limits<uint32_t>::max();
+
+        // Material 0 is always the default material. Scenes start lit by a
+        // white directional light from (1, 1, 1); call clearLights() to drop it.
+        Scene(const Vector3& bgColor = Vector3(0.1f, 0.1f, 0.15f))
+            : backgroundColor(bgColor), finalized(false), rebuildThreshold(1.5f), deferBuilds(false),
+              buildPending(false) {
+            materials.push_back(Material());
+            lights.push_back(Light::directional(Vector3(1, 1, 1)));
+        }
+
+        void addLight(const Light& light) {
+            lights.push_back(light);
+        }
+
+        void clearLights() {
+            lights.clear();
+        }
+
+        const std::vector<Light>& getLights() const {
+            return lights;
+        }
+
+        uint32_t addMaterial(const Material& material) {
+            materials.push_back(material);
+            return (uint32_t)(materials.size() - 1);
+        }
+
+        const Material& getMaterial(uint32_t materialId) const {
+            return materials[materialId];
+        }
+
+        size_t getMaterialCount() const {
+            return materials.size();
+        }
+
+        // Shapes added after finalize() trigger a rebuild, so bulk loads
+        // should add everything first and finalize once. Spheres are
+        // unpacked into the SoA store.
+        void addShape(std::unique_ptr<Shape> shape) {
+            if (const Sphere* sphere = dynamic_cast<const Sphere*>(shape.get())) {
+                addSphere(sphere->getCenter(), sphere->getRadius(), sphere->materialId);
+                return;
+            }
+            shapes.push_back(shape.get());
+            heapShapes.push_back(std::move(shape));
+            structureChanged();
+        }
+
+        // Constructs a shape in the scene's arena, next to the other shapes
+        // made this way. It lives, like the scene's other objects, until the
+        // scene is destroyed or replaced, which frees the arena in bulk.
+        template<typename T, typename... Args>
+        T* emplaceShape(Args&&... args) {
+            static_assert(std::is_base_of<Shape, T>::value, "emplaceShape needs a Shape");
+            static_assert(!std::is_same<T, Sphere>::value, "spheres belong in addSphere()");
+            T* shape = arena.create<T>(std::forward<Args>(args)...);
+            shapes.push_back(shape);
+            structureChanged();
+            return shape;
+        }
+
+        // Returns the sphere's id for updateSphere()
+        uint32_t addSphere(const Vector3& center, float radius, uint32_t materialId = 0) {
+            uint32_t id = spheres.add(center, radius, materialId);
+            structureChanged();
+            return id;
+        }
+
+        // Moves a sphere; radius 0 hides it. On a finalized scene the BVH
+        // catches up at the next refit(), which must run before tracing again.
+        void updateSphere(uint32_t id, const Vector3& center, float radius) {
+            uint32_t slot = spheres.getSlot(id);
+            spheres.update(slot, center, radius);
+            if (finalized) {
+                movedPrimitives.push_back(slot);
+            }
+        }
+
+        Vector3 getSphereCenter(uint32_t id) const { return spheres.getCenter(spheres.getSlot(id)); }
+        float getSphereRadius(uint32_t id) const { return spheres.getRadius(spheres.getSlot(id)); }
+        uint32_t getSphereMaterial(uint32_t id) const { return spheres.getMaterialIndex(spheres.getSlot(id)); }
+
+        // Takes effect immediately; the BVH doesn't depend on materials
+        void setSphereMaterial(uint32_t id, uint32_t materialId) {
+            spheres.setMaterialIndex(spheres.getSlot(id), materialId);
+        }
+
+        void reserveSpheres(size_t count) {
+            spheres.reserve(count);
+        }
+
+        // Copies the mesh's triangles into the scene's triangle store and
+        // returns the index of its first triangle
+        uint32_t addMesh(const TriangleMesh& mesh) {
+            uint32_t first = triangles.size();
+            triangles.add(mesh);
+            structureChanged();
+            return first;
+        }
+
+        // Places a finalized scene in this one. Hits inside it report the
+        // blas's material ids, looked up in this scene's material table,
+        // unless materialOverride is set. Returns the instance index.
+        uint32_t addInstance(std::shared_ptr<const Scene> blas, const Transform& objectToWorld,
+                             uint32_t materialOverride = kNoMaterialOverride) {
+            Instance instance{std::move(blas), objectToWorld, objectToWorld.inverse(), materialOverride, AABB(), true};
+            updateInstanceBounds(instance);
+            instances.push_back(std::move(instance));
+            structureChanged();
+            return (uint32_t)(instances.size() - 1);
+        }
+
+        // Like updateSphere(), takes effect in the BVH at the next refit()
+        void setInstanceTransform(uint32_t index, const Transform& objectToWorld) {
+            Instance& instance = instances[index];
+            instance.objectToWorld = objectToWorld;
+            instance.worldToObject = objectToWorld.inverse();
+            updateInstanceBounds(instance);
+            // A pending rebuild covers instances added since the last build
+            if (finalized && !buildPending) {
+                movedInstances.push_back(instancePositions[index]);
+            }
+        }
+
+        // Hides or shows an instance without removing it, so indices stay
+        // stable; takes effect in the BVH at the next refit()
+        void setInstanceEnabled(uint32_t index, bool enabled) {
+            Instance& instance = instances[index];
+            if (instance.enabled == enabled) return;
+            instance.enabled = enabled;
+            updateInstanceBounds(instance);
+            if (finalized && !buildPending) {
+                movedInstances.push_back(instancePositions[index]);
+            }
+        }
+
+        bool isInstanceEnabled(uint32_t index) const {
+            return instances[index].enabled;
+        }
+
+        // kNoMaterialOverride goes back to the blas's own materials
+        void setInstanceMaterialOverride(uint32_t index, uint32_t materialOverride) {
+            instances[index].materialOverride = materialOverride;
+        }
+
+        uint32_t getInstanceMaterialOverride(uint32_t index) const {
+            return instances[index].materialOverride;
+        }
+
+        const Transform& getInstanceTransform(uint32_t index) const {
+            return instances[index].objectToWorld;
+        }
+
+        size_t getInstanceCount() const {
+            return instances.size();
+        }
+
+        // World-space bounds of everything in the scene, instances included
+        AABB getBounds() const {
+            AABB bounds;
+            if (finalized) {
+                for (const BVH* tree : {&primitiveBvh, &bvh, &instanceBvh}) {
+                    if (!tree->empty()) bounds.expand(tree->getNodes()[0].bounds);
+                }
+                return bounds;
+            }
+            for (uint32_t i = 0; i < spheres.size(); i++) bounds.expand(spheres.getBounds(i));
+            for (uint32_t i = 0; i < triangles.size(); i++) bounds.expand(triangles.getBounds(i));
+            for (const auto& shape : shapes) bounds.expand(shape->getBounds());
+            for (const Instance& instance : instances) bounds.expand(instance.bounds);
+            return bounds;
+        }
+
+        // Indexed keeps only vertices and indices; Precomputed (the default)
+        // also stores per-triangle edges for faster intersection
+        void setTriangleLayout(TriangleLayout layout) {
+            triangles.setLayout(layout);
+        }
+
+        TriangleLayout getTriangleLayout() const { return triangles.getLayout(); }
+
+        // Builds the acceleration structures used by traceRay
+        void finalize() {
+            PROFILE_SCOPE_CATEGORY("Scene::finalize", "raytracing");
+            buildBVH();
+            finalized = true;
+            buildPending = false;
+        }
+
+        struct RefitStats {
+            uint32_t movedPrimitives = 0;
+            uint32_t movedInstances = 0;
+            uint32_t refitNodes = 0;            // Nodes whose bounds were recomputed
+            bool rebuiltPrimitives = false;
+            bool rebuiltInstances = false;
+            float primitiveQuality = 1.0f;      // BVH::getQualityRatio() after the refit
+            float instanceQuality = 1.0f;
+        };
+
+        // Brings the BVHs in line with the spheres and instances moved since
+        // the last call by refitting the bounds above them. A tree whose SAH
+        // cost has grown past the rebuild threshold is rebuilt instead.
+        RefitStats refit() {
+            PROFILE_SCOPE_CATEGORY("Scene::refit", "raytracing");
+            RefitStats stats;
+            if (!finalized) return stats;
+
+            if (buildPending) {
+                stats.movedPrimitives = (uint32_t)movedPrimitives.size();
+                stats.movedInstances = (uint32_t)movedInstances.size();
+                buildBVH();
+                buildPending = false;
+                stats.rebuiltPrimitives = stats.rebuiltInstances = true;
+                stats.primitiveQuality = primitiveBvh.getQualityRatio();
+                stats.instanceQuality = instanceBvh.getQualityRatio();
+                return stats;
+            }
+
+            stats.movedPrimitives = (uint32_t)movedPrimitives.size();
+            if (!movedPrimitives.empty()) {
+                stats.refitNodes += primitiveBvh.refit(movedPrimitives, [&](uint32_t first, uint32_t count) {
+                    return primitiveLeafBounds(first, count);
+                });
+                movedPrimitives.clear();
+                if (primitiveBvh.getQualityRatio() > rebuildThreshold) {
+                    buildPrimitiveBVH();
+                    stats.rebuiltPrimitives = true;
+                }
+            }
+
+            stats.movedInstances = (uint32_t)movedInstances.size();
+            if (!movedInstances.empty()) {
+                stats.refitNodes += instanceBvh.refit(movedInstances, [&](uint32_t first, uint32_t count) {
+                    return instanceLeafBounds(first, count);
+                });
+                movedInstances.clear();
+                if (instanceBvh.getQualityRatio() > rebuildThreshold) {
+                    buildInstanceBVH();
+                    stats.rebuiltInstances = true;
+                }
+            }
+
+            stats.primitiveQuality = primitiveBvh.getQualityRatio();
+            stats.instanceQuality = instanceBvh.getQualityRatio();
+            return stats;
+        }
+
+        // While on, adding to a finalized scene only marks it and the next
+        // refit() rebuilds once, so a batch of additions costs one build.
+        // As with moves, refit() must run before tracing again.
+        void setDeferredBuilds(bool deferred) { deferBuilds = deferred; }
+
+        // SAH cost ratio past which refit() rebuilds a tree; 1.5 by default
+        void setRebuildThreshold(float ratio) { rebuildThreshold = ratio; }
+        float getRebuildThreshold() const { return rebuildThreshold; }
+
+        // Forces a kernel ISA (e.g. for benchmarking) and returns the one in
+        // use. A finalized scene is rebuilt only if the ISA actually changes.
+        SimdLevel setSimdLevel(SimdLevel level) {
+            SimdLevel previous = spheres.getSimdLevel();
+            SimdLevel used = spheres.setSimdLevel(level);
+            triangles.setSimdLevel(level);
+            if (finalized && used != previous) {
+                buildBVH();
+            }
+            return used;
+        }
+
+        SimdLevel getSimdLevel() const { return spheres.getSimdLevel(); }
+        bool isFinalized() const { return finalized; }
+        const BVH& getBVH() const { return bvh; }
+        const BVH& getPrimitiveBVH() const { return primitiveBvh; }
+        const BVH& getInstanceBVH() const { return instanceBvh; }
+
+        HitInfo traceRay(const Ray& ray) const {
+            return traceRay(ray, std::numeric_limits<float>::max());
+        }
+
+        // Closest hit nearer than tMax
+        HitInfo traceRay(const Ray& ray, float tMax) const {
+            HitInfo closestHit;
+            float closestT = tMax;
+
+            int closestSlot = -1;
+            if (finalized) {
+                primitiveBvh.traverseLeaves(ray, closestT, [&](uint32_t first, uint32_t count, float& tMax) {
+                    int slot = intersectLeaf(first, count, ray, tMax);
+                    if (slot >= 0) {
+                        closestSlot = slot;
+                    }
+                });
+            } else {
+                closestSlot = spheres.intersect(0, spheres.size(), ray, closestT);
+                int triangle = triangles.intersect(0, triangles.size(), ray, closestT);
+                if (triangle >= 0) {
+                    closestSlot = (int)spheres.size() + triangle;
+                }
+            }
+
+            int closestShape = traceShapes(ray, closestT);
+            resolveHit(ray, closestT, closestSlot, closestShape, closestHit);
+            if (!instances.empty()) {
+                traceInstances(ray, closestT, closestHit);
+            }
+            return closestHit;
+        }
+
+        // True if anything blocks the ray before tMax. Stops at the first
+        // blocker instead of searching for the closest one.
+        bool occluded(const Ray& ray, float tMax) const {
+            if (!finalized) {
+                float t = tMax;
+                if (spheres.intersect(0, spheres.size(), ray, t) >= 0) return true;
+                if (triangles.intersect(0, triangles.size(), ray, t) >= 0) return true;
+                for (const auto& shape : shapes) {
+                    if (shape->intersect(ray, tMax, t)) return true;
+                }
+                for (uint32_t i = 0; i < instances.size(); i++) {
+                    if (instanceOccludes(i, ray, tMax)) return true;
+                }
+                return false;
+            }
+
+            bool blocked = primitiveBvh.traverseAny(ray, tMax, [&](uint32_t first, uint32_t count) {
+                float t = tMax;
+                return intersectLeaf(first, count, ray, t) >= 0;
+            });
+            if (blocked) return true;
+
+            const std::vector<uint32_t>& primIndices = bvh.getPrimIndices();
+            blocked = bvh.traverseAny(ray, tMax, [&](uint32_t first, uint32_t count) {
+                float t;
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (shapes[primIndices[i]]->intersect(ray, tMax, t)) return true;
+                }
+                return false;
+            });
+            if (blocked) return true;
+
+            const std::vector<uint32_t>& instanceIndices = instanceBvh.getPrimIndices();
+            return instanceBvh.traverseAny(ray, tMax, [&](uint32_t first, uint32_t count) {
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (instanceOccludes(instanceIndices[i], ray, tMax)) return true;
+                }
+                return false;
+            });
+        }
+
+        // Closest hit for every active lane of a coherent packet. Spheres and
+        // triangles are traced as a packet; other shapes and instances fall
+        // back to one ray per lane. Inactive lanes of hits are left untouched.
+        template<int N>
+        void tracePacket(const RayPacket<N>& packet, HitInfo* hits) const {
+            PacketQuery<N> query(packet, spheres.getSimdLevel());
+            SphereArrays arrays = spheres.getArrays();
+            uint32_t sphereCount = spheres.size();
+            auto visitTriangles = [&](uint32_t first, uint32_t count, uint32_t mask) {
+                triangles.forEachBlock(first, count, [&](const TriangleArrays& block, uint32_t blockFirst,
+                                                         uint32_t blockCount, uint32_t slotBase) {
+                    query.intersectTriangles(block, blockFirst, blockCount,
+                                             (int32_t)(sphereCount + slotBase), mask);
+                });
+            };
+            auto visitLeaf = [&](uint32_t first, uint32_t count, uint32_t mask) {
+                if (first < sphereCount) {
+                    query.intersectSpheres(arrays, first, count, mask);
+                } else {
+                    visitTriangles(first - sphereCount, count, mask);
+                }
+            };
+
+            if (finalized) {
+                primitiveBvh.traversePacket(query, packet.activeMask, visitLeaf);
+            } else {
+                if (sphereCount > 0) visitLeaf(0, sphereCount, packet.activeMask);
+                if (triangles.size() > 0) visitTriangles(0, triangles.size(), packet.activeMask);
+            }
+
+            for (int lane = 0; lane < N; lane++) {
+                if (!packet.isActive(lane)) continue;
+
+                hits[lane] = HitInfo();
+                Ray ray = packet.getRay(lane);
+                float t = query.tMax[lane];
+                int shape = shapes.empty() ? -1 : traceShapes(ray, t);
+                resolveHit(ray, t, query.slot[lane], shape, hits[lane]);
+                if (!instances.empty()) {
+                    traceInstances(ray, t, hits[lane]);
+                }
+            }
+        }
+
+        Vector3 getBackgroundColor() const {
+            return backgroundColor;
+        }
+
+        size_t getShapeCount() const {
+            return shapes.size() + spheres.size();
+        }
+
+        size_t getSphereCount() const {
+            return spheres.size();
+        }
+
+        size_t getTriangleCount() const {
+            return triangles.size();
+        }
+    };
+
+    // Camera for rendering
+    class Camera {
+    private:
+        Vector3 position;
+        Vector3 target;
+        Vector3 up;
+        float fov;
+        int width, height;
+
+        // Cached camera frame, rebuilt whenever the view parameters change
+        Vector3 forward;
+        Vector3 right;
+        Vector3 upVec;
+        float aspectScale;      // aspect * tan(fov / 2)
+        float scale;            // tan(fov / 2)
+        float invWidth;
+        float invHeight;
+
+        void updateFrame() {
+            float aspect = (float)width / height;
+            scale = std::tan(fov * 0.5f * M_PI / 180.0f);
+            aspectScale = aspect * scale;
+            invWidth = 1.0f / width;
+            invHeight = 1.0f / height;
+
+            forward = (target - position).normalize();
+            right = forward.cross(up).normalize();
+            upVec = right.cross(forward).normalize();
+        }
+
+        Vector3 directionFor(float px, float py) const {
+            return (forward + right * px + upVec * py).normalize();
+        }
+
+    public:
+        Camera(const Vector3& pos, const Vector3& tgt, const Vector3& u,
+               float fieldOfView, int w, int h)
+            : position(pos), target(tgt), up(u), fov(fieldOfView), width(w), height(h) {
+            updateFrame();
+        }
+
+        Ray generateRay(int x, int y) const {
+            return generateRay(x, y, 0.5f, 0.5f);
+        }
+
+        // Ray through the sub-pixel offset (jitterX, jitterY) in [0, 1)
+        Ray generateRay(int x, int y, float jitterX, float jitterY) const {
+            float px = (2.0f * (x + jitterX) * invWidth - 1.0f) * aspectScale;
+            float py = (1.0f - 2.0f * (y + jitterY) * invHeight) * scale;
+            return Ray(position, directionFor(px, py), unitDirection);
+        }
+
+        // Fills primary rays for rows [rowStart, rowEnd) in scanline order;
+        // out must hold (rowEnd - rowStart) * width rays.
+        void generateRays(int rowStart, int rowEnd, Ray* out) const {
+            for (int y = rowStart; y < rowEnd; y++) {
+                float py = (1.0f - 2.0f * (y + 0.5f) * invHeight) * scale;
+                Vector3 rowDir = forward + upVec * py;
+                for (int x = 0; x < width; x++) {
+                    float px = (2.0f * (x + 0.5f) * invWidth - 1.0f) * aspectScale;
+                    out->origin = position;
+                    out->direction = (rowDir + right * px).normalize();
+                    out++;
+                }
+            }
+        }
+
+        void setPosition(const Vector3& pos) { position = pos; updateFrame(); }
+        void setTarget(const Vector3& tgt) { target = tgt; updateFrame(); }
+        void setUp(const Vector3& u) { up = u; updateFrame(); }
+        void setFieldOfView(float fieldOfView) { fov = fieldOfView; updateFrame(); }
+
+        void lookAt(const Vector3& pos, const Vector3& tgt, const Vector3& u) {
+            position = pos;
+            target = tgt;
+            up = u;
+            updateFrame();
+        }
+
+        const Vector3& getPosition() const { return position; }
+        const Vector3& getTarget() const { return target; }
+        const Vector3& getUp() const { return up; }
+        float getFieldOfView() const { return fov; }
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+    };
+
+    // Pixel layouts a Framebuffer can hold
+    enum class PixelFormat {
+        RGB8,       // 3 bytes, unorm
+        RGBA8,      // 4 bytes, unorm, alpha = 255
+        RGBA16F,    // 8 bytes, IEEE half floats, alpha = 1
+        RGB32F      // 12 bytes, floats
+    };
+
+    inline size_t bytesPerPixel(PixelFormat format) {
+        switch (format) {
+            case PixelFormat::RGB8: return 3;
+            case PixelFormat::RGBA8: return 4;
+            case PixelFormat::RGBA16F: return 8;
+            default: return 12;
+        }
+    }
+
+    inline int channelCount(PixelFormat format) {
+        return (format == PixelFormat::RGBA8 || format == PixelFormat::RGBA16F) ? 4 : 3;
+    }
+
+    // Transfer function applied when quantizing to 8-bit formats; float
+    // formats always stay linear
+    enum class ColorEncoding {
+        Linear,
+        SRGB,
+        Gamma       // Pure power curve, 1 / Framebuffer gamma
+    };
+
+    // Float to packed pixel conversion. Quantization runs 16 values per step
+    // on SSE2/NEON; encoded output goes through a 4096-entry lookup table.
+    namespace PixelConversion {
+
+        constexpr int kEncodeTableBits = 12;
+        constexpr int kEncodeTableSize = 1 << kEncodeTableBits;
+
+        inline float encodeSRGB(float linear) {
+            return linear <= 0.0031308f ? 12.92f * linear
+                                        : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+        }
+
+        inline std::vector<uint8_t> buildEncodeTable(ColorEncoding encoding, float gamma) {
+            std::vector<uint8_t> table(kEncodeTableSize);
+            for (int i = 0; i < kEncodeTableSize; i++) {
+                float linear = (float)i / (kEncodeTableSize - 1);
+                float encoded = encoding == ColorEncoding::SRGB ? encodeSRGB(linear)
+                              : encoding == ColorEncoding::Gamma ? std::pow(linear, 1.0f / gamma)
+                              : linear;
+                table[i] = (uint8_t)(encoded * 255.0f + 0.5f);
+            }
+            return table;
+        }
+
+        // dst[i] = round(clamp(src[i], 0, 1) * scale), for scale <= 65535
+        inline void quantize(const float* src, size_t count, float scale, int32_t* dst) {
+            size_t i = 0;
+#if defined(RT_SIMD_X86)
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 vscale = _mm_set1_ps(scale);
+            const __m128 half = _mm_set1_ps(0.5f);
+            for (; i + 4 <= count; i += 4) {
+                __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zero), one);
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, vscale), half)));
+            }
+#elif defined(RT_SIMD_NEON)
+            const float32x4_t zero = vdupq_n_f32(0.0f);
+            const float32x4_t one = vdupq_n_f32(1.0f);
+            const float32x4_t half = vdupq_n_f32(0.5f);
+            for (; i + 4 <= count; i += 4) {
+                float32x4_t v = vminq_f32(vmaxq_f32(vld1q_f32(src + i), zero), one);
+                vst1q_s32(dst + i, vcvtq_s32_f32(vmlaq_n_f32(half, v, scale)));
+            }
+#endif
+            for (; i < count; i++) {
+                float v = std::min(std::max(src[i], 0.0f), 1.0f);
+                dst[i] = (int32_t)(v * scale + 0.5f);
+            }
+        }
+
+        // Linear unorm8 without a lookup, packed 16 values at a time
+        inline void toUnorm8(const float* src, size_t count, uint8_t* dst) {
+            size_t i = 0;
+#if defined(RT_SIMD_X86)
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 scale = _mm_set1_ps(255.0f);
+            const __m128 half = _mm_set1_ps(0.5f);
+            for (; i + 16 <= count; i += 16) {
+                __m128i q[4];
+                for (int k = 0; k < 4; k++) {
+                    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4 * k), zero), one);
+                    q[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+                }
+                __m128i lo = _mm_packs_epi32(q[0], q[1]);
+                __m128i hi = _mm_packs_epi32(q[2], q[3]);
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+            }
+#elif defined(RT_SIMD_NEON)
+            const float32x4_t zero = vdupq_n_f32(0.0f);
+            const float32x4_t one = vdupq_n_f32(1.0f);
+            const float32x4_t half = vdupq_n_f32(0.5f);
+            for (; i + 16 <= count; i += 16) {
+                uint16x4_t q[4];
+                for (int k = 0; k < 4; k++) {
+                    float32x4_t v = vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4 * k), zero), one);
+                    q[k] = vmovn_u32(vcvtq_u32_f32(vmlaq_n_f32(half, v, 255.0f)));
+                }
+                uint8x8_t lo = vmovn_u16(vcombine_u16(q[0], q[1]));
+                uint8x8_t hi = vmovn_u16(vcombine_u16(q[2], q[3]));
+                vst1q_u8(dst + i, vcombine_u8(lo, hi));
+            }
+#endif
+            for (; i < count; i++) {
+                float v = std::min(std::max(src[i], 0.0f), 1.0f);
+                dst[i] = (uint8_t)(v * 255.0f + 0.5f);
+            }
+        }
+
+        // Encoded unorm8: vectorized index computation, then table lookups
+        inline void toEncodedUnorm8(const float* src, size_t count, const uint8_t* table, uint8_t* dst) {
+            int32_t indices[64];
+            for (size_t i = 0; i < count; i += 64) {
+                size_t n = std::min<size_t>(64, count - i);
+                quantize(src + i, n, (float)(kEncodeTableSize - 1), indices);
+                for (size_t k = 0; k < n; k++) {
+                    dst[i + k] = table[indices[k]];
+                }
+            }
+        }
+
+        // Round-to-nearest-even float to half, matching F16C bit for bit
+        inline uint16_t floatToHalf(float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            uint32_t sign = (bits >> 16) & 0x8000u;
+            uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+            if (magnitude >= 0x7F800000u) {
+                // Inf stays Inf, NaN stays a quiet NaN
+                return (uint16_t)(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u));
+            }
+            if (magnitude >= 0x477FF000u) {
+                return (uint16_t)(sign | 0x7C00u);
+            }
+            if (magnitude < 0x38800000u) {
+                // Half denormal: shift the mantissa down and round to even
+                int exponent = (int)(magnitude >> 23);
+                if (exponent < 102) return (uint16_t)sign;
+                uint32_t mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+                uint32_t shift = (uint32_t)(126 - exponent);
+                uint32_t half = mantissa >> shift;
+                uint32_t remainder = mantissa & ((1u << shift) - 1u);
+                uint32_t halfway = 1u << (shift - 1u);
+                if (remainder > halfway || (remainder == halfway && (half & 1u))) half++;
+                return (uint16_t)(sign | half);
+            }
+
+            uint32_t rounded = magnitude + 0xFFFu + ((magnitude >> 13) & 1u);
+            return (uint16_t)(sign | ((rounded - 0x38000000u) >> 13));
+        }
+
+#if defined(RT_SIMD_X86)
+#if defined(__GNUC__) || defined(__clang__)
+        __attribute__((target("f16c")))
+#endif
+        inline void toHalfF16C(const float* src, size_t count, uint16_t* dst) {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                _mm_storel_epi64((__m128i*)(dst + i),
+                                 _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+            }
+            for (; i < count; i++) {
+                dst[i] = floatToHalf(src[i]);
+            }
+        }
+#endif
+
+        // Every AVX2 CPU also has F16C
+        inline void toHalf(const float* src, size_t count, uint16_t* dst) {
+#if defined(RT_SIMD_X86)
+            if (detectSimdLevel() == SimdLevel::AVX2) {
+                toHalfF16C(src, count, dst);
+                return;
+            }
+#endif
+            for (size_t i = 0; i < count; i++) {
+                dst[i] = floatToHalf(src[i]);
+            }
+        }
+
+    } // namespace PixelConversion
+
+    // A finished block of pixels handed to a framebuffer sink; data points at
+    // the top-left pixel and rows are rowStride bytes apart
+    struct FramebufferRegion {
+        int x, y;
+        int width, height;
+        const uint8_t* data;
+        size_t rowStride;
+        PixelFormat format;
+    };
+
+    using FramebufferSink = std::function<void(const FramebufferRegion&)>;
+
+    // How finished pixels are streamed to the sink
+    enum class StreamMode {
+        Tiles,      // Each tile as soon as it is done, in completion order
+        Rows        // Full-width bands of rows, strictly top to bottom
+    };
+
+    // Packed framebuffer. Renders into it are quantized tile by tile. With a
+    // sink attached, finished tiles or row bands are streamed out as they
+    // complete, and the full frame only has to be kept when retainFrame is set.
+    // Sink calls are serialized but may come from any render worker.
+    class Framebuffer {
+    private:
+        int width, height;
+        PixelFormat format;
+        ColorEncoding encoding;
+        float gamma;
+        std::vector<uint8_t> encodeTable;
+        std::vector<uint8_t> pixels;
+
+        FramebufferSink sink;
+        StreamMode streamMode;
+        bool retainFrame;
+
+        // Row streaming state: one band per row of tiles
+        std::mutex streamMutex;
+        int bandHeight;
+        int nextBand;
+        std::vector<int> bandTilesLeft;
+        std::vector<std::vector<uint8_t>> bandPixels;
+
+        size_t frameStride() const { return (size_t)width * bytesPerPixel(format); }
+
+        void convertRow(const float* rgb, int count, uint8_t* dst) const {
+            int channels = channelCount(format);
+            float rgba[4 * 64];
+            const float* src = rgb;
+
+            for (int x = 0; x < count; x += 64) {
+                int n = std::min(64, count - x);
+                if (channels == 4) {
+                    for (int i = 0; i < n; i++) {
+                        rgba[i * 4] = rgb[(x + i) * 3];
+                        rgba[i * 4 + 1] = rgb[(x + i) * 3 + 1];
+                        rgba[i * 4 + 2] = rgb[(x + i) * 3 + 2];
+                        rgba[i * 4 + 3] = 1.0f;
+                    }
+                    src = rgba;
+                } else {
+                    src = rgb + x * 3;
+                }
+
+                size_t values = (size_t)n * channels;
+                uint8_t* out = dst + (size_t)x * bytesPerPixel(format);
+                switch (format) {
+                    case PixelFormat::RGB8:
+                    case PixelFormat::RGBA8:
+                        if (encoding == ColorEncoding::Linear) {
+                            PixelConversion::toUnorm8(src, values, out);
+                        } else {
+                            PixelConversion::toEncodedUnorm8(src, values, encodeTable.data(), out);
+                        }
+                        break;
+                    case PixelFormat::RGBA16F: {
+                        uint16_t halves[4 * 64];
+                        PixelConversion::toHalf(src, values, halves);
+                        std::memcpy(out, halves, values * sizeof(uint16_t));
+                        break;
+                    }
+                    case PixelFormat::RGB32F:
+                        std::memcpy(out, src, values * sizeof(float));
+                        break;
+                }
+            }
+        }
+
+        void emit(int x, int y, int w, int h, const uint8_t* data, size_t stride) {
+            FramebufferRegion region = {x, y, w, h, data, stride, format};
+            sink(region);
+        }
+
+    public:
+        Framebuffer(int w, int h, PixelFormat fmt = PixelFormat::RGBA8,
+                    ColorEncoding enc = ColorEncoding::SRGB, float gammaValue = 2.2f)
+            : width(w), height(h), format(fmt), encoding(enc), gamma(gammaValue),
+              streamMode(StreamMode::Tiles), retainFrame(true), bandHeight(0), nextBand(0) {
+            if (encoding != ColorEncoding::Linear) {
+                encodeTable = PixelConversion::buildEncodeTable(encoding, gamma);
+            }
+            pixels.assign((size_t)width * height * bytesPerPixel(format), 0);
+        }
+
+        Framebuffer(const Framebuffer&) = delete;
+        Framebuffer& operator=(const Framebuffer&) = delete;
+
+        void resize(int w, int h) {
+            width = w;
+            height = h;
+            if (retainFrame) {
+                pixels.assign((size_t)width * height * bytesPerPixel(format), 0);
+            }
+        }
+
+        void setSink(FramebufferSink newSink, StreamMode mode = StreamMode::Tiles, bool retain = true) {
+            sink = std::move(newSink);
+            streamMode = mode;
+            retainFrame = retain || !sink;
+            if (retainFrame) {
+                pixels.assign((size_t)width * height * bytesPerPixel(format), 0);
+            } else {
+                pixels.clear();
+                pixels.shrink_to_fit();
+            }
+        }
+
+        // Called by the renderer before the first tile of a frame, with the
+        // size of the tiles it will write; row bands are one tile high
+        void beginFrame(int tileWidth, int tileHeight) {
+            int tilesX = (width + tileWidth - 1) / tileWidth;
+            int tilesY = (height + tileHeight - 1) / tileHeight;
+            bandHeight = tileHeight;
+            nextBand = 0;
+            bandTilesLeft.assign(tilesY, tilesX);
+            bandPixels.assign(retainFrame ? 0 : tilesY, std::vector<uint8_t>());
+        }
+
+        void beginFrame(int tileSize) { beginFrame(tileSize, tileSize); }
+
+        // Quantizes a w x h block of linear RGB floats at (x0, y0). Tiles
+        // must follow the grid passed to beginFrame; disjoint tiles may be
+        // written concurrently.
+        void writeTile(int x0, int y0, int w, int h, const float* rgb) {
+            size_t pixelSize = bytesPerPixel(format);
+            std::vector<uint8_t> scratch;
+            uint8_t* dst;
+            size_t stride;
+            if (retainFrame) {
+                dst = pixels.data() + (size_t)y0 * frameStride() + (size_t)x0 * pixelSize;
+                stride = frameStride();
+            } else {
+                scratch.resize((size_t)w * h * pixelSize);
+                dst = scratch.data();
+                stride = (size_t)w * pixelSize;
+            }
+
+            for (int row = 0; row < h; row++) {
+                convertRow(rgb + (size_t)row * w * 3, w, dst + row * stride);
+            }
+
+            if (!sink) return;
+
+            std::lock_guard<std::mutex> lock(streamMutex);
+            if (streamMode == StreamMode::Tiles) {
+                emit(x0, y0, w, h, dst, stride);
+                return;
+            }
+
+            int band = y0 / bandHeight;
+            if (!retainFrame) {
+                std::vector<uint8_t>& bandData = bandPixels[band];
+                if (bandData.empty()) {
+                    bandData.resize(frameStride() * std::min(bandHeight, height - band * bandHeight));
+                }
+                for (int row = 0; row < h; row++) {
+                    std::memcpy(bandData.data() + (size_t)(y0 - band * bandHeight + row) * frameStride() +
+                                    (size_t)x0 * pixelSize,
+                                dst + row * stride, (size_t)w * pixelSize);
+                }
+            }
+            bandTilesLeft[band]--;
+
+            // Flush every completed band that is next in line
+            while (nextBand < (int)bandTilesLeft.size() && bandTilesLeft[nextBand] == 0) {
+                int y = nextBand * bandHeight;
+                int rows = std::min(bandHeight, height - y);
+                const uint8_t* data = retainFrame ? pixels.data() + (size_t)y * frameStride()
+                                                  : bandPixels[nextBand].data();
+                emit(0, y, width, rows, data, frameStride());
+                if (!retainFrame) {
+                    std::vector<uint8_t>().swap(bandPixels[nextBand]);
+                }
+                nextBand++;
+            }
+        }
+
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+        PixelFormat getFormat() const { return format; }
+        ColorEncoding getEncoding() const { return encoding; }
+        size_t getRowStride() const { return frameStride(); }
+
+        // Empty when streaming without retainFrame
+        const uint8_t* data() const { return pixels.empty() ? nullptr : pixels.data(); }
+        size_t size() const { return pixels.size(); }
+    };
+
+    // Options for the tiled renderer
+    struct RenderOptions {
+        int threadCount;        // Tiles in flight at once; 0 uses the whole job system
+        int tileSize;           // Tile edge length in pixels
+        bool collectTileStats;  // Record per-tile timings
+
+        RenderOptions(int threads = 0, int tile = 32, bool stats = false)
+            : threadCount(threads), tileSize(tile), collectTileStats(stats) {}
+    };
+
+    // Timing for one rendered tile
+    struct TileStats {
+        int x, y;
+        int width, height;
+        int worker;             // Worker that rendered the tile
+        double milliseconds;
+    };
+
+    // Options for progressive rendering. A pixel stops taking samples once
+    // the 95% confidence interval of its mean luminance is within
+    // errorThreshold of the mean, or once it reaches maxSamples.
+    struct ProgressiveOptions {
+        RenderOptions render;
+        int minSamples;         // Samples taken before convergence is tested
+        int maxSamples;         // Hard per-pixel cap
+        int samplesPerPass;     // Samples per unconverged pixel per pass
+        float errorThreshold;   // Relative error target
+        double timeBudgetMs;    // Deadline for the whole call; 0 disables it
+
+        ProgressiveOptions(int minSpp = 4, int maxSpp = 256, float threshold = 0.02f,
+                           double budgetMs = 0.0)
+            : minSamples(minSpp), maxSamples(maxSpp), samplesPerPass(4),
+              errorThreshold(threshold), timeBudgetMs(budgetMs) {}
+    };
+
+    // Outcome of a progressive render call
+    struct ProgressiveStats {
+        int passes;
+        uint64_t samples;
+        size_t convergedPixels;
+        double milliseconds;
+        bool deadlineHit;
+    };
+
+    // Options for the path-tracing integrator
+    struct PathTraceOptions {
+        RenderOptions render;
+        int samplesPerPixel;    // Samples added to every pixel per call
+        int maxBounces;         // Surface bounces after the camera hit
+        int rouletteDepth;      // Bounces before Russian roulette may end a path
+        bool wavefront;         // Trace each bounce of a tile's paths as one ray queue
+        uint32_t seed;          // Changes the noise pattern between renders
+
+        PathTraceOptions(int spp = 16, int bounces = 8, bool breadthFirst = true)
+            : samplesPerPixel(spp), maxBounces(bounces), rouletteDepth(3), wavefront(breadthFirst), seed(0) {}
+    };
+
+    // Outcome of a path-traced render call
+    struct PathTraceStats {
+        uint64_t samples;       // Paths started
+        uint64_t rays;          // Camera and bounce rays
+        uint64_t shadowRays;    // Next-event estimation rays
+        double milliseconds;
+    };
+
+    // PCG32 (XSH RR): 16 bytes of state per stream, statistically
+    // far better than an LCG and only a multiply-add per number. Each
+    // path seeds its own stream, so images don't depend on thread count.
+    class Pcg32 {
+    private:
+        uint64_t state;
+        uint64_t increment;
+
+    public:
+        explicit Pcg32(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0xda3e39cb94b95bdbULL)
+            : state(0), increment((stream << 1) | 1u) {
+            nextUint();
+            state += seed;
+            nextUint();
+        }
+
+        uint32_t nextUint() {
+            uint64_t old = state;
+            state = old * 6364136223846793005ULL + increment;
+            uint32_t xorShifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+            uint32_t rotation = (uint32_t)(old >> 59);
+            return (xorShifted >> rotation) | (xorShifted << ((0u - rotation) & 31));
+        }
+
+        // Uniform in [0, 1)
+        float nextFloat() {
+            return (nextUint() >> 8) * (1.0f / 16777216.0f);
+        }
+    };
+
+    // Float framebuffer that accumulates samples and tracks the running
+    // variance of each pixel's luminance (Welford's method)
+    class AccumulationBuffer {
+    private:
+        int width, height;
+        std::vector<Vector3> sum;
+        std::vector<float> luminanceMean;
+        std::vector<float> luminanceM2;
+        std::vector<uint32_t> sampleCount;
+        std::vector<uint8_t> converged;
+
+    public:
+        AccumulationBuffer(int w = 0, int h = 0) {
+            resize(w, h);
+        }
+
+        void resize(int w, int h) {
+            width = w;
+            height = h;
+            clear();
+        }
+
+        void clear() {
+            size_t count = (size_t)width * height;
+            sum.assign(count, Vector3());
+            luminanceMean.assign(count, 0.0f);
+            luminanceM2.assign(count, 0.0f);
+            sampleCount.assign(count, 0);
+            converged.assign(count, 0);
+        }
+
+        void addSample(int x, int y, const Vector3& color) {
+            size_t i = (size_t)y * width + x;
+            sum[i] = sum[i] + color;
+            uint32_t n = ++sampleCount[i];
+            float luminance = 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+            float delta = luminance - luminanceMean[i];
+            luminanceMean[i] += delta / n;
+            luminanceM2[i] += delta * (luminance - luminanceMean[i]);
+        }
+
+        Vector3 getColor(int x, int y) const {
+            size_t i = (size_t)y * width + x;
+            return sampleCount[i] > 0 ? sum[i] * (1.0f / sampleCount[i]) : Vector3();
+        }
+
+        float getMeanLuminance(int x, int y) const {
+            return luminanceMean[(size_t)y * width + x];
+        }
+
+        // Sample variance of the pixel's luminance
+        float getVariance(int x, int y) const {
+            size_t i = (size_t)y * width + x;
+            return sampleCount[i] > 1 ? luminanceM2[i] / (sampleCount[i] - 1) : 0.0f;
+        }
+
+        uint32_t getSampleCount(int x, int y) const {
+            return sampleCount[(size_t)y * width + x];
+        }
+
+        bool isConverged(int x, int y) const {
+            return converged[(size_t)y * width + x] != 0;
+        }
+
+        void setConverged(int x, int y) {
+            converged[(size_t)y * width + x] = 1;
+        }
+
+        size_t getConvergedCount() const {
+            return (size_t)std::count(converged.begin(), converged.end(), 1);
+        }
+
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+
+        // Streams the per-pixel means into a framebuffer in bands of rows
+        void resolve(Framebuffer& framebuffer, int bandRows = 32) const {
+            bandRows = std::max(1, bandRows);
+            std::vector<float> rgb((size_t)width * bandRows * 3);
+            framebuffer.beginFrame(std::max(1, width), bandRows);
+            for (int y0 = 0; y0 < height; y0 += bandRows) {
+                int rows = std::min(bandRows, height - y0);
+                for (int y = 0; y < rows; y++) {
+                    for (int x = 0; x < width; x++) {
+                        Vector3 color = getColor(x, y0 + y);
+                        float* out = &rgb[((size_t)y * width + x) * 3];
+                        out[0] = color.x;
+                        out[1] = color.y;
+                        out[2] = color.z;
+                    }
+                }
+                framebuffer.writeTile(0, y0, width, rows, rgb.data());
+            }
+        }
+
+        // Writes the per-pixel means in the same int RGB layout as render()
+        void resolve(int* pixels) const {
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    Vector3 color = getColor(x, y);
+                    int index = (y * width + x) * 3;
+                    pixels[index] = (int)(std::min(1.0f, color.x) * 255);
+                    pixels[index + 1] = (int)(std::min(1.0f, color.y) * 255);
+                    pixels[index + 2] = (int)(std::min(1.0f, color.z) * 255);
+                }
+            }
+        }
+    };
+
+    // Ray Tracing Engine
+    class RayTracingEngine {
+    private:
+        std::unique_ptr<Scene> ownedScene;      // Null when rendering a caller's scene
+        Scene* scene;
+        Camera camera;
+        Threading::JobSystem* jobSystem;     // Null uses JobSystem::shared()
+
+        void writePixel(int* pixels, int x, int y, const Vector3& color) const {
+            int index = (y * camera.getWidth() + x) * 3;
+            pixels[index] = (int)(std::min(1.0f, color.x) * 255);
+            pixels[index + 1] = (int)(std::min(1.0f, color.y) * 255);
+            pixels[index + 2] = (int)(std::min(1.0f, color.z) * 255);
+        }
+
+        // Primary visibility is traced in 4x2 pixel packets
+        static constexpr int kPacketWidth = 4;
+        static constexpr int kPacketHeight = 2;
+
+        // Shadow rays start this far off the surface to avoid self-hits
+        static constexpr float kShadowBias = 1e-3f;
+
+        // Floor for the convergence test so near-black pixels can converge
+        static constexpr float kMinLuminance = 0.05f;
+
+        void renderTile(int* pixels, int x0, int y0, int x1, int y1) const {
+            traceTile(x0, y0, x1, y1, [&](int x, int y, const Vector3& color) {
+                writePixel(pixels, x, y, color);
+            });
+        }
+
+        // Traces a tile in packets and hands every shaded pixel to write(x, y, color)
+        template<typename PixelWriter>
+        void traceTile(int x0, int y0, int x1, int y1, PixelWriter&& write) const {
+            RayPacket<kPacketWidth * kPacketHeight> packet;
+            HitInfo hits[kPacketWidth * kPacketHeight];
+
+            for (int y = y0; y < y1; y += kPacketHeight) {
+                for (int x = x0; x < x1; x += kPacketWidth) {
+                    packet.clear();
+                    for (int lane = 0; lane < kPacketWidth * kPacketHeight; lane++) {
+                        int px = x + lane % kPacketWidth;
+                        int py = y + lane / kPacketWidth;
+                        if (px < x1 && py < y1) {
+                            packet.setRay(lane, camera.generateRay(px, py));
+                        }
+                    }
+
+                    scene->tracePacket(packet, hits);
+
+                    for (int lane = 0; lane < kPacketWidth * kPacketHeight; lane++) {
+                        if (packet.isActive(lane)) {
+                            write(x + lane % kPacketWidth, y + lane / kPacketWidth, shade(hits[lane]));
+                        }
+                    }
+                }
+            }
+        }
+
+        Threading::JobSystem& getJobSystem() const {
+            return jobSystem ? *jobSystem : Threading::JobSystem::shared();
+        }
+
+        struct TileRect {
+            uint32_t index;
+            int x0, y0, x1, y1;
+        };
+
+        // Splits the image into tiles and runs fn(tile, worker) over them,
+        // on the calling thread alone when one thread is requested.
+        // Otherwise up to threadCount jobs pull tiles in scanline order.
+        void forEachTile(const RenderOptions& options,
+                         const std::function<void(const TileRect&, int)>& fn) const {
+            PROFILE_SCOPE_CATEGORY("RayTracingEngine::tiles", "render");
+            int threadCount = options.threadCount > 0 ? options.threadCount : getJobSystem().getThreadCount();
+            int tileSize = std::max(1, options.tileSize);
+            int tilesX = (camera.getWidth() + tileSize - 1) / tileSize;
+            int tilesY = (camera.getHeight() + tileSize - 1) / tileSize;
+            uint32_t tileCount = (uint32_t)(tilesX * tilesY);
+
+            std::function<void(uint32_t, int)> task = [&](uint32_t tile, int worker) {
+                PROFILE_SCOPE_CATEGORY("tile", "render");
+                TileRect rect;
+                rect.index = tile;
+                rect.x0 = (int)(tile % tilesX) * tileSize;
+                rect.y0 = (int)(tile / tilesX) * tileSize;
+                rect.x1 = std::min(rect.x0 + tileSize, camera.getWidth());
+                rect.y1 = std::min(rect.y0 + tileSize, camera.getHeight());
+                fn(rect, worker);
+            };
+
+            if (threadCount == 1) {
+                for (uint32_t tile = 0; tile < tileCount; tile++) {
+                    task(tile, 0);
+                }
+                return;
+            }
+
+            Threading::JobSystem& jobs = getJobSystem();
+            std::atomic<uint32_t> nextTile(0);
+            auto lane = [&] {
+                int worker = jobs.getWorkerIndex();
+                for (uint32_t tile; (tile = nextTile.fetch_add(1, std::memory_order_relaxed)) < tileCount;) {
+                    task(tile, worker);
+                }
+            };
+            uint32_t lanes = std::min((uint32_t)threadCount, tileCount);
+            Threading::JobCounter counter;
+            for (uint32_t i = 1; i < lanes; i++) {
+                jobs.run(lane, &counter);
+            }
+            lane();
+            jobs.wait(counter);
+        }
+
+        static uint32_t hashPixel(int x, int y) {
+            uint32_t h = (uint32_t)x * 0x8da6b343u ^ (uint32_t)y * 0xd8163841u;
+            h ^= h >> 16;
+            h *= 0x7feb352du;
+            h ^= h >> 15;
+            h *= 0x846ca68bu;
+            h ^= h >> 16;
+            return h;
+        }
+
+        // Sub-pixel offset for the n-th sample: the R2 low-discrepancy
+        // sequence with a per-pixel random rotation
+        static void samplePosition(int x, int y, uint32_t n, float& jx, float& jy) {
+            uint32_t h = hashPixel(x, y);
+            double rx = (h & 0xFFFFu) / 65536.0 + n * 0.7548776662466927;
+            double ry = (h >> 16) / 65536.0 + n * 0.5698402909980532;
+            jx = (float)(rx - std::floor(rx));
+            jy = (float)(ry - std::floor(ry));
+        }
+
+        bool pixelNeedsSamples(const AccumulationBuffer& buffer, const ProgressiveOptions& options,
+                               int x, int y) const {
+            return !buffer.isConverged(x, y) &&
+                   buffer.getSampleCount(x, y) < (uint32_t)options.maxSamples;
+        }
+
+        // One pass over a tile: every pixel that still needs work takes
+        // samplesPerPixel jittered samples, traced in 4x2 packets, and is then
+        // tested for convergence. Returns the number of samples taken.
+        uint64_t sampleTile(AccumulationBuffer& buffer, const ProgressiveOptions& options,
+                            const TileRect& tile, int samplesPerPixel) const {
+            constexpr int kLanes = kPacketWidth * kPacketHeight;
+            RayPacket<kLanes> packet;
+            HitInfo hits[kLanes];
+            uint64_t taken = 0;
+
+            for (int y = tile.y0; y < tile.y1; y += kPacketHeight) {
+                for (int x = tile.x0; x < tile.x1; x += kPacketWidth) {
+                    for (int s = 0; s < samplesPerPixel; s++) {
+                        packet.clear();
+                        for (int lane = 0; lane < kLanes; lane++) {
+                            int px = x + lane % kPacketWidth;
+                            int py = y + lane / kPacketWidth;
+                            if (px < tile.x1 && py < tile.y1 && pixelNeedsSamples(buffer, options, px, py)) {
+                                float jx, jy;
+                                samplePosition(px, py, buffer.getSampleCount(px, py), jx, jy);
+                                packet.setRay(lane, camera.generateRay(px, py, jx, jy));
+                            }
+                        }
+                        if (packet.activeMask == 0) break;
+
+                        scene->tracePacket(packet, hits);
+                        for (int lane = 0; lane < kLanes; lane++) {
+                            if (packet.isActive(lane)) {
+                                buffer.addSample(x + lane % kPacketWidth, y + lane / kPacketWidth,
+                                                 shade(hits[lane]));
+                                taken++;
+                            }
+                        }
+                    }
+
+                    for (int lane = 0; lane < kLanes; lane++) {
+                        int px = x + lane % kPacketWidth;
+                        int py = y + lane / kPacketWidth;
+                        if (px >= tile.x1 || py >= tile.y1 || buffer.isConverged(px, py)) continue;
+
+                        uint32_t n = buffer.getSampleCount(px, py);
+                        if (n < (uint32_t)std::max(2, options.minSamples)) continue;
+                        float halfWidth = 1.96f * std::sqrt(buffer.getVariance(px, py) / n);
+                        float mean = std::max(buffer.getMeanLuminance(px, py), kMinLuminance);
+                        if (halfWidth <= options.errorThreshold * mean) {
+                            buffer.setConverged(px, py);
+                        }
+                    }
+                }
+            }
+            return taken;
+        }
+
+        static Vector3 modulate(const Vector3& a, const Vector3& b) {
+            return Vector3(a.x * b.x, a.y * b.y, a.z * b.z);
+        }
+
+        // Tangent and bitangent for a unit normal (Duff et al. 2017)
+        static void orthonormalBasis(const Vector3& n, Vector3& tangent, Vector3& bitangent) {
+            float sign = std::copysign(1.0f, n.z);
+            float a = -1.0f / (sign + n.z);
+            float b = n.x * n.y * a;
+            tangent = Vector3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+            bitangent = Vector3(b, sign + n.y * n.y * a, -n.y);
+        }
+
+        // What next-event estimation can aim at: the scene's lights, then
+        // its emissive top-level spheres, all picked with equal odds
+        struct EmitterTable {
+            struct Sphere {
+                Vector3 center;
+                float radius;
+                Vector3 radiance;
+            };
+
+            size_t lightCount;
+            std::vector<Sphere> spheres;
+            std::vector<int32_t> sphereEmitter;     // Sphere id -> index in spheres, or -1
+
+            size_t size() const { return lightCount + spheres.size(); }
+
+            int32_t emitterOf(uint32_t sphereId) const {
+                return sphereId < sphereEmitter.size() ? sphereEmitter[sphereId] : -1;
+            }
+        };
+
+        EmitterTable buildEmitters() const {
+            EmitterTable emitters;
+            emitters.lightCount = scene->getLights().size();
+            emitters.sphereEmitter.assign(scene->getSphereCount(), -1);
+            for (uint32_t id = 0; id < scene->getSphereCount(); id++) {
+                const Material& material = scene->getMaterial(scene->getSphereMaterial(id));
+                float radius = scene->getSphereRadius(id);
+                if (material.emission <= 0.0f || radius <= 0.0f) continue;
+                emitters.sphereEmitter[id] = (int32_t)emitters.spheres.size();
+                emitters.spheres.push_back({scene->getSphereCenter(id), radius, material.albedo * material.emission});
+            }
+            return emitters;
+        }
+
+        // Solid angle pdf of picking emitter sphere and then a direction in
+        // the cone it subtends from point; 0 from inside it
+        static float emitterPdf(const EmitterTable& emitters, int32_t sphere, const Vector3& point) {
+            const EmitterTable::Sphere& emitter = emitters.spheres[sphere];
+            Vector3 toCenter = emitter.center - point;
+            float distance2 = toCenter.dot(toCenter);
+            float radius2 = emitter.radius * emitter.radius;
+            if (distance2 <= radius2) return 0.0f;
+            float sin2 = radius2 / distance2;
+            float oneMinusCos = sin2 / (1.0f + std::sqrt(1.0f - sin2));
+            return 1.0f / (emitters.size() * 2.0f * (float)M_PI * oneMinusCos);
+        }
+
+        struct EmitterSample {
+            Vector3 direction;
+            float distance;         // Shadow ray length
+            Vector3 radiance;       // Arriving radiance over the sample's pdf
+            float pdf;              // Solid angle pdf; 0 for point and directional lights
+        };
+
+        // Picks an emitter with u0 and a direction towards it with (u1, u2).
+        // Returns false if the pick can't light point.
+        bool sampleEmitter(const EmitterTable& emitters, const Vector3& point, int32_t ownSphere,
+                           float u0, float u1, float u2, EmitterSample& sample) const {
+            size_t count = emitters.size();
+            size_t index = std::min(count - 1, (size_t)(u0 * count));
+            if (index < emitters.lightCount) {
+                const Light& light = scene->getLights()[index];
+                float falloff = 1.0f;
+                if (light.type == Light::Type::Directional) {
+                    sample.direction = light.direction;
+                    sample.distance = std::numeric_limits<float>::max();
+                } else {
+                    Vector3 offset = light.position - point;
+                    sample.distance = offset.length();
+                    if (sample.distance <= 0.0f) return false;
+                    sample.direction = offset * (1.0f / sample.distance);
+                    falloff = 1.0f / (sample.distance * sample.distance);
+                }
+                sample.radiance = light.color * (light.intensity * falloff * count);
+                sample.pdf = 0.0f;
+                return true;
+            }
+
+            // A convex emitter can't light its own surface
+            int32_t sphere = (int32_t)(index - emitters.lightCount);
+            if (sphere == ownSphere) return false;
+            const EmitterTable::Sphere& emitter = emitters.spheres[sphere];
+            Vector3 toCenter = emitter.center - point;
+            float distance2 = toCenter.dot(toCenter);
+            float radius2 = emitter.radius * emitter.radius;
+            if (distance2 <= radius2) return false;
+
+            // Uniform over the cone of directions that hit the sphere
+            float sin2 = radius2 / distance2;
+            float oneMinusCosMax = sin2 / (1.0f + std::sqrt(1.0f - sin2));
+            float oneMinusCos = u1 * oneMinusCosMax;
+            float sinTheta = std::sqrt(std::max(0.0f, oneMinusCos * (2.0f - oneMinusCos)));
+            float phi = 2.0f * (float)M_PI * u2;
+            Vector3 axis = toCenter * Math::rsqrt(distance2);
+            Vector3 tangent, bitangent;
+            orthonormalBasis(axis, tangent, bitangent);
+            sample.direction = (tangent * (std::cos(phi) * sinTheta) + bitangent * (std::sin(phi) * sinTheta) +
+                                axis * (1.0f - oneMinusCos)).normalize();
+
+            float along = toCenter.dot(sample.direction);
+            float chord2 = std::max(0.0f, radius2 - (distance2 - along * along));
+            sample.distance = along - std::sqrt(chord2);
+            sample.pdf = 1.0f / (count * 2.0f * (float)M_PI * oneMinusCosMax);
+            sample.radiance = emitter.radiance * (1.0f / sample.pdf);
+            return true;
+        }
+
+        // Lambert diffuse plus a GGX specular lobe, mixed by metallic as in
+        // the usual metallic/roughness model
+        struct SurfaceBsdf {
+            Vector3 normal;             // Facing the outgoing direction
+            Vector3 tangent;
+            Vector3 bitangent;
+            Vector3 diffuse;            // Albedo left to the diffuse lobe
+            Vector3 f0;                 // Specular reflectance at normal incidence
+            float alpha;                // GGX width, roughness squared
+            float specularChance;       // Odds of sampling the specular lobe
+        };
+
+        // Keeps a roughness of 0 from becoming a delta lobe
+        static constexpr float kMinAlpha = 2e-3f;
+
+        static SurfaceBsdf makeBsdf(const Material& material, const Vector3& normal) {
+            SurfaceBsdf bsdf;
+            bsdf.normal = normal;
+            orthonormalBasis(normal, bsdf.tangent, bsdf.bitangent);
+            float metallic = std::min(1.0f, std::max(0.0f, material.metallic));
+            float roughness = std::min(1.0f, std::max(0.0f, material.roughness));
+            bsdf.diffuse = material.albedo * (1.0f - metallic);
+            bsdf.f0 = Vector3(0.04f, 0.04f, 0.04f) * (1.0f - metallic) + material.albedo * metallic;
+            bsdf.alpha = std::max(kMinAlpha, roughness * roughness);
+            bsdf.specularChance = 0.25f + 0.75f * metallic;
+            return bsdf;
+        }
+
+        static float smithG1(float cosine, float alpha2) {
+            return 2.0f * cosine / (cosine + std::sqrt(alpha2 + (1.0f - alpha2) * cosine * cosine));
+        }
+
+        // f(wo, wi), and in pdf the odds of sampleBsdf() choosing wi
+        static Vector3 evalBsdf(const SurfaceBsdf& bsdf, const Vector3& wo, const Vector3& wi, float& pdf) {
+            float cosIn = bsdf.normal.dot(wi);
+            float cosOut = bsdf.normal.dot(wo);
+            if (cosIn <= 0.0f || cosOut <= 0.0f) {
+                pdf = 0.0f;
+                return Vector3();
+            }
+
+            Vector3 half = (wo + wi).normalize();
+            float cosHalf = std::max(0.0f, bsdf.normal.dot(half));
+            float outHalf = std::max(1e-6f, wo.dot(half));
+            float alpha2 = bsdf.alpha * bsdf.alpha;
+            float d = cosHalf * cosHalf * (alpha2 - 1.0f) + 1.0f;
+            float distribution = alpha2 / ((float)M_PI * d * d);
+            float schlick = std::pow(1.0f - outHalf, 5.0f);
+            Vector3 fresnel = bsdf.f0 + (Vector3(1.0f, 1.0f, 1.0f) - bsdf.f0) * schlick;
+            float geometry = smithG1(cosIn, alpha2) * smithG1(cosOut, alpha2);
+
+            Vector3 specular = fresnel * (distribution * geometry / (4.0f * cosIn * cosOut));
+            Vector3 diffuse = modulate(bsdf.diffuse, Vector3(1.0f, 1.0f, 1.0f) - fresnel) * (1.0f / (float)M_PI);
+            pdf = (1.0f - bsdf.specularChance) * cosIn / (float)M_PI +
+                  bsdf.specularChance * distribution * cosHalf / (4.0f * outHalf);
+            return diffuse + specular;
+        }
+
+        // Draws wi from the cosine-weighted diffuse lobe or the GGX normal
+        // distribution and returns f * cos / pdf for it in weight
+        static bool sampleBsdf(const SurfaceBsdf& bsdf, const Vector3& wo, float u0, float u1, float u2,
+                               Vector3& wi, Vector3& weight, float& pdf) {
+            float phi = 2.0f * (float)M_PI * u2;
+            if (u0 < bsdf.specularChance) {
+                float alpha2 = bsdf.alpha * bsdf.alpha;
+                float cos2 = (1.0f - u1) / (1.0f + (alpha2 - 1.0f) * u1);
+                float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cos2));
+                Vector3 half = bsdf.tangent * (std::cos(phi) * sinTheta) +
+                               bsdf.bitangent * (std::sin(phi) * sinTheta) + bsdf.normal * std::sqrt(cos2);
+                wi = half * (2.0f * wo.dot(half)) - wo;
+            } else {
+                float r = std::sqrt(u1);
+                wi = bsdf.tangent * (r * std::cos(phi)) + bsdf.bitangent * (r * std::sin(phi)) +
+                     bsdf.normal * std::sqrt(std::max(0.0f, 1.0f - u1));
+            }
+            wi = wi.normalize();
+
+            Vector3 f = evalBsdf(bsdf, wo, wi, pdf);
+            if (pdf <= 0.0f) return false;
+            weight = f * (bsdf.normal.dot(wi) / pdf);
+            return true;
+        }
+
+        // One path through the integrator. Both execution modes advance it
+        // with the same shadePath() calls in the same order, so they draw
+        // identical random numbers.
+        struct PathState {
+            Ray ray;
+            Vector3 throughput;
+            Vector3 radiance;
+            Pcg32 rng;
+            float bsdfPdf;              // Pdf of the ray's direction; 0 for camera rays
+            int depth;                  // Bounces so far
+        };
+
+        struct ShadowRay {
+            Ray ray;
+            float distance;
+            Vector3 contribution;       // Added to the path's radiance if unoccluded
+            uint32_t path;
+        };
+
+        static float powerHeuristic(float pdf, float otherPdf) {
+            float a = pdf * pdf;
+            return a / (a + otherPdf * otherPdf);
+        }
+
+        // Advances path past hit: adds emission (weighted against light
+        // sampling), picks a light sample for the caller to test in shadow,
+        // and continues along a BSDF sample. Returns false when the path ends.
+        bool shadePath(PathState& path, const HitInfo& hit, const EmitterTable& emitters,
+                       const PathTraceOptions& options, ShadowRay& shadow, bool& hasShadow) const {
+            hasShadow = false;
+            if (!hit.hit) {
+                path.radiance = path.radiance + modulate(path.throughput, scene->getBackgroundColor());
+                return false;
+            }
+
+            const Material& material = scene->getMaterial(hit.materialId);
+            int32_t ownSphere = emitters.emitterOf(hit.sphereId);
+            if (material.emission > 0.0f) {
+                float weight = 1.0f;
+                if (path.bsdfPdf > 0.0f && ownSphere >= 0) {
+                    weight = powerHeuristic(path.bsdfPdf, emitterPdf(emitters, ownSphere, path.ray.origin));
+                }
+                path.radiance = path.radiance +
+                                modulate(path.throughput, material.albedo * (material.emission * weight));
+            }
+            if (path.depth >= options.maxBounces) return false;
+
+            Vector3 wo = path.ray.direction * -1.0f;
+            Vector3 normal = hit.normal.dot(wo) < 0.0f ? hit.normal * -1.0f : hit.normal;
+            SurfaceBsdf bsdf = makeBsdf(material, normal);
+            Vector3 origin = hit.point + normal * kShadowBias;
+
+            if (emitters.size() > 0) {
+                float u0 = path.rng.nextFloat();
+                float u1 = path.rng.nextFloat();
+                float u2 = path.rng.nextFloat();
+                EmitterSample light;
+                if (sampleEmitter(emitters, origin, ownSphere, u0, u1, u2, light)) {
+                    float bsdfPdf;
+                    Vector3 f = evalBsdf(bsdf, wo, light.direction, bsdfPdf);
+                    if (bsdfPdf > 0.0f) {
+                        float weight = light.pdf > 0.0f ? powerHeuristic(light.pdf, bsdfPdf) : 1.0f;
+                        float cosine = normal.dot(light.direction);
+                        shadow.ray = Ray(origin, light.direction, unitDirection);
+                        shadow.distance = light.distance * (1.0f - 1e-4f);
+                        shadow.contribution = modulate(modulate(path.throughput, f), light.radiance) *
+                                              (cosine * weight);
+                        hasShadow = true;
+                    }
+                }
+            }
+
+            float u0 = path.rng.nextFloat();
+            float u1 = path.rng.nextFloat();
+            float u2 = path.rng.nextFloat();
+            Vector3 wi, weight;
+            float pdf;
+            if (!sampleBsdf(bsdf, wo, u0, u1, u2, wi, weight, pdf)) return false;
+            path.throughput = modulate(path.throughput, weight);
+            path.ray = Ray(origin, wi, unitDirection);
+            path.bsdfPdf = pdf;
+            path.depth++;
+
+            // Unlikely paths end early; survivors carry the lost energy
+            if (path.depth > options.rouletteDepth) {
+                float keep = std::min(0.95f, std::max(path.throughput.x,
+                                                      std::max(path.throughput.y, path.throughput.z)));
+                if (path.rng.nextFloat() >= keep) return false;
+                path.throughput = path.throughput * (1.0f / keep);
+            }
+            return true;
+        }
+
+        // Fresh path for the sample-th sample of pixel (x, y)
+        PathState startPath(int x, int y, uint32_t sample, const PathTraceOptions& options) const {
+            float jx, jy;
+            samplePosition(x, y, sample, jx, jy);
+            PathState path;
+            path.ray = camera.generateRay(x, y, jx, jy);
+            path.throughput = Vector3(1.0f, 1.0f, 1.0f);
+            path.radiance = Vector3();
+            path.rng = Pcg32(((uint64_t)options.seed << 32) | hashPixel(x, y), sample);
+            path.bsdfPdf = 0.0f;
+            path.depth = 0;
+            return path;
+        }
+
+        // A NaN or infinite sample would poison its pixel for good
+        static Vector3 finiteRadiance(const Vector3& radiance) {
+            bool finite = std::isfinite(radiance.x) && std::isfinite(radiance.y) && std::isfinite(radiance.z);
+            return finite ? radiance : Vector3();
+        }
+
+        // Depth-first: each path runs to the end before the next starts
+        void pathTraceTile(AccumulationBuffer& buffer, const EmitterTable& emitters,
+                           const PathTraceOptions& options, const TileRect& tile, PathTraceStats& stats) const {
+            for (int y = tile.y0; y < tile.y1; y++) {
+                for (int x = tile.x0; x < tile.x1; x++) {
+                    uint32_t first = buffer.getSampleCount(x, y);
+                    for (int s = 0; s < options.samplesPerPixel; s++) {
+                        PathState path = startPath(x, y, first + s, options);
+                        ShadowRay shadow;
+                        bool hasShadow;
+                        bool alive = true;
+                        while (alive) {
+                            stats.rays++;
+                            alive = shadePath(path, scene->traceRay(path.ray), emitters, options, shadow, hasShadow);
+                            if (hasShadow) {
+                                stats.shadowRays++;
+                                if (!scene->occluded(shadow.ray, shadow.distance)) {
+                                    path.radiance = path.radiance + shadow.contribution;
+                                }
+                            }
+                        }
+                        buffer.addSample(x, y, finiteRadiance(path.radiance));
+                        stats.samples++;
+                    }
+                }
+            }
+        }
+
+        // Breadth-first: the tile's paths advance one bounce at a time.
+        // Each bounce sorts the live rays by direction octant and traces
+        // them in packets, so scattered secondary rays still travel in
+        // coherent groups, then shades them all and tests their shadow rays.
+        void wavefrontTile(AccumulationBuffer& buffer, const EmitterTable& emitters,
+                           const PathTraceOptions& options, const TileRect& tile, PathTraceStats& stats) const {
+            constexpr int kLanes = kPacketWidth * kPacketHeight;
+            constexpr uint32_t kMaxWave = 8192;
+            thread_local std::vector<PathState> paths;
+            thread_local std::vector<uint32_t> active, next, sorted;
+            thread_local std::vector<HitInfo> hits;
+            thread_local std::vector<ShadowRay> shadows;
+
+            int tileWidth = tile.x1 - tile.x0;
+            uint32_t pixelCount = (uint32_t)(tileWidth * (tile.y1 - tile.y0));
+            int samplesPerWave = (int)std::max(1u, kMaxWave / pixelCount);
+            RayPacket<kLanes> packet;
+            HitInfo packetHits[kLanes];
+
+            for (int s0 = 0; s0 < options.samplesPerPixel; s0 += samplesPerWave) {
+                int spp = std::min(samplesPerWave, options.samplesPerPixel - s0);
+                uint32_t pathCount = pixelCount * (uint32_t)spp;
+                paths.resize(pathCount);
+                hits.resize(pathCount);
+                active.resize(pathCount);
+                for (uint32_t p = 0; p < pixelCount; p++) {
+                    int x = tile.x0 + (int)(p % tileWidth);
+                    int y = tile.y0 + (int)(p / tileWidth);
+                    uint32_t first = buffer.getSampleCount(x, y);
+                    for (int s = 0; s < spp; s++) {
+                        uint32_t index = p * spp + s;
+                        paths[index] = startPath(x, y, first + s, options);
+                        active[index] = index;
+                    }
+                }
+
+                while (!active.empty()) {
+                    // Counting sort by the direction's sign bits
+                    size_t octantStart[9] = {};
+                    auto octant = [&](uint32_t index) {
+                        const Vector3& d = paths[index].ray.direction;
+                        return (d.x < 0.0f ? 1 : 0) | (d.y < 0.0f ? 2 : 0) | (d.z < 0.0f ? 4 : 0);
+                    };
+                    for (uint32_t index : active) octantStart[octant(index) + 1]++;
+                    for (int i = 1; i < 9; i++) octantStart[i] += octantStart[i - 1];
+                    sorted.resize(active.size());
+                    for (uint32_t index : active) sorted[octantStart[octant(index)]++] = index;
+
+                    for (size_t first = 0; first < sorted.size(); first += kLanes) {
+                        packet.clear();
+                        int lanes = (int)std::min<size_t>(kLanes, sorted.size() - first);
+                        for (int lane = 0; lane < lanes; lane++) {
+                            packet.setRay(lane, paths[sorted[first + lane]].ray);
+                        }
+                        scene->tracePacket(packet, packetHits);
+                        for (int lane = 0; lane < lanes; lane++) {
+                            hits[sorted[first + lane]] = packetHits[lane];
+                        }
+                    }
+                    stats.rays += sorted.size();
+
+                    // Shade in path order, the order the depth-first mode runs in
+                    shadows.clear();
+                    next.clear();
+                    for (uint32_t index : active) {
+                        ShadowRay shadow;
+                        bool hasShadow;
+                        bool alive = shadePath(paths[index], hits[index], emitters, options, shadow, hasShadow);
+                        if (hasShadow) {
+                            shadow.path = index;
+                            shadows.push_back(shadow);
+                        }
+                        if (alive) next.push_back(index);
+                    }
+
+                    stats.shadowRays += shadows.size();
+                    for (const ShadowRay& shadow : shadows) {
+                        if (!scene->occluded(shadow.ray, shadow.distance)) {
+                            PathState& path = paths[shadow.path];
+                            path.radiance = path.radiance + shadow.contribution;
+                        }
+                    }
+                    active.swap(next);
+                }
+
+                for (uint32_t p = 0; p < pixelCount; p++) {
+                    int x = tile.x0 + (int)(p % tileWidth);
+                    int y = tile.y0 + (int)(p / tileWidth);
+                    for (int s = 0; s < spp; s++) {
+                        buffer.addSample(x, y, finiteRadiance(paths[p * spp + s].radiance));
+                    }
+                }
+                stats.samples += pathCount;
+            }
+        }
+
+    public:
+        // Takes the scene over
+        RayTracingEngine(Scene&& s, const Camera& c)
+            : ownedScene(std::make_unique<Scene>(std::move(s))), scene(ownedScene.get()), camera(c),
+              jobSystem(nullptr) {}
+
+        // Renders a scene the caller keeps and updates in place, e.g. one
+        // fed by a scene bridge; it must outlive the engine
+        RayTracingEngine(Scene& s, const Camera& c) : scene(&s), camera(c), jobSystem(nullptr) {}
+
+        RayTracingEngine(const RayTracingEngine&) = delete;
+        RayTracingEngine& operator=(const RayTracingEngine&) = delete;
+
+        // Multi-threaded renders submit their tiles here; null selects the
+        // engine-wide JobSystem::shared()
+        void setJobSystem(Threading::JobSystem* jobs) { jobSystem = jobs; }
+
+        // Animation drivers move objects through the scene and call
+        // Scene::refit() between frames; rendering never mutates it.
+        Scene& getScene() { return *scene; }
+        const Scene& getScene() const { return *scene; }
+        Camera& getCamera() { return camera; }
+        const Camera& getCamera() const { return camera; }
+
+        Vector3 renderPixel(int x, int y) const {
+            Ray ray = camera.generateRay(x, y);
+            return shade(scene->traceRay(ray));
+        }
+
+        // Ambient plus Lambert shading from every scene light that a shadow
+        // ray can reach
+        Vector3 shade(const HitInfo& hit) const {
+            if (!hit.hit) {
+                return scene->getBackgroundColor();
+            }
+
+            const Vector3& albedo = scene->getMaterial(hit.materialId).albedo;
+            Vector3 shadowOrigin = hit.point + hit.normal * kShadowBias;
+            Vector3 color = albedo * 0.3f;
+
+            for (const Light& light : scene->getLights()) {
+                Vector3 toLight;
+                float distance;
+                float falloff;
+                if (light.type == Light::Type::Directional) {
+                    toLight = light.direction;
+                    distance = std::numeric_limits<float>::max();
+                    falloff = 1.0f;
+                } else {
+                    Vector3 offset = light.position - shadowOrigin;
+                    distance = offset.length();
+                    toLight = offset * (1.0f / distance);
+                    falloff = 1.0f / (distance * distance);
+                }
+
+                float cosTheta = hit.normal.dot(toLight);
+                if (cosTheta <= 0.0f) continue;
+                if (scene->occluded(Ray(shadowOrigin, toLight, unitDirection), distance)) continue;
+
+                float strength = 0.7f * light.intensity * falloff * cosTheta;
+                color = color + Vector3(albedo.x * light.color.x, albedo.y * light.color.y,
+                                        albedo.z * light.color.z) * strength;
+            }
+
+            return color;
+        }
+
+        void render(int* pixels) const {
+            renderTile(pixels, 0, 0, camera.getWidth(), camera.getHeight());
+        }
+
+        // Tiled render on the job system. The serial and tiled paths both
+        // trace through renderTile, so the image is identical.
+        void render(int* pixels, const RenderOptions& options,
+                    std::vector<TileStats>* tileStats = nullptr) const {
+            bool timed = options.collectTileStats && tileStats != nullptr;
+            if (timed) {
+                int tileSize = std::max(1, options.tileSize);
+                int tilesX = (camera.getWidth() + tileSize - 1) / tileSize;
+                int tilesY = (camera.getHeight() + tileSize - 1) / tileSize;
+                tileStats->assign((size_t)(tilesX * tilesY), TileStats());
+            }
+
+            forEachTile(options, [&](const TileRect& tile, int worker) {
+                auto start = std::chrono::steady_clock::now();
+                renderTile(pixels, tile.x0, tile.y0, tile.x1, tile.y1);
+                if (timed) {
+                    auto end = std::chrono::steady_clock::now();
+                    TileStats& stats = (*tileStats)[tile.index];
+                    stats.x = tile.x0;
+                    stats.y = tile.y0;
+                    stats.width = tile.x1 - tile.x0;
+                    stats.height = tile.y1 - tile.y0;
+                    stats.worker = worker;
+                    stats.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+                }
+            });
+        }
+
+        // Tiled render into a packed framebuffer, quantizing and streaming
+        // each tile as it completes
+        void render(Framebuffer& framebuffer, const RenderOptions& options = RenderOptions()) const {
+            if (framebuffer.getWidth() != camera.getWidth() || framebuffer.getHeight() != camera.getHeight()) {
+                framebuffer.resize(camera.getWidth(), camera.getHeight());
+            }
+
+            framebuffer.beginFrame(std::max(1, options.tileSize));
+            forEachTile(options, [&](const TileRect& tile, int) {
+                int w = tile.x1 - tile.x0;
+                int h = tile.y1 - tile.y0;
+                thread_local std::vector<float> rgb;
+                rgb.resize((size_t)w * h * 3);
+                traceTile(tile.x0, tile.y0, tile.x1, tile.y1, [&](int x, int y, const Vector3& color) {
+                    float* out = &rgb[((size_t)(y - tile.y0) * w + (x - tile.x0)) * 3];
+                    out[0] = color.x;
+                    out[1] = color.y;
+                    out[2] = color.z;
+                });
+                framebuffer.writeTile(tile.x0, tile.y0, w, h, rgb.data());
+            });
+        }
+
+        // Progressive adaptive render into buffer, which may already hold
+        // samples from earlier calls. Passes repeat until every pixel has
+        // converged or hit maxSamples, or until the time budget runs out;
+        // tiles not yet started when the deadline passes are skipped. The
+        // first pass over an empty buffer always completes so every pixel
+        // has at least one sample; under a deadline it takes just that one.
+        ProgressiveStats renderProgressive(AccumulationBuffer& buffer,
+                                           const ProgressiveOptions& options) const {
+            if (buffer.getWidth() != camera.getWidth() || buffer.getHeight() != camera.getHeight()) {
+                buffer.resize(camera.getWidth(), camera.getHeight());
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            bool hasDeadline = options.timeBudgetMs > 0.0;
+            auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(options.timeBudgetMs));
+
+            ProgressiveStats stats = {0, 0, 0, 0.0, false};
+            std::atomic<uint64_t> samples(0);
+            std::atomic<uint64_t> pending(0);
+            bool firstPass = buffer.getSampleCount(0, 0) == 0;
+
+            for (;;) {
+                pending.store(0);
+                bool enforceDeadline = hasDeadline && !firstPass;
+                int samplesPerPixel = (hasDeadline && firstPass) ? 1 : std::max(1, options.samplesPerPass);
+                forEachTile(options.render, [&](const TileRect& tile, int) {
+                    if (enforceDeadline && std::chrono::steady_clock::now() >= deadline) {
+                        pending.fetch_add(1);
+                        return;
+                    }
+                    uint64_t taken = sampleTile(buffer, options, tile, samplesPerPixel);
+                    samples.fetch_add(taken, std::memory_order_relaxed);
+                    if (taken > 0) pending.fetch_add(1);
+                });
+                stats.passes++;
+                firstPass = false;
+
+                // No tile took a sample: everything has converged or capped
+                if (pending.load() == 0) break;
+                if (hasDeadline && std::chrono::steady_clock::now() >= deadline) {
+                    stats.deadlineHit = true;
+                    break;
+                }
+            }
+
+            stats.samples = samples.load();
+            stats.convergedPixels = buffer.getConvergedCount();
+            stats.milliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            return stats;
+        }
+
+        // Path-traced render adding samplesPerPixel samples to every pixel
+        // of buffer, which may hold samples from earlier calls; the sample
+        // sequence carries on from there. Material roughness, metallic and
+        // emission all take part, and direct light is sampled from the
+        // scene's lights and emissive spheres.
+        PathTraceStats renderPathTraced(AccumulationBuffer& buffer, const PathTraceOptions& options) const {
+            PROFILE_SCOPE_CATEGORY("RayTracingEngine::renderPathTraced", "render");
+            if (buffer.getWidth() != camera.getWidth() || buffer.getHeight() != camera.getHeight()) {
+                buffer.resize(camera.getWidth(), camera.getHeight());
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            EmitterTable emitters = buildEmitters();
+            std::atomic<uint64_t> samples(0), rays(0), shadowRays(0);
+            forEachTile(options.render, [&](const TileRect& tile, int) {
+                PathTraceStats tileStats = {0, 0, 0, 0.0};
+                if (options.wavefront) {
+                    wavefrontTile(buffer, emitters, options, tile, tileStats);
+                } else {
+                    pathTraceTile(buffer, emitters, options, tile, tileStats);
+                }
+                samples.fetch_add(tileStats.samples, std::memory_order_relaxed);
+                rays.fetch_add(tileStats.rays, std::memory_order_relaxed);
+                shadowRays.fetch_add(tileStats.shadowRays, std::memory_order_relaxed);
+            });
+
+            PathTraceStats stats;
+            stats.samples = samples.load();
+            stats.rays = rays.load();
+            stats.shadowRays = shadowRays.load();
+            stats.milliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            return stats;
+        }
+
+        // Path-traced render straight into the int RGB layout of render()
+        PathTraceStats renderPathTraced(int* pixels, const PathTraceOptions& options) const {
+            AccumulationBuffer buffer(camera.getWidth(), camera.getHeight());
+            PathTraceStats stats = renderPathTraced(buffer, options);
+            buffer.resolve(pixels);
+            return stats;
+        }
+
+        // Progressive render straight into the int RGB layout of render()
+        ProgressiveStats renderProgressive(int* pixels, const ProgressiveOptions& options) const {
+            AccumulationBuffer buffer(camera.getWidth(), camera.getHeight());
+            ProgressiveStats stats = renderProgressive(buffer, options);
+            buffer.resolve(pixels);
+            return stats;
         }
     };
 
@@ -0,0 +1,379 @@
+#ifndef RAY_TRACING_SCENE_FILE_H
+#define RAY_TRACING_SCENE_FILE_H
+
+#include "ray_tracing_engine.h"
+#include "mapped_file.h"
+#include <fstream>
+#include <string>
+#include <type_traits>
+
+namespace RayTracing {
+
+    using IO::MappedFile;
+
+    // Binary scene file, laid out so a mapped file can back a Scene
+    // directly: the SoA primitive arrays and BVH nodes are used in place and
+    // only the small material and light tables are copied.
+    //
+    // Layout: a SceneFileHeader followed by one 64-byte aligned section per
+    // SceneFileSection, all little-endian. Arrays are stored exactly as the
+    // stores keep them (padding and leaf order included), so the node array
+    // indexes straight into them. Loading checks the header and section
+    // sizes, then makes one pass over every index the traversals and
+    // shading follow (BVH links, leaf ranges and depth, vertex, material
+    // and sphere ids), so a corrupt file fails to load instead of being
+    // read out of bounds. Float contents are not checked.
+    enum SceneFileSection : uint32_t {
+        SectionSphereX,
+        SectionSphereY,
+        SectionSphereZ,
+        SectionSphereRadius2,
+        SectionSphereMaterial,
+        SectionVertices,
+        SectionIndex0,
+        SectionIndex1,
+        SectionIndex2,
+        SectionTriangleMaterial,
+        SectionEdgeV0x,             // The nine edge sections are empty for
+        SectionEdgeV0y,             // indexed triangle stores
+        SectionEdgeV0z,
+        SectionEdgeE1x,
+        SectionEdgeE1y,
+        SectionEdgeE1z,
+        SectionEdgeE2x,
+        SectionEdgeE2y,
+        SectionEdgeE2z,
+        SectionMaterials,
+        SectionLights,
+        SectionNodes,
+        SectionSphereIds,           // Stable ids, in slot order
+        SectionCount
+    };
+
+    struct SceneFileHeader {
+        struct Section {
+            uint64_t offset;
+            uint64_t size;          // Bytes
+        };
+
+        char magic[8];              // "RTSCENE\0"
+        uint32_t version;
+        uint32_t byteOrder;         // kByteOrderMark as written
+        uint32_t headerSize;        // sizeof(SceneFileHeader)
+        uint32_t flags;
+        uint32_t sphereCount;
+        uint32_t triangleCount;
+        uint32_t vertexCount;
+        uint32_t materialCount;
+        uint32_t lightCount;
+        uint32_t nodeCount;
+        float background[3];
+        uint32_t reserved;
+        Section sections[SectionCount];
+    };
+
+    class SceneFile {
+    public:
+        static constexpr uint32_t kVersion = 2;
+        static constexpr uint32_t kByteOrderMark = 0x01020304u;
+        static constexpr uint32_t kFlagPrecomputedEdges = 1u << 0;
+        static constexpr uint64_t kAlignment = 64;
+
+    private:
+        // Explicit on-disk records so the file does not depend on how the
+        // compiler lays out Material and Light
+        struct MaterialRecord {
+            float albedo[3];
+            float roughness;
+            float metallic;
+            float emission;
+        };
+
+        struct LightRecord {
+            uint32_t type;
+            float position[3];
+            float direction[3];
+            float color[3];
+            float intensity;
+        };
+
+        static_assert(sizeof(Vector3) == 3 * sizeof(float), "vertices are stored as packed floats");
+        static_assert(sizeof(BVHNode) == 32 && std::is_trivially_copyable<BVHNode>::value,
+                      "BVH nodes are stored as raw 32-byte records");
+
+        static bool fail(std::string* error, const std::string& message) {
+            if (error) *error = message;
+            return false;
+        }
+
+        static uint64_t alignUp(uint64_t value) {
+            return (value + kAlignment - 1) & ~(kAlignment - 1);
+        }
+
+        template<typename T>
+        static const T* sectionData(const uint8_t* base, const SceneFileHeader& header, SceneFileSection s) {
+            return reinterpret_cast<const T*>(base + header.sections[s].offset);
+        }
+
+        static bool allBelow(const uint32_t* values, uint32_t count, uint32_t limit) {
+            for (uint32_t i = 0; i < count; i++) {
+                if (values[i] >= limit) return false;
+            }
+            return true;
+        }
+
+        // Every index stored in the sections is in range for the arrays it
+        // points into, and sphere ids are a permutation
+        static bool checkContents(const uint8_t* base, const SceneFileHeader& header, std::string& problem) {
+            if (!allBelow(sectionData<uint32_t>(base, header, SectionSphereMaterial), header.sphereCount,
+                          header.materialCount) ||
+                !allBelow(sectionData<uint32_t>(base, header, SectionTriangleMaterial), header.triangleCount,
+                          header.materialCount)) {
+                problem = "a material index out of range";
+                return false;
+            }
+            for (SceneFileSection s : {SectionIndex0, SectionIndex1, SectionIndex2}) {
+                if (!allBelow(sectionData<uint32_t>(base, header, s), header.triangleCount, header.vertexCount)) {
+                    problem = "a vertex index out of range";
+                    return false;
+                }
+            }
+
+            const uint32_t* ids = sectionData<uint32_t>(base, header, SectionSphereIds);
+            std::vector<bool> seen(header.sphereCount, false);
+            for (uint32_t i = 0; i < header.sphereCount; i++) {
+                if (ids[i] >= header.sphereCount || seen[ids[i]]) {
+                    problem = "invalid sphere ids";
+                    return false;
+                }
+                seen[ids[i]] = true;
+            }
+
+            const LightRecord* lights = sectionData<LightRecord>(base, header, SectionLights);
+            for (uint32_t i = 0; i < header.lightCount; i++) {
+                if (lights[i].type > (uint32_t)Light::Type::Point) {
+                    problem = "an unknown light type";
+                    return false;
+                }
+            }
+
+            if (!BVH::isValidTree(sectionData<BVHNode>(base, header, SectionNodes), header.nodeCount,
+                                  (uint64_t)header.sphereCount + header.triangleCount)) {
+                problem = "a malformed BVH";
+                return false;
+            }
+            return true;
+        }
+
+    public:
+        // Writes a finalized scene. Scenes holding virtual Shapes or instances
+        // cannot be saved since the format only knows spheres and triangles.
+        static bool save(const Scene& scene, const std::string& path, std::string* error = nullptr) {
+            if (!scene.finalized) return fail(error, "scene must be finalized before saving");
+            if (!scene.shapes.empty()) return fail(error, "scene contains shapes the file format cannot store");
+            if (!scene.instances.empty()) return fail(error, "scene contains instances the file format cannot store");
+            if (!scene.movedPrimitives.empty()) return fail(error, "scene has moves waiting for refit()");
+
+            const SphereSoA& spheres = scene.spheres;
+            const TriangleSoA& triangles = scene.triangles;
+            const StorageArray<BVHNode>& nodes = scene.primitiveBvh.getNodes();
+            bool precomputed = triangles.getLayout() == TriangleLayout::Precomputed;
+
+            std::vector<MaterialRecord> materials;
+            for (const Material& m : scene.materials) {
+                materials.push_back({{m.albedo.x, m.albedo.y, m.albedo.z}, m.roughness, m.metallic, m.emission});
+            }
+            std::vector<LightRecord> lights;
+            for (const Light& l : scene.lights) {
+                lights.push_back({(uint32_t)l.type, {l.position.x, l.position.y, l.position.z},
+                                  {l.direction.x, l.direction.y, l.direction.z},
+                                  {l.color.x, l.color.y, l.color.z}, l.intensity});
+            }
+
+            std::vector<uint32_t> sphereIds;
+            for (uint32_t i = 0; i < spheres.size(); i++) {
+                sphereIds.push_back(spheres.getId(i));
+            }
+
+            uint64_t paddedSpheres = spheres.size() + SphereSoA::kPadding;
+            uint64_t paddedTriangles = precomputed ? triangles.size() + TriangleSoA::kPadding : 0;
+            SphereArrays sphereArrays = spheres.getArrays();
+            TriangleArrays edges = triangles.getEdges();
+
+            struct Source {
+                const void* data;
+                uint64_t size;
+            };
+            Source sources[SectionCount] = {
+                {sphereArrays.cx, paddedSpheres * sizeof(float)},
+                {sphereArrays.cy, paddedSpheres * sizeof(float)},
+                {sphereArrays.cz, paddedSpheres * sizeof(float)},
+                {sphereArrays.radius2, paddedSpheres * sizeof(float)},
+                {spheres.getMaterialIndices(), spheres.size() * sizeof(uint32_t)},
+                {triangles.getVertices(), triangles.getVertexCount() * sizeof(Vector3)},
+                {triangles.getIndices(0), triangles.size() * sizeof(uint32_t)},
+                {triangles.getIndices(1), triangles.size() * sizeof(uint32_t)},
+                {triangles.getIndices(2), triangles.size() * sizeof(uint32_t)},
+                {triangles.getMaterialIndices(), triangles.size() * sizeof(uint32_t)},
+                {edges.v0x, paddedTriangles * sizeof(float)},
+                {edges.v0y, paddedTriangles * sizeof(float)},
+                {edges.v0z, paddedTriangles * sizeof(float)},
+                {edges.e1x, paddedTriangles * sizeof(float)},
+                {edges.e1y, paddedTriangles * sizeof(float)},
+                {edges.e1z, paddedTriangles * sizeof(float)},
+                {edges.e2x, paddedTriangles * sizeof(float)},
+                {edges.e2y, paddedTriangles * sizeof(float)},
+                {edges.e2z, paddedTriangles * sizeof(float)},
+                {materials.data(), materials.size() * sizeof(MaterialRecord)},
+                {lights.data(), lights.size() * sizeof(LightRecord)},
+                {nodes.data(), nodes.size() * sizeof(BVHNode)},
+                {sphereIds.data(), sphereIds.size() * sizeof(uint32_t)},
+            };
+
+            SceneFileHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, "RTSCENE", 8);
+            header.version = kVersion;
+            header.byteOrder = kByteOrderMark;
+            header.headerSize = sizeof(SceneFileHeader);
+            header.flags = precomputed ? kFlagPrecomputedEdges : 0;
+            header.sphereCount = spheres.size();
+            header.triangleCount = triangles.size();
+            header.vertexCount = (uint32_t)triangles.getVertexCount();
+            header.materialCount = (uint32_t)materials.size();
+            header.lightCount = (uint32_t)lights.size();
+            header.nodeCount = (uint32_t)nodes.size();
+            header.background[0] = scene.backgroundColor.x;
+            header.background[1] = scene.backgroundColor.y;
+            header.background[2] = scene.backgroundColor.z;
+
+            uint64_t offset = alignUp(sizeof(SceneFileHeader));
+            for (uint32_t s = 0; s < SectionCount; s++) {
+                header.sections[s].offset = offset;
+                header.sections[s].size = sources[s].size;
+                offset = alignUp(offset + sources[s].size);
+            }
+
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out) return fail(error, "cannot create " + path);
+
+            static const char zeros[kAlignment] = {};
+            uint64_t written = 0;
+            auto padTo = [&](uint64_t target) {
+                out.write(zeros, (std::streamsize)(target - written));
+                written = target;
+            };
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            written = sizeof(header);
+            for (uint32_t s = 0; s < SectionCount; s++) {
+                padTo(header.sections[s].offset);
+                if (sources[s].size > 0) {
+                    out.write(static_cast<const char*>(sources[s].data), (std::streamsize)sources[s].size);
+                    written += sources[s].size;
+                }
+            }
+            padTo(offset);
+            if (!out) return fail(error, "failed writing " + path);
+            return true;
+        }
+
+        // Maps path and replaces scene with a finalized scene whose arrays
+        // and BVH live in the mapping. Editing the loaded scene copies the
+        // affected arrays out of the mapping first.
+        static bool load(const std::string& path, Scene& scene, std::string* error = nullptr) {
+            std::shared_ptr<MappedFile> file = MappedFile::open(path, error);
+            if (!file) return false;
+
+            const uint8_t* base = file->data();
+            if (file->size() < sizeof(SceneFileHeader)) return fail(error, path + " is too small");
+
+            SceneFileHeader header;
+            std::memcpy(&header, base, sizeof(header));
+            if (std::memcmp(header.magic, "RTSCENE", 8) != 0) return fail(error, path + " is not a scene file");
+            if (header.byteOrder != kByteOrderMark) return fail(error, path + " has the wrong byte order");
+            if (header.version != kVersion || header.headerSize != sizeof(SceneFileHeader)) {
+                return fail(error, path + " has unsupported version " + std::to_string(header.version));
+            }
+
+            bool precomputed = (header.flags & kFlagPrecomputedEdges) != 0;
+            uint64_t paddedSpheres = (uint64_t)header.sphereCount + SphereSoA::kPadding;
+            uint64_t paddedTriangles = precomputed ? (uint64_t)header.triangleCount + TriangleSoA::kPadding : 0;
+            uint64_t expected[SectionCount] = {
+                paddedSpheres * sizeof(float), paddedSpheres * sizeof(float),
+                paddedSpheres * sizeof(float), paddedSpheres * sizeof(float),
+                header.sphereCount * sizeof(uint32_t),
+                header.vertexCount * sizeof(Vector3),
+                header.triangleCount * sizeof(uint32_t), header.triangleCount * sizeof(uint32_t),
+                header.triangleCount * sizeof(uint32_t), header.triangleCount * sizeof(uint32_t),
+                0, 0, 0, 0, 0, 0, 0, 0, 0,
+                header.materialCount * sizeof(MaterialRecord),
+                header.lightCount * sizeof(LightRecord),
+                header.nodeCount * sizeof(BVHNode),
+                header.sphereCount * sizeof(uint32_t),
+            };
+            for (uint32_t s = SectionEdgeV0x; s <= SectionEdgeE2z; s++) {
+                expected[s] = paddedTriangles * sizeof(float);
+            }
+            for (uint32_t s = 0; s < SectionCount; s++) {
+                const SceneFileHeader::Section& section = header.sections[s];
+                if (section.size != expected[s] || section.offset % kAlignment != 0 ||
+                    section.offset > file->size() || section.size > file->size() - section.offset) {
+                    return fail(error, path + " has a malformed section " + std::to_string(s));
+                }
+            }
+            if (header.materialCount == 0) return fail(error, path + " has no default material");
+            std::string problem;
+            if (!checkContents(base, header, problem)) return fail(error, path + " has " + problem);
+
+            Scene loaded(Vector3(header.background[0], header.background[1], header.background[2]));
+            loaded.materials.clear();
+            const MaterialRecord* materials = sectionData<MaterialRecord>(base, header, SectionMaterials);
+            for (uint32_t i = 0; i < header.materialCount; i++) {
+                const MaterialRecord& m = materials[i];
+                loaded.materials.push_back(Material(Vector3(m.albedo[0], m.albedo[1], m.albedo[2]),
+                                                    m.roughness, m.metallic, m.emission));
+            }
+            loaded.lights.clear();
+            const LightRecord* lights = sectionData<LightRecord>(base, header, SectionLights);
+            for (uint32_t i = 0; i < header.lightCount; i++) {
+                const LightRecord& l = lights[i];
+                loaded.lights.push_back(Light{(Light::Type)l.type,
+                                              Vector3(l.position[0], l.position[1], l.position[2]),
+                                              Vector3(l.direction[0], l.direction[1], l.direction[2]),
+                                              Vector3(l.color[0], l.color[1], l.color[2]), l.intensity});
+            }
+
+            SphereArrays sphereArrays{sectionData<float>(base, header, SectionSphereX),
+                                      sectionData<float>(base, header, SectionSphereY),
+                                      sectionData<float>(base, header, SectionSphereZ),
+                                      sectionData<float>(base, header, SectionSphereRadius2)};
+            loaded.spheres.borrow(sphereArrays, sectionData<uint32_t>(base, header, SectionSphereMaterial),
+                                  sectionData<uint32_t>(base, header, SectionSphereIds), header.sphereCount);
+
+            const uint32_t* indices[3] = {sectionData<uint32_t>(base, header, SectionIndex0),
+                                          sectionData<uint32_t>(base, header, SectionIndex1),
+                                          sectionData<uint32_t>(base, header, SectionIndex2)};
+            TriangleArrays edges{sectionData<float>(base, header, SectionEdgeV0x),
+                                 sectionData<float>(base, header, SectionEdgeV0y),
+                                 sectionData<float>(base, header, SectionEdgeV0z),
+                                 sectionData<float>(base, header, SectionEdgeE1x),
+                                 sectionData<float>(base, header, SectionEdgeE1y),
+                                 sectionData<float>(base, header, SectionEdgeE1z),
+                                 sectionData<float>(base, header, SectionEdgeE2x),
+                                 sectionData<float>(base, header, SectionEdgeE2y),
+                                 sectionData<float>(base, header, SectionEdgeE2z)};
+            loaded.triangles.borrow(sectionData<Vector3>(base, header, SectionVertices), header.vertexCount,
+                                    indices, sectionData<uint32_t>(base, header, SectionTriangleMaterial),
+                                    header.triangleCount, precomputed ? &edges : nullptr);
+
+            loaded.primitiveBvh.borrowNodes(sectionData<BVHNode>(base, header, SectionNodes), header.nodeCount);
+            loaded.backing = file;
+            loaded.finalized = true;
+            scene = std::move(loaded);
+            return true;
+        }
+    };
+
+} // namespace RayTracing
+
+#endif // RAY_TRACING_SCENE_FILE_H
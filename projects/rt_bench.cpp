@@ -0,0 +1,512 @@
+#include "ray_tracing_engine.h"
+#include "ray_tracing_scene_file.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <string>
+#include <cstring>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace RayTracing;
+
+// Ray tracer benchmark: renders a fixed set of scenes and prints one JSON
+// document with throughput, BVH build time and peak memory per scene.
+//
+// Usage: rt_bench [--scene demo|random10k|stress1m|mesh1m|instances10k|all] [--width N] [--height N]
+//                 [--threads N] [--frames N] [--rays N] [--simd scalar|sse|avx2|neon]
+//                 [--triangles indexed|precomputed] [--scene-file PATH] [--output file.json]
+//
+// With --scene-file each scene is saved to PATH after its BVH build and the
+// benchmark then runs on the memory-mapped copy loaded back from it.
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    double elapsedMs(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // Peak resident set size of the process so far, in KiB
+    long peakRssKb() {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return (long)(counters.PeakWorkingSetSize / 1024);
+        }
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+#endif
+    }
+
+    struct BenchConfig {
+        std::string scene = "all";
+        int width = 800;
+        int height = 600;
+        int threads = 0;
+        int frames = 3;
+        int rays = 200000;
+        std::string simd;
+        std::string triangles;
+        std::string sceneFile;
+        std::string output;
+        std::string trace;
+    };
+
+    struct BenchScene {
+        std::string name;
+        Scene scene;
+        Camera camera;
+        size_t primitives;
+        double buildMs;
+    };
+
+    Camera makeCamera(const BenchConfig& config, const Vector3& position, const Vector3& target) {
+        return Camera(position, target, Vector3(0.0f, 1.0f, 0.0f), 60.0f, config.width, config.height);
+    }
+
+    // The four spheres from ray_tracing_engine.cpp
+    void populateDemo(Scene& scene) {
+        uint32_t red = scene.addMaterial(Material(Vector3(0.8f, 0.2f, 0.2f), 0.3f, 0.0f));
+        uint32_t blue = scene.addMaterial(Material(Vector3(0.2f, 0.2f, 0.8f), 0.5f, 0.2f));
+        uint32_t green = scene.addMaterial(Material(Vector3(0.2f, 0.8f, 0.2f), 0.7f, 0.0f));
+        uint32_t gold = scene.addMaterial(Material(Vector3(0.8f, 0.7f, 0.2f), 0.1f, 0.9f));
+        scene.addSphere(Vector3(-2.0f, 0.0f, -5.0f), 1.0f, red);
+        scene.addSphere(Vector3(0.0f, 0.0f, -5.0f), 1.0f, blue);
+        scene.addSphere(Vector3(2.0f, 0.0f, -5.0f), 1.0f, green);
+        scene.addSphere(Vector3(0.0f, -2.0f, -3.0f), 0.8f, gold);
+    }
+
+    // Uniformly scattered spheres in front of the camera, seeded so every
+    // run traces the same scene
+    void populateRandom(Scene& scene, size_t count, float extent, float nearZ, float farZ,
+                        float minRadius, float maxRadius) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> lateral(-extent, extent);
+        std::uniform_real_distribution<float> depth(farZ, nearZ);
+        std::uniform_real_distribution<float> radius(minRadius, maxRadius);
+        std::uniform_real_distribution<float> channel(0.1f, 0.9f);
+
+        constexpr int kMaterialCount = 64;
+        uint32_t firstMaterial = (uint32_t)scene.getMaterialCount();
+        for (int i = 0; i < kMaterialCount; i++) {
+            scene.addMaterial(Material(Vector3(channel(rng), channel(rng), channel(rng))));
+        }
+
+        scene.reserveSpheres(count);
+        for (size_t i = 0; i < count; i++) {
+            Vector3 center(lateral(rng), lateral(rng), depth(rng));
+            scene.addSphere(center, radius(rng), firstMaterial + (uint32_t)(i % kMaterialCount));
+        }
+    }
+
+    // Rolling heightfield of about 1M triangles sharing one vertex grid
+    void populateTerrain(Scene& scene, int cells, float extent) {
+        uint32_t grass = scene.addMaterial(Material(Vector3(0.3f, 0.6f, 0.25f), 0.8f));
+        TriangleMesh mesh(grass);
+        mesh.vertices.reserve((size_t)(cells + 1) * (cells + 1));
+        mesh.indices.reserve((size_t)cells * cells * 6);
+        float step = 2.0f * extent / cells;
+        for (int j = 0; j <= cells; j++) {
+            for (int i = 0; i <= cells; i++) {
+                float x = -extent + i * step;
+                float z = -extent + j * step - extent;
+                float y = -4.0f + 1.5f * std::sin(x * 0.15f) * std::cos(z * 0.1f);
+                mesh.addVertex(Vector3(x, y, z));
+            }
+        }
+        for (int j = 0; j < cells; j++) {
+            for (int i = 0; i < cells; i++) {
+                uint32_t a = (uint32_t)(j * (cells + 1) + i);
+                uint32_t b = a + 1;
+                uint32_t c = a + (uint32_t)(cells + 1);
+                uint32_t d = c + 1;
+                mesh.addTriangle(a, c, b);
+                mesh.addTriangle(b, c, d);
+            }
+        }
+        scene.addMesh(mesh);
+    }
+
+    // UV-sphere mesh of rings x segments quads around the origin
+    TriangleMesh makeSphereMesh(uint32_t material, int rings, int segments) {
+        TriangleMesh mesh(material);
+        for (int r = 0; r <= rings; r++) {
+            float theta = (float)M_PI * r / rings;
+            for (int s = 0; s <= segments; s++) {
+                float phi = 2.0f * (float)M_PI * s / segments;
+                mesh.addVertex(Vector3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                                       std::sin(theta) * std::sin(phi)));
+            }
+        }
+        for (int r = 0; r < rings; r++) {
+            for (int s = 0; s < segments; s++) {
+                uint32_t a = (uint32_t)(r * (segments + 1) + s);
+                uint32_t b = a + (uint32_t)(segments + 1);
+                mesh.addTriangle(a, b, a + 1);
+                mesh.addTriangle(a + 1, b, b + 1);
+            }
+        }
+        return mesh;
+    }
+
+    // Many transformed copies of one shared mesh under a top-level BVH
+    void populateInstances(Scene& scene, size_t count) {
+        std::mt19937 rng(4321);
+        std::uniform_real_distribution<float> lateral(-150.0f, 150.0f);
+        std::uniform_real_distribution<float> depth(-400.0f, -20.0f);
+        std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+        std::uniform_real_distribution<float> size(0.3f, 1.2f);
+
+        uint32_t material = scene.addMaterial(Material(Vector3(0.7f, 0.5f, 0.3f), 0.4f));
+        auto blas = std::make_shared<Scene>();
+        blas->addMesh(makeSphereMesh(material, 32, 64));
+        blas->finalize();
+
+        for (size_t i = 0; i < count; i++) {
+            Vector3 position(lateral(rng), lateral(rng) * 0.5f, depth(rng));
+            float s = size(rng);
+            Transform objectToWorld = Transform::translation(position) *
+                                      Transform::rotation(Vector3(0.3f, 1.0f, 0.2f), angle(rng)) *
+                                      Transform::scaling(Vector3(s, s * 1.6f, s));
+            scene.addInstance(blas, objectToWorld);
+        }
+    }
+
+    BenchScene makeScene(const std::string& name, const BenchConfig& config) {
+        BenchScene bench{name, Scene(), makeCamera(config, Vector3(), Vector3(0, 0, -1)), 0, 0.0};
+        if (name == "demo") {
+            populateDemo(bench.scene);
+        } else if (name == "random10k") {
+            populateRandom(bench.scene, 10000, 50.0f, -20.0f, -150.0f, 0.2f, 1.5f);
+        } else if (name == "stress1m") {
+            populateRandom(bench.scene, 1000000, 200.0f, -20.0f, -600.0f, 0.1f, 0.6f);
+        } else if (name == "instances10k") {
+            populateInstances(bench.scene, 10000);
+        } else {
+            populateTerrain(bench.scene, 707, 100.0f);
+            bench.camera = makeCamera(config, Vector3(0.0f, 4.0f, 0.0f), Vector3(0.0f, -2.0f, -40.0f));
+        }
+
+        if (config.triangles == "indexed") {
+            bench.scene.setTriangleLayout(TriangleLayout::Indexed);
+        }
+
+        if (!config.simd.empty()) {
+            SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2, SimdLevel::NEON};
+            for (SimdLevel level : levels) {
+                if (config.simd == simdLevelName(level)) {
+                    bench.scene.setSimdLevel(level);
+                }
+            }
+        }
+
+        bench.primitives = bench.scene.getShapeCount() + bench.scene.getTriangleCount() +
+                           bench.scene.getInstanceCount();
+        auto start = Clock::now();
+        bench.scene.finalize();
+        bench.buildMs = elapsedMs(start, Clock::now());
+        return bench;
+    }
+
+    struct Throughput {
+        uint64_t rays;
+        double milliseconds;
+        uint64_t hits;
+    };
+
+    void writeThroughput(std::ostream& out, const char* key, const Throughput& t, bool last = false) {
+        double seconds = t.milliseconds / 1000.0;
+        out << "      \"" << key << "\": {\"rays\": " << t.rays
+            << ", \"hits\": " << t.hits
+            << ", \"ms\": " << t.milliseconds
+            << ", \"rays_per_sec\": " << (seconds > 0 ? t.rays / seconds : 0.0)
+            << ", \"ns_per_ray\": " << (t.rays > 0 ? t.milliseconds * 1e6 / t.rays : 0.0)
+            << "}" << (last ? "\n" : ",\n");
+    }
+
+    // Incoherent rays from around the camera into the scene's view cone
+    std::vector<Ray> makeRandomRays(const Camera& camera, int count) {
+        std::mt19937 rng(99);
+        std::uniform_int_distribution<int> px(0, camera.getWidth() - 1);
+        std::uniform_int_distribution<int> py(0, camera.getHeight() - 1);
+        std::vector<Ray> rays;
+        rays.reserve(count);
+        for (int i = 0; i < count; i++) {
+            rays.push_back(camera.generateRay(px(rng), py(rng)));
+        }
+        return rays;
+    }
+
+    struct SceneFileTiming {
+        bool used = false;
+        uint64_t bytes = 0;
+        double saveMs = 0.0;
+        double loadMs = 0.0;
+    };
+
+    // Round-trips the scene through a scene file so the rest of the run
+    // traces the mapped copy
+    bool roundTripScene(Scene& scene, const std::string& path, SceneFileTiming& timing) {
+        std::string error;
+        auto start = Clock::now();
+        if (!SceneFile::save(scene, path, &error)) {
+            std::cerr << "Saving " << path << " failed: " << error << "\n";
+            return false;
+        }
+        timing.saveMs = elapsedMs(start, Clock::now());
+
+        Scene loaded;
+        start = Clock::now();
+        if (!SceneFile::load(path, loaded, &error)) {
+            std::cerr << "Loading " << path << " failed: " << error << "\n";
+            return false;
+        }
+        timing.loadMs = elapsedMs(start, Clock::now());
+
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        timing.bytes = (uint64_t)file.tellg();
+        timing.used = true;
+        loaded.setSimdLevel(scene.getSimdLevel());
+        scene = std::move(loaded);
+        return true;
+    }
+
+    void runScene(const std::string& name, const BenchConfig& config, std::ostream& out, bool last) {
+        BenchScene bench = makeScene(name, config);
+        SceneFileTiming sceneFile;
+        if (!config.sceneFile.empty()) {
+            roundTripScene(bench.scene, config.sceneFile, sceneFile);
+        }
+        std::vector<Ray> rays = makeRandomRays(bench.camera, config.rays);
+
+        // Single-ray closest hit
+        Throughput single = {0, 0.0, 0};
+        auto start = Clock::now();
+        for (const Ray& ray : rays) {
+            single.hits += bench.scene.traceRay(ray).hit ? 1 : 0;
+        }
+        single.milliseconds = elapsedMs(start, Clock::now());
+        single.rays = rays.size();
+
+        // Any-hit occlusion over the same rays
+        Throughput shadow = {0, 0.0, 0};
+        start = Clock::now();
+        for (const Ray& ray : rays) {
+            shadow.hits += bench.scene.occluded(ray, 1000.0f) ? 1 : 0;
+        }
+        shadow.milliseconds = elapsedMs(start, Clock::now());
+        shadow.rays = rays.size();
+
+        // Coherent 4x2 primary packets over one full frame, single-threaded
+        Throughput packets = {0, 0.0, 0};
+        RayPacket<8> packet;
+        HitInfo hits[8];
+        start = Clock::now();
+        for (int y = 0; y < bench.camera.getHeight(); y += 2) {
+            for (int x = 0; x < bench.camera.getWidth(); x += 4) {
+                packet.clear();
+                for (int lane = 0; lane < 8; lane++) {
+                    int px = x + lane % 4;
+                    int py = y + lane / 4;
+                    if (px < bench.camera.getWidth() && py < bench.camera.getHeight()) {
+                        packet.setRay(lane, bench.camera.generateRay(px, py));
+                    }
+                }
+                bench.scene.tracePacket(packet, hits);
+                for (int lane = 0; lane < 8; lane++) {
+                    if (packet.isActive(lane)) {
+                        packets.rays++;
+                        packets.hits += hits[lane].hit ? 1 : 0;
+                    }
+                }
+            }
+        }
+        packets.milliseconds = elapsedMs(start, Clock::now());
+
+        // Full shaded frames on the tiled renderer
+        size_t primitives = bench.primitives;
+        double buildMs = bench.buildMs;
+        size_t nodes = bench.scene.getPrimitiveBVH().getNodeCount() + bench.scene.getBVH().getNodeCount() +
+                       bench.scene.getInstanceBVH().getNodeCount();
+        size_t instances = bench.scene.getInstanceCount();
+        std::string simd = simdLevelName(bench.scene.getSimdLevel());
+        size_t triangles = bench.scene.getTriangleCount();
+        bool indexed = bench.scene.getTriangleLayout() == TriangleLayout::Indexed;
+        RayTracingEngine engine(std::move(bench.scene), bench.camera);
+        Framebuffer framebuffer(config.width, config.height, PixelFormat::RGBA8);
+        RenderOptions options(config.threads, 32);
+
+        // --threads N renders on a job system of exactly N threads
+        std::unique_ptr<Threading::JobSystem> jobs;
+        if (config.threads > 1) {
+            jobs = std::make_unique<Threading::JobSystem>(config.threads - 1);
+            engine.setJobSystem(jobs.get());
+        }
+
+        engine.render(framebuffer, options);
+        start = Clock::now();
+        for (int frame = 0; frame < config.frames; frame++) {
+            engine.render(framebuffer, options);
+        }
+        double frameMs = elapsedMs(start, Clock::now()) / std::max(1, config.frames);
+        double framePixels = (double)config.width * config.height;
+
+        // Per-frame refit after nudging 1% of the spheres, as an animation
+        // driver would between frames
+        Scene& animated = engine.getScene();
+        uint32_t sphereCount = (uint32_t)animated.getSphereCount();
+        uint32_t moved = sphereCount > 0 ? std::max(1u, sphereCount / 100) : 0;
+        uint32_t refitNodes = 0;
+        int rebuilds = 0;
+        float quality = 1.0f;
+        std::mt19937 jitterRng(7);
+        std::uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+        double refitMs = 0.0;
+        for (int frame = 0; frame < config.frames && moved > 0; frame++) {
+            for (uint32_t k = 0; k < moved; k++) {
+                uint32_t id = (uint32_t)(((uint64_t)k * 7919u + frame * 104729u) % sphereCount);
+                Vector3 offset(jitter(jitterRng), jitter(jitterRng), jitter(jitterRng));
+                animated.updateSphere(id, animated.getSphereCenter(id) + offset, animated.getSphereRadius(id));
+            }
+            start = Clock::now();
+            Scene::RefitStats stats = animated.refit();
+            refitMs += elapsedMs(start, Clock::now());
+            refitNodes += stats.refitNodes;
+            rebuilds += stats.rebuiltPrimitives ? 1 : 0;
+            quality = stats.primitiveQuality;
+        }
+
+        out << "    {\n";
+        out << "      \"scene\": \"" << name << "\",\n";
+        out << "      \"primitives\": " << primitives << ",\n";
+        out << "      \"simd\": \"" << simd << "\",\n";
+        out << "      \"triangles\": " << triangles << ",\n";
+        out << "      \"instances\": " << instances << ",\n";
+        out << "      \"triangle_layout\": \"" << (indexed ? "indexed" : "precomputed") << "\",\n";
+        out << "      \"bvh_build_ms\": " << buildMs << ",\n";
+        out << "      \"bvh_nodes\": " << nodes << ",\n";
+        if (sceneFile.used) {
+            out << "      \"scene_file\": {\"bytes\": " << sceneFile.bytes
+                << ", \"save_ms\": " << sceneFile.saveMs
+                << ", \"load_ms\": " << sceneFile.loadMs << "},\n";
+        }
+        writeThroughput(out, "trace_single", single);
+        writeThroughput(out, "occluded", shadow);
+        writeThroughput(out, "trace_packet8", packets);
+        out << "      \"render\": {\"width\": " << config.width
+            << ", \"height\": " << config.height
+            << ", \"threads\": " << (options.threadCount > 0 ? options.threadCount
+                                                        : Threading::JobSystem::shared().getThreadCount())
+            << ", \"frames\": " << config.frames
+            << ", \"ms_per_frame\": " << frameMs
+            << ", \"primary_rays_per_sec\": " << (frameMs > 0 ? framePixels * 1000.0 / frameMs : 0.0)
+            << ", \"ns_per_primary_ray\": " << frameMs * 1e6 / framePixels << "},\n";
+        if (moved > 0) {
+            out << "      \"refit\": {\"moved_per_frame\": " << moved
+                << ", \"frames\": " << config.frames
+                << ", \"ms_per_frame\": " << refitMs / std::max(1, config.frames)
+                << ", \"nodes_per_frame\": " << refitNodes / std::max(1, config.frames)
+                << ", \"rebuilds\": " << rebuilds
+                << ", \"quality\": " << quality << "},\n";
+        }
+        out << "      \"peak_rss_kb\": " << peakRssKb() << "\n";
+        out << "    }" << (last ? "\n" : ",\n");
+    }
+
+    bool parseArgs(int argc, char** argv, BenchConfig& config) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--scene" && hasValue) config.scene = argv[++i];
+            else if (arg == "--width" && hasValue) config.width = std::atoi(argv[++i]);
+            else if (arg == "--height" && hasValue) config.height = std::atoi(argv[++i]);
+            else if (arg == "--threads" && hasValue) config.threads = std::atoi(argv[++i]);
+            else if (arg == "--frames" && hasValue) config.frames = std::atoi(argv[++i]);
+            else if (arg == "--rays" && hasValue) config.rays = std::atoi(argv[++i]);
+            else if (arg == "--simd" && hasValue) config.simd = argv[++i];
+            else if (arg == "--triangles" && hasValue) config.triangles = argv[++i];
+            else if (arg == "--scene-file" && hasValue) config.sceneFile = argv[++i];
+            else if (arg == "--output" && hasValue) config.output = argv[++i];
+            else if (arg == "--trace" && hasValue) config.trace = argv[++i];
+            else {
+                std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+                return false;
+            }
+        }
+        return config.width > 0 && config.height > 0;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        std::cerr << "Usage: rt_bench [--scene demo|random10k|stress1m|mesh1m|instances10k|all] [--width N] [--height N]\n"
+                  << "                [--threads N] [--frames N] [--rays N] [--simd LEVEL]\n"
+                  << "                [--triangles indexed|precomputed] [--scene-file PATH] [--output FILE]\n"
+                  << "                [--trace FILE]   (Chrome trace; needs ENGINE_PROFILING=1)\n";
+        return 1;
+    }
+
+    std::vector<std::string> scenes;
+    if (config.scene == "all") {
+        scenes = {"demo", "random10k", "stress1m", "mesh1m", "instances10k"};
+    } else if (config.scene == "demo" || config.scene == "random10k" || config.scene == "stress1m" ||
+               config.scene == "mesh1m" || config.scene == "instances10k") {
+        scenes = {config.scene};
+    } else {
+        std::cerr << "Unknown scene: " << config.scene << "\n";
+        return 1;
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"benchmark\": \"rt_bench\",\n";
+    out << "  \"cpu_simd\": \"" << simdLevelName(detectSimdLevel()) << "\",\n";
+    out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"scenes\": [\n";
+    for (size_t i = 0; i < scenes.size(); i++) {
+        runScene(scenes[i], config, out, i + 1 == scenes.size());
+    }
+    out << "  ],\n";
+    out << "  \"peak_rss_kb\": " << peakRssKb() << "\n";
+    out << "}\n";
+
+    if (!config.trace.empty()) {
+        if (!ENGINE_PROFILING) {
+            std::cerr << "--trace ignored: rt_bench was built without ENGINE_PROFILING\n";
+        } else if (!Profiling::Profiler::instance().saveChromeTrace(config.trace)) {
+            std::cerr << "Could not write " << config.trace << "\n";
+        }
+    }
+
+    if (config.output.empty()) {
+        std::cout << out.str();
+    } else {
+        std::ofstream file(config.output);
+        file << out.str();
+        if (!file) {
+            std::cerr << "Could not write " << config.output << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,242 @@
+#ifndef SCENE_BRIDGE_H
+#define SCENE_BRIDGE_H
+
+#include "game_engine.h"
+#include "ray_tracing_engine.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace GameEngine {
+
+    // Keeps a RayTracing::Scene in step with the renderables of a registry,
+    // so the ray tracer can draw an ECS scene without rebuilding it every
+    // frame. Each visible entity with a RenderComponent and a
+    // TransformComponent is bound to one ray tracer object: an instance of
+    // the mesh's BLAS if one is registered for its mesh id, otherwise a
+    // sphere proxy of the component's bounding radius.
+    //
+    // Sync() pushes only transforms that changed since the last sync and
+    // brings the BVHs up to date through refit(). Objects of entities that
+    // were destroyed or hidden are disabled and reused by later entities,
+    // since the ray tracer never removes objects.
+    class RayTracingBridge {
+    public:
+        struct SyncStats {
+            uint32_t added = 0;             // Newly bound entities
+            uint32_t updated = 0;           // Bound entities whose transform changed
+            uint32_t removed = 0;           // Unbound: destroyed, hidden or lost a component
+            RayTracing::Scene::RefitStats refit;
+        };
+
+    private:
+        enum class Kind : uint8_t { None, Sphere, Instance };
+
+        // Transform fields and radius as last pushed to the ray tracer
+        struct State {
+            float x, y, z;
+            float rotationX, rotationY, rotationZ;
+            float scaleX, scaleY, scaleZ;
+            float radius;
+
+            bool operator==(const State& o) const {
+                return x == o.x && y == o.y && z == o.z && rotationX == o.rotationX &&
+                       rotationY == o.rotationY && rotationZ == o.rotationZ && scaleX == o.scaleX &&
+                       scaleY == o.scaleY && scaleZ == o.scaleZ && radius == o.radius;
+            }
+        };
+
+        struct Binding {
+            EntityHandle entity = kNullEntity;
+            Kind kind = Kind::None;
+            uint32_t object = 0;            // Sphere id or instance index
+            NameId mesh = 0;
+            NameId material = 0;
+            uint64_t lastSeen = 0;          // Sync() that last found the entity
+            State state{};
+        };
+
+        Registry& registry_;
+        RayTracing::Scene& target_;
+        std::unordered_map<NameId, std::shared_ptr<const RayTracing::Scene>> meshes_;
+        std::unordered_map<NameId, uint32_t> materials_;
+        std::vector<Binding> bindings_;                         // By entity index
+        std::vector<uint32_t> freeSpheres_;
+        std::unordered_map<NameId, std::vector<uint32_t>> freeInstances_;     // By mesh
+        uint64_t syncCount_;
+        size_t boundCount_;
+
+        static State StateOf(const TransformComponent& t, const RenderComponent& render) {
+            return State{t.GetX(), t.GetY(), t.GetZ(), t.GetRotationX(), t.GetRotationY(), t.GetRotationZ(),
+                         t.GetScaleX(), t.GetScaleY(), t.GetScaleZ(), render.GetBoundingRadius()};
+        }
+
+        // Translation * Rz * Ry * Rx * scale, rotations in degrees
+        static RayTracing::Transform ObjectToWorld(const State& s) {
+            using RayTracing::Transform;
+            using RayTracing::Vector3;
+            return Transform::translation(Vector3(s.x, s.y, s.z)) *
+                   Transform::rotation(Vector3(0, 0, 1), s.rotationZ) *
+                   Transform::rotation(Vector3(0, 1, 0), s.rotationY) *
+                   Transform::rotation(Vector3(1, 0, 0), s.rotationX) *
+                   Transform::scaling(Vector3(s.scaleX, s.scaleY, s.scaleZ));
+        }
+
+        uint32_t MaterialFor(NameId material, uint32_t fallback) const {
+            auto it = materials_.find(material);
+            return it != materials_.end() ? it->second : fallback;
+        }
+
+        void Bind(Binding& binding, EntityHandle entity, const RenderComponent& render, const State& state) {
+            binding.entity = entity;
+            binding.mesh = render.GetMeshId();
+            binding.material = render.GetMaterialId();
+            binding.state = state;
+            auto mesh = meshes_.find(binding.mesh);
+            if (mesh != meshes_.end()) {
+                binding.kind = Kind::Instance;
+                RayTracing::Transform transform = ObjectToWorld(state);
+                uint32_t material = MaterialFor(binding.material, RayTracing::Scene::kNoMaterialOverride);
+                std::vector<uint32_t>& free = freeInstances_[binding.mesh];
+                if (!free.empty() && target_.isFinalized()) {
+                    binding.object = free.back();
+                    free.pop_back();
+                    target_.setInstanceTransform(binding.object, transform);
+                    target_.setInstanceMaterialOverride(binding.object, material);
+                    target_.setInstanceEnabled(binding.object, true);
+                } else {
+                    binding.object = target_.addInstance(mesh->second, transform, material);
+                }
+            } else {
+                binding.kind = Kind::Sphere;
+                RayTracing::Vector3 center(state.x, state.y, state.z);
+                uint32_t material = MaterialFor(binding.material, 0);
+                if (!freeSpheres_.empty()) {
+                    binding.object = freeSpheres_.back();
+                    freeSpheres_.pop_back();
+                    target_.updateSphere(binding.object, center, state.radius);
+                    target_.setSphereMaterial(binding.object, material);
+                } else {
+                    binding.object = target_.addSphere(center, state.radius, material);
+                }
+            }
+            boundCount_++;
+        }
+
+        // Spheres shrink to nothing and instances are disabled; both wait
+        // for the next entity that needs one
+        void Unbind(Binding& binding) {
+            if (binding.kind == Kind::Sphere) {
+                target_.updateSphere(binding.object, target_.getSphereCenter(binding.object), 0.0f);
+                freeSpheres_.push_back(binding.object);
+            } else if (binding.kind == Kind::Instance) {
+                target_.setInstanceEnabled(binding.object, false);
+                freeInstances_[binding.mesh].push_back(binding.object);
+            }
+            binding = Binding();
+            boundCount_--;
+        }
+
+    public:
+        // Turns on deferred builds in target so a frame's additions cost one
+        // rebuild; both must outlive the bridge
+        RayTracingBridge(Registry& registry, RayTracing::Scene& target)
+            : registry_(registry), target_(target), syncCount_(0), boundCount_(0) {
+            target_.setDeferredBuilds(true);
+        }
+
+        RayTracingBridge(const RayTracingBridge&) = delete;
+        RayTracingBridge& operator=(const RayTracingBridge&) = delete;
+
+        // Entities whose mesh id is registered become instances of blas,
+        // which must be finalized. Affects entities bound from now on.
+        void RegisterMesh(NameId mesh, std::shared_ptr<const RayTracing::Scene> blas) {
+            meshes_[mesh] = std::move(blas);
+        }
+
+        void RegisterMesh(const std::string& meshPath, std::shared_ptr<const RayTracing::Scene> blas) {
+            RegisterMesh(NameTable::Shared().Intern(meshPath), std::move(blas));
+        }
+
+        // Maps a RenderComponent material id to a material in the target
+        // scene. Unmapped materials use the default material for spheres
+        // and the BLAS's own materials for instances.
+        void RegisterMaterial(NameId material, uint32_t materialId) { materials_[material] = materialId; }
+
+        void RegisterMaterial(const std::string& materialPath, uint32_t materialId) {
+            RegisterMaterial(NameTable::Shared().Intern(materialPath), materialId);
+        }
+
+        // Binds new renderables, pushes changed transforms, unbinds the ones
+        // that are gone, then finalizes (first call) or refits the target.
+        // Not for use while the target is being traced.
+        SyncStats Sync() {
+            PROFILE_SCOPE("RayTracingBridge::Sync");
+            SyncStats stats;
+            uint64_t sync = ++syncCount_;
+            ComponentPool<RenderComponent>* renders = registry_.FindPool<RenderComponent>();
+            ComponentPool<TransformComponent>* transforms = registry_.FindPool<TransformComponent>();
+
+            if (renders && transforms) {
+                const std::vector<EntityHandle>& entities = renders->GetEntities();
+                const RenderComponent* components = renders->Data();
+                for (size_t i = 0; i < entities.size(); i++) {
+                    const RenderComponent& render = components[i];
+                    const TransformComponent* transform =
+                        render.IsVisible() ? transforms->Get(entities[i]) : nullptr;
+                    if (!transform) continue;
+
+                    uint32_t index = EntityIndex(entities[i]);
+                    if (index >= bindings_.size()) bindings_.resize(index + 1);
+                    Binding& binding = bindings_[index];
+                    State state = StateOf(*transform, render);
+
+                    bool rebind = binding.entity != entities[i] || binding.mesh != render.GetMeshId() ||
+                                  binding.material != render.GetMaterialId();
+                    if (rebind) {
+                        if (binding.kind != Kind::None) {
+                            Unbind(binding);
+                            stats.removed++;
+                        }
+                        Bind(binding, entities[i], render, state);
+                        stats.added++;
+                    } else if (!(binding.state == state)) {
+                        binding.state = state;
+                        if (binding.kind == Kind::Sphere) {
+                            target_.updateSphere(binding.object, RayTracing::Vector3(state.x, state.y, state.z),
+                                                 state.radius);
+                        } else {
+                            target_.setInstanceTransform(binding.object, ObjectToWorld(state));
+                        }
+                        stats.updated++;
+                    }
+                    binding.lastSeen = sync;
+                }
+            }
+
+            for (Binding& binding : bindings_) {
+                if (binding.kind != Kind::None && binding.lastSeen != sync) {
+                    Unbind(binding);
+                    stats.removed++;
+                }
+            }
+
+            if (!target_.isFinalized()) {
+                target_.finalize();
+            } else {
+                stats.refit = target_.refit();
+            }
+            return stats;
+        }
+
+        size_t GetBoundCount() const { return boundCount_; }
+
+        bool IsBound(EntityHandle entity) const {
+            uint32_t index = EntityIndex(entity);
+            return index < bindings_.size() && bindings_[index].entity == entity;
+        }
+    };
+
+} // namespace GameEngine
+
+#endif // SCENE_BRIDGE_H
@@ -0,0 +1,281 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <cmath>
+#include <cstdint>
+
+// Baseline vector ISA for this translation unit. SSE2 is part of x86-64 and
+// NEON of AArch64, so these need no flags; wider code paths elsewhere pick
+// their ISA at runtime.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATH_SIMD_SSE 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MATH_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace Math {
+
+    // 1 / sqrt(x) for x > 0: the hardware estimate refined by Newton steps
+    // to within a few ulps, cheaper than a sqrt followed by a divide
+    inline float rsqrt(float x) {
+#if defined(MATH_SIMD_SSE)
+        __m128 v = _mm_set_ss(x);
+        __m128 r = _mm_rsqrt_ss(v);
+        // r * (1.5 - 0.5 * x * r * r)
+        __m128 half = _mm_mul_ss(v, _mm_set_ss(0.5f));
+        r = _mm_mul_ss(r, _mm_sub_ss(_mm_set_ss(1.5f), _mm_mul_ss(half, _mm_mul_ss(r, r))));
+        return _mm_cvtss_f32(r);
+#elif defined(MATH_SIMD_NEON)
+        // The estimate is only 8 bits, so it takes two steps
+        float r = vrsqrtes_f32(x);
+        r *= vrsqrtss_f32(x * r, r);
+        r *= vrsqrtss_f32(x * r, r);
+        return r;
+#else
+        return 1.0f / std::sqrt(x);
+#endif
+    }
+
+    // a * b + c, fused where the target has FMA
+    inline float fmadd(float a, float b, float c) {
+#if defined(__FMA__) || defined(MATH_SIMD_NEON)
+        return std::fma(a, b, c);
+#else
+        return a * b + c;
+#endif
+    }
+
+    // Four floats in one 16-byte register. Lane 3 is free for padding when
+    // it holds a point or direction, and the *3 helpers ignore it.
+    struct alignas(16) float4 {
+#if defined(MATH_SIMD_SSE)
+        __m128 v;
+        explicit float4(__m128 value) : v(value) {}
+#elif defined(MATH_SIMD_NEON)
+        float32x4_t v;
+        explicit float4(float32x4_t value) : v(value) {}
+#else
+        float v[4];
+#endif
+
+        float4() = default;
+
+#if defined(MATH_SIMD_SSE)
+        explicit float4(float s) : v(_mm_set1_ps(s)) {}
+        float4(float x, float y, float z, float w = 0.0f) : v(_mm_setr_ps(x, y, z, w)) {}
+
+        // p must be 16-byte aligned for load/store, not for the u variants
+        static float4 load(const float* p) { return float4(_mm_load_ps(p)); }
+        static float4 loadu(const float* p) { return float4(_mm_loadu_ps(p)); }
+        void store(float* p) const { _mm_store_ps(p, v); }
+        void storeu(float* p) const { _mm_storeu_ps(p, v); }
+#elif defined(MATH_SIMD_NEON)
+        explicit float4(float s) : v(vdupq_n_f32(s)) {}
+        float4(float x, float y, float z, float w = 0.0f) {
+            alignas(16) float values[4] = {x, y, z, w};
+            v = vld1q_f32(values);
+        }
+
+        static float4 load(const float* p) { return float4(vld1q_f32(p)); }
+        static float4 loadu(const float* p) { return float4(vld1q_f32(p)); }
+        void store(float* p) const { vst1q_f32(p, v); }
+        void storeu(float* p) const { vst1q_f32(p, v); }
+#else
+        explicit float4(float s) : v{s, s, s, s} {}
+        float4(float x, float y, float z, float w = 0.0f) : v{x, y, z, w} {}
+
+        static float4 load(const float* p) { return float4(p[0], p[1], p[2], p[3]); }
+        static float4 loadu(const float* p) { return load(p); }
+        void store(float* p) const { for (int i = 0; i < 4; i++) p[i] = v[i]; }
+        void storeu(float* p) const { store(p); }
+#endif
+
+        float operator[](int lane) const {
+            alignas(16) float values[4];
+            store(values);
+            return values[lane];
+        }
+
+        float x() const {
+#if defined(MATH_SIMD_SSE)
+            return _mm_cvtss_f32(v);
+#elif defined(MATH_SIMD_NEON)
+            return vgetq_lane_f32(v, 0);
+#else
+            return v[0];
+#endif
+        }
+
+        float y() const { return (*this)[1]; }
+        float z() const { return (*this)[2]; }
+        float w() const { return (*this)[3]; }
+    };
+
+#if defined(MATH_SIMD_SSE)
+    inline float4 operator+(float4 a, float4 b) { return float4(_mm_add_ps(a.v, b.v)); }
+    inline float4 operator-(float4 a, float4 b) { return float4(_mm_sub_ps(a.v, b.v)); }
+    inline float4 operator*(float4 a, float4 b) { return float4(_mm_mul_ps(a.v, b.v)); }
+    inline float4 operator/(float4 a, float4 b) { return float4(_mm_div_ps(a.v, b.v)); }
+    inline float4 min(float4 a, float4 b) { return float4(_mm_min_ps(a.v, b.v)); }
+    inline float4 max(float4 a, float4 b) { return float4(_mm_max_ps(a.v, b.v)); }
+    inline float4 sqrt(float4 a) { return float4(_mm_sqrt_ps(a.v)); }
+
+    inline float4 fmadd(float4 a, float4 b, float4 c) {
+#if defined(__FMA__)
+        return float4(_mm_fmadd_ps(a.v, b.v, c.v));
+#else
+        return float4(_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v));
+#endif
+    }
+
+    inline float4 rsqrt(float4 a) {
+        __m128 r = _mm_rsqrt_ps(a.v);
+        __m128 half = _mm_mul_ps(a.v, _mm_set1_ps(0.5f));
+        return float4(_mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(half, _mm_mul_ps(r, r)))));
+    }
+
+    // Sum of the first three lanes of a * b
+    inline float dot3(float4 a, float4 b) {
+        __m128 m = _mm_mul_ps(a.v, b.v);
+        __m128 y = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 z = _mm_movehl_ps(m, m);
+        return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(m, y), z));
+    }
+#elif defined(MATH_SIMD_NEON)
+    inline float4 operator+(float4 a, float4 b) { return float4(vaddq_f32(a.v, b.v)); }
+    inline float4 operator-(float4 a, float4 b) { return float4(vsubq_f32(a.v, b.v)); }
+    inline float4 operator*(float4 a, float4 b) { return float4(vmulq_f32(a.v, b.v)); }
+    inline float4 operator/(float4 a, float4 b) { return float4(vdivq_f32(a.v, b.v)); }
+    inline float4 min(float4 a, float4 b) { return float4(vminq_f32(a.v, b.v)); }
+    inline float4 max(float4 a, float4 b) { return float4(vmaxq_f32(a.v, b.v)); }
+    inline float4 sqrt(float4 a) { return float4(vsqrtq_f32(a.v)); }
+    inline float4 fmadd(float4 a, float4 b, float4 c) { return float4(vfmaq_f32(c.v, a.v, b.v)); }
+
+    inline float4 rsqrt(float4 a) {
+        float32x4_t r = vrsqrteq_f32(a.v);
+        r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+        r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+        return float4(r);
+    }
+
+    inline float dot3(float4 a, float4 b) {
+        return vaddvq_f32(vsetq_lane_f32(0.0f, vmulq_f32(a.v, b.v), 3));
+    }
+#else
+    namespace Detail {
+        template<typename Op>
+        float4 lanes(float4 a, float4 b, Op op) {
+            return float4(op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2]), op(a.v[3], b.v[3]));
+        }
+    }
+
+    inline float4 operator+(float4 a, float4 b) { return Detail::lanes(a, b, [](float x, float y) { return x + y; }); }
+    inline float4 operator-(float4 a, float4 b) { return Detail::lanes(a, b, [](float x, float y) { return x - y; }); }
+    inline float4 operator*(float4 a, float4 b) { return Detail::lanes(a, b, [](float x, float y) { return x * y; }); }
+    inline float4 operator/(float4 a, float4 b) { return Detail::lanes(a, b, [](float x, float y) { return x / y; }); }
+    inline float4 min(float4 a, float4 b) { return Detail::lanes(a, b, [](float x, float y) { return x < y ? x : y; }); }
+    inline float4 max(float4 a, float4 b) { return Detail::lanes(a, b, [](float x, float y) { return x > y ? x : y; }); }
+    inline float4 sqrt(float4 a) { return float4(std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3])); }
+    inline float4 fmadd(float4 a, float4 b, float4 c) { return a * b + c; }
+    inline float4 rsqrt(float4 a) { return float4(rsqrt(a.v[0]), rsqrt(a.v[1]), rsqrt(a.v[2]), rsqrt(a.v[3])); }
+    inline float dot3(float4 a, float4 b) { return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2]; }
+#endif
+
+    inline float4 operator*(float4 a, float s) { return a * float4(s); }
+    inline float4& operator+=(float4& a, float4 b) { return a = a + b; }
+    inline float4& operator-=(float4& a, float4 b) { return a = a - b; }
+    inline float4& operator*=(float4& a, float4 b) { return a = a * b; }
+
+    inline float length3(float4 a) { return std::sqrt(dot3(a, a)); }
+
+    // a scaled to unit length in its first three lanes; a must be nonzero
+    inline float4 normalize3(float4 a) { return a * rsqrt(dot3(a, a)); }
+
+    inline float4 cross3(float4 a, float4 b) {
+        return float4(a.y() * b.z() - a.z() * b.y(), a.z() * b.x() - a.x() * b.z(),
+                      a.x() * b.y() - a.y() * b.x());
+    }
+
+    // Eight floats: one AVX register when the translation unit is built for
+    // AVX, two float4 halves otherwise, so code written against it runs on
+    // any target. Aligned as its storage is (32 or 16 bytes).
+    struct float8 {
+#if defined(__AVX__)
+        __m256 v;
+        explicit float8(__m256 value) : v(value) {}
+
+        float8() = default;
+        explicit float8(float s) : v(_mm256_set1_ps(s)) {}
+        float8(float4 low, float4 high) : v(_mm256_insertf128_ps(_mm256_castps128_ps256(low.v), high.v, 1)) {}
+
+        // p must be 32-byte aligned for load/store, not for the u variants
+        static float8 load(const float* p) { return float8(_mm256_load_ps(p)); }
+        static float8 loadu(const float* p) { return float8(_mm256_loadu_ps(p)); }
+        void store(float* p) const { _mm256_store_ps(p, v); }
+        void storeu(float* p) const { _mm256_storeu_ps(p, v); }
+
+        float4 low() const { return float4(_mm256_castps256_ps128(v)); }
+        float4 high() const { return float4(_mm256_extractf128_ps(v, 1)); }
+#else
+        float4 lo, hi;
+
+        float8() = default;
+        explicit float8(float s) : lo(s), hi(s) {}
+        float8(float4 low, float4 high) : lo(low), hi(high) {}
+
+        static float8 load(const float* p) { return float8(float4::load(p), float4::load(p + 4)); }
+        static float8 loadu(const float* p) { return float8(float4::loadu(p), float4::loadu(p + 4)); }
+        void store(float* p) const { lo.store(p); hi.store(p + 4); }
+        void storeu(float* p) const { lo.storeu(p); hi.storeu(p + 4); }
+
+        float4 low() const { return lo; }
+        float4 high() const { return hi; }
+#endif
+
+        float operator[](int lane) const { return lane < 4 ? low()[lane] : high()[lane - 4]; }
+    };
+
+#if defined(__AVX__)
+    inline float8 operator+(float8 a, float8 b) { return float8(_mm256_add_ps(a.v, b.v)); }
+    inline float8 operator-(float8 a, float8 b) { return float8(_mm256_sub_ps(a.v, b.v)); }
+    inline float8 operator*(float8 a, float8 b) { return float8(_mm256_mul_ps(a.v, b.v)); }
+    inline float8 operator/(float8 a, float8 b) { return float8(_mm256_div_ps(a.v, b.v)); }
+    inline float8 min(float8 a, float8 b) { return float8(_mm256_min_ps(a.v, b.v)); }
+    inline float8 max(float8 a, float8 b) { return float8(_mm256_max_ps(a.v, b.v)); }
+    inline float8 sqrt(float8 a) { return float8(_mm256_sqrt_ps(a.v)); }
+
+    inline float8 fmadd(float8 a, float8 b, float8 c) {
+#if defined(__FMA__)
+        return float8(_mm256_fmadd_ps(a.v, b.v, c.v));
+#else
+        return float8(_mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v));
+#endif
+    }
+
+    inline float8 rsqrt(float8 a) {
+        __m256 r = _mm256_rsqrt_ps(a.v);
+        __m256 half = _mm256_mul_ps(a.v, _mm256_set1_ps(0.5f));
+        return float8(_mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(half, _mm256_mul_ps(r, r)))));
+    }
+#else
+    inline float8 operator+(float8 a, float8 b) { return float8(a.lo + b.lo, a.hi + b.hi); }
+    inline float8 operator-(float8 a, float8 b) { return float8(a.lo - b.lo, a.hi - b.hi); }
+    inline float8 operator*(float8 a, float8 b) { return float8(a.lo * b.lo, a.hi * b.hi); }
+    inline float8 operator/(float8 a, float8 b) { return float8(a.lo / b.lo, a.hi / b.hi); }
+    inline float8 min(float8 a, float8 b) { return float8(min(a.lo, b.lo), min(a.hi, b.hi)); }
+    inline float8 max(float8 a, float8 b) { return float8(max(a.lo, b.lo), max(a.hi, b.hi)); }
+    inline float8 sqrt(float8 a) { return float8(sqrt(a.lo), sqrt(a.hi)); }
+    inline float8 fmadd(float8 a, float8 b, float8 c) { return float8(fmadd(a.lo, b.lo, c.lo), fmadd(a.hi, b.hi, c.hi)); }
+    inline float8 rsqrt(float8 a) { return float8(rsqrt(a.lo), rsqrt(a.hi)); }
+#endif
+
+    inline float8 operator*(float8 a, float s) { return a * float8(s); }
+    inline float8& operator+=(float8& a, float8 b) { return a = a + b; }
+    inline float8& operator-=(float8& a, float8 b) { return a = a - b; }
+    inline float8& operator*=(float8& a, float8 b) { return a = a * b; }
+
+} // namespace Math
+
+#endif // SIMD_MATH_H